@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 and SHA-256 using the ARMv8 Cryptography Extensions
+ *
+ * The extensions are optional, so check ID_AA64ISAR0_EL1 before using them
+ * and let the portable code in lib/ handle CPUs without them.
+ */
+
+#include <common.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <linux/errno.h>
+
+/* Fields of ID_AA64ISAR0_EL1 */
+#define ISAR0_SHA1_SHIFT	8
+#define ISAR0_SHA2_SHIFT	12
+
+void sha1_ce_transform(u32 state[5], const u8 *data, uint blocks);
+void sha256_ce_transform(u32 state[8], const u8 *data, uint blocks);
+
+static bool sha_ce_present(int shift)
+{
+	u64 isar0;
+
+	asm("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> shift) & 0xf;
+}
+
+int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+		      unsigned int blocks)
+{
+	if (!sha_ce_present(ISAR0_SHA1_SHIFT))
+		return -ENOSYS;
+	if (blocks)
+		sha1_ce_transform(state, data, blocks);
+
+	return 0;
+}
+
+int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			unsigned int blocks)
+{
+	if (!sha_ce_present(ISAR0_SHA2_SHIFT))
+		return -ENOSYS;
+	if (blocks)
+		sha256_ce_transform(state, data, blocks);
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * CRC32 using the optional CRC32 instructions of ARMv8
+ *
+ * These use the same (bit-reflected) polynomial as crc32_no_comp() and do
+ * not invert the CRC, so they are a drop-in replacement for it.
+ */
+
+#include <common.h>
+#include <efi_loader.h>
+#include <u-boot/crc.h>
+#include <asm/byteorder.h>
+
+static int __efi_runtime_data crc32_present = -1;
+
+bool __efi_runtime crc32_arm64_present(void)
+{
+	u64 isar0;
+
+	if (crc32_present < 0) {
+		/* ID_AA64ISAR0_EL1.CRC32 is bits [19:16] */
+		asm("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+		crc32_present = (isar0 >> 16) & 0xf ? 1 : 0;
+	}
+
+	return crc32_present;
+}
+
+uint32_t __efi_runtime crc32_arm64(uint32_t crc, const unsigned char *buf,
+				   uint len)
+{
+	u64 val;
+
+	/* the caches may be off, so avoid unaligned accesses */
+	for (; len && ((ulong)buf & 7); len--)
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (*buf++));
+
+	for (; len >= 8; len -= 8, buf += 8) {
+		val = le64_to_cpu(*(const u64 *)buf);
+		asm("crc32x %w0, %w0, %x1" : "+r" (crc) : "r" (val));
+	}
+
+	for (; len; len--)
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (*buf++));
+
+	return crc;
+}
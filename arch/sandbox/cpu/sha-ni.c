@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 and SHA-256 using the x86 SHA extensions (SHA-NI)
+ *
+ * This is built in the system environment, since it needs the compiler's
+ * intrinsics headers. Hosts without the SHA extensions, or which are not
+ * x86 at all, use the portable code in lib/.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHA_NI_TARGET	__attribute__((target("sha,sse4.1")))
+
+static int sha_ni_present = -1;
+
+static int sha_ni_check(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (sha_ni_present < 0) {
+		/* CPUID.(EAX=7,ECX=0):EBX.SHA[bit 29] */
+		sha_ni_present = __get_cpuid_count(7, 0, &eax, &ebx, &ecx,
+						   &edx) &&
+				 (ebx & (1 << 29));
+	}
+
+	return sha_ni_present;
+}
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+SHA_NI_TARGET
+static void sha256_ni(uint32_t state[8], const uint8_t *data,
+		      unsigned int blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, abef_save, cdgh_save;
+	__m128i msg[4], m, tmp;
+	int i;
+
+	/* the instructions want the state as ABEF and CDGH */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)&state[0]), 0xb1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)&state[4]),
+				   0x1b);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	for (; blocks; blocks--, data += 64) {
+		abef_save = state0;
+		cdgh_save = state1;
+
+		/* four rounds at a time, msg[] holds the last 16 words */
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				m = _mm_loadu_si128((__m128i *)(data + i * 16));
+				msg[i] = _mm_shuffle_epi8(m, mask);
+			} else {
+				m = _mm_sha256msg1_epu32(msg[i & 3],
+							 msg[(i + 1) & 3]);
+				tmp = _mm_alignr_epi8(msg[(i + 3) & 3],
+						      msg[(i + 2) & 3], 4);
+				m = _mm_add_epi32(m, tmp);
+				msg[i & 3] = _mm_sha256msg2_epu32(m,
+							msg[(i + 3) & 3]);
+			}
+			m = _mm_add_epi32(msg[i & 3],
+				_mm_loadu_si128((__m128i *)&sha256_k[i * 4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+			m = _mm_shuffle_epi32(m, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+		}
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	_mm_storeu_si128((__m128i *)&state[0],
+			 _mm_blend_epi16(tmp, state1, 0xf0));
+	_mm_storeu_si128((__m128i *)&state[4],
+			 _mm_alignr_epi8(state1, tmp, 8));
+}
+
+SHA_NI_TARGET
+static void sha1_ni(uint32_t state[5], const uint8_t *data,
+		    unsigned int blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+					    0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e, e_save, prev;
+	__m128i msg[4], m;
+	int i;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)state), 0x1b);
+	e = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; blocks; blocks--, data += 64) {
+		abcd_save = abcd;
+		e_save = e;
+		prev = abcd;
+
+		/* four rounds at a time, msg[] holds the last 16 words */
+		for (i = 0; i < 20; i++) {
+			if (i < 4) {
+				m = _mm_loadu_si128((__m128i *)(data + i * 16));
+				msg[i] = _mm_shuffle_epi8(m, mask);
+			} else {
+				m = _mm_sha1msg1_epu32(msg[i & 3],
+						       msg[(i + 1) & 3]);
+				m = _mm_xor_si128(m, msg[(i + 2) & 3]);
+				msg[i & 3] = _mm_sha1msg2_epu32(m,
+							msg[(i + 3) & 3]);
+			}
+			if (i)
+				e = _mm_sha1nexte_epu32(prev, msg[i & 3]);
+			else
+				e = _mm_add_epi32(e, msg[0]);
+			prev = abcd;
+
+			/* the function selector must be a constant */
+			switch (i / 5) {
+			case 0:
+				abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+				break;
+			case 1:
+				abcd = _mm_sha1rnds4_epu32(abcd, e, 1);
+				break;
+			case 2:
+				abcd = _mm_sha1rnds4_epu32(abcd, e, 2);
+				break;
+			default:
+				abcd = _mm_sha1rnds4_epu32(abcd, e, 3);
+				break;
+			}
+		}
+
+		e = _mm_sha1nexte_epu32(prev, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e, 3);
+}
+
+int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			unsigned int blocks)
+{
+	if (!sha_ni_check())
+		return -ENOSYS;
+	sha256_ni(state, data, blocks);
+
+	return 0;
+}
+
+int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+		      unsigned int blocks)
+{
+	if (!sha_ni_check())
+		return -ENOSYS;
+	sha1_ni(state, data, blocks);
+
+	return 0;
+}
+#else
+int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			unsigned int blocks)
+{
+	return -ENOSYS;
+}
+
+int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+		      unsigned int blocks)
+{
+	return -ENOSYS;
+}
+#endif
@@ -285,4 +285,12 @@ void sandbox_cros_ec_set_test_flags(struct udevice *dev, uint flags);
  */
 int sandbox_cros_ec_get_pwm_duty(struct udevice *dev, uint index, uint *duty);
 
+/**
+ * sandbox_mmc_get_sg_reads() - Get the number of scatter-gather reads
+ *
+ * @dev: MMC device to check
+ * @return number of reads which went straight into the caller's segments
+ */
+int sandbox_mmc_get_sg_reads(struct udevice *dev);
+
 #endif
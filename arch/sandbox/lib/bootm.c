@@ -7,8 +7,12 @@
 #include <common.h>
 #include <bootstage.h>
 #include <image.h>
+#include <lmb.h>
+#include <asm/global_data.h>
 #include <asm/io.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 #define	LINUX_ARM_ZIMAGE_MAGIC	0x016f2818
 
 struct arm_z_header {
@@ -50,6 +54,12 @@ int bootz_setup(ulong image, ulong *start, ulong *end)
 	return ret;
 }
 
+void arch_lmb_reserve(struct lmb *lmb)
+{
+	/* U-Boot's malloc() pool, devicetree, etc. are at the top of RAM */
+	lmb_reserve(lmb, gd->start_addr_sp, gd->ram_top - gd->start_addr_sp);
+}
+
 int do_bootm_linux(int flag, int argc, char *argv[], bootm_headers_t *images)
 {
 	if (flag & (BOOTM_STATE_OS_GO | BOOTM_STATE_OS_FAKE_GO)) {
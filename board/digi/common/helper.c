@@ -12,6 +12,7 @@
 #include <console.h>
 #include <env.h>
 #include <gzip.h>
+#include <hash.h>
 #include <linux/errno.h>
 #include <fsl_sec.h>
 #include <asm/mach-imx/hab.h>
@@ -178,6 +179,58 @@ static int write_file_fs_otf(int src, char *filename, char *devpartno)
 
 	return 0;
 }
+
+/*
+ * Written firmware is verified by digest rather than by reading it back
+ * into a second buffer and comparing, so the image may use nearly all of
+ * the available RAM.
+ */
+int update_digest(const void *buf, unsigned long len, u8 *digest)
+{
+	return hash_block(CONFIG_DIGI_UPDATE_VERIFY_ALGO, buf, len, digest,
+			  NULL);
+}
+
+static int update_verify_write(struct stream_sink *sink, const void *buf,
+			       ulong len)
+{
+	struct update_verify *uv = container_of(sink, struct update_verify,
+						sink);
+	ulong n = min_t(u64, uv->left, len);
+
+	/* ignore the padding at the end of the last block */
+	uv->left -= n;
+
+	return n ? stream_write(&uv->hs.sink, buf, n) : 0;
+}
+
+int update_verify_init(struct update_verify *uv, u64 len)
+{
+	uv->sink.write = update_verify_write;
+	uv->left = len;
+
+	return hash_stream_init(&uv->hs, CONFIG_DIGI_UPDATE_VERIFY_ALGO);
+}
+
+/*
+ * Get the digest of the data read back and compare it with @expect.
+ * The function returns:
+ *	0 if the digests match
+ *	-EBADMSG if they do not, or not all the data was read back
+ */
+int update_verify_finish(struct update_verify *uv, const u8 *expect)
+{
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	int ret;
+
+	ret = hash_stream_finish(&uv->hs, digest, sizeof(digest));
+	if (ret)
+		return ret;
+	if (uv->left || memcmp(digest, expect, uv->hs.algo->digest_size))
+		return -EBADMSG;
+
+	return 0;
+}
 #endif /* CONFIG_CMD_UPDATE */
 
 static int get_default_devpartno(int src, char *devpartno)
@@ -889,29 +942,6 @@ u64 memsize_parse(const char *const ptr, const char **retptr)
 	return ret;
 }
 
-/*
- * Calculate a RAM address for verification during update command.
- * To make the better use of RAM, calculate it around half way through the
- * available RAM, but skipping reserved areas.
- */
-void set_verifyaddr(unsigned long loadaddr)
-{
-	unsigned long verifyaddr;
-
-	verifyaddr = loadaddr + ((gd->ram_size -
-				   (loadaddr - CONFIG_SYS_SDRAM_BASE)) / 2);
-
-	 /* Skip reserved memory area */
-#if defined(RESERVED_MEM_START) && defined(RESERVED_MEM_END)
-	if (verifyaddr >= RESERVED_MEM_START && verifyaddr < RESERVED_MEM_END)
-		verifyaddr = RESERVED_MEM_END;
-#endif
-
-	 if (verifyaddr > loadaddr &&
-	     verifyaddr < (CONFIG_SYS_SDRAM_BASE + gd->ram_size))
-		 env_set_hex("verifyaddr", verifyaddr);
- }
-
 /**
  * Validate a bootloader image in memory to see if it's apt for the board.
  * This function can be redefined per platform, to implement specific
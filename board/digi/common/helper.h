@@ -11,6 +11,8 @@
 #define __DIGI_HELPER_H
 
 #include <blk.h>
+#include <hash.h>
+#include <stream.h>
 #include <jffs2/load_kernel.h>
 
 enum {
@@ -56,6 +58,17 @@ struct load_fw {
 #define UBIFS_MAGIC		0x06101831
 #define SQUASHFS_MAGIC		0x73717368
 
+/*
+ * Verification of written firmware: the digest of the image in RAM is
+ * compared with that of the data read back from the media, which is fed
+ * to @sink a piece at a time.
+ */
+struct update_verify {
+	struct stream_sink sink;	/* consumer for the data read back */
+	struct hash_stream hs;		/* digest of the data read back */
+	u64 left;			/* bytes of the image still to come */
+};
+
 int confirm_msg(char *msg);
 int get_source(int argc, char * const argv[], struct load_fw *fwinfo);
 bool is_image_compressed(void);
@@ -82,7 +95,22 @@ int media_write_block(uintptr_t addr, unsigned char *readbuf, uint hwpart);
 size_t media_get_block_size(void);
 uint get_env_hwpart(void);
 u64 memsize_parse(const char *const ptr, const char **retptr);
-void set_verifyaddr(unsigned long loadaddr);
+int update_digest(const void *buf, unsigned long len, u8 *digest);
+int update_verify_init(struct update_verify *uv, u64 len);
+int update_verify_finish(struct update_verify *uv, const u8 *expect);
+#ifdef CONFIG_CMD_UPDATE_MMC
+int mmc_verify_written(struct blk_desc *mmc_dev, lbaint_t start,
+		       const void *src, unsigned long len);
+int mmc_write_changed(struct blk_desc *mmc_dev, lbaint_t start,
+		      const void *src, unsigned long len,
+		      unsigned long *written);
+#endif
+#ifdef CONFIG_CMD_UPDATE_NAND
+int nand_verify_written(struct part_info *part, const void *src,
+			unsigned long len);
+int nand_write_changed(struct part_info *part, const void *src,
+		       unsigned long len, unsigned long *written);
+#endif
 bool validate_bootloader_image(void *loadaddr);
 int hab_event_warning_check(uint8_t *event, size_t *bytes);
 #ifdef CONFIG_AUTHENTICATE_SQUASHFS_ROOTFS
@@ -8,16 +8,24 @@
 */
 #include <asm/cache.h>
 #include <common.h>
+#include <asm/global_data.h>
 #ifdef CONFIG_FSL_ESDHC_IMX
 #include <fsl_esdhc_imx.h>
 #endif
+#include <blk.h>
 #include <env.h>
 #include <mmc.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <otf_update.h>
+#include <stream.h>
+#include "helper.h"
+#include <linux/sizes.h>
 
 #define ALIGN_SUP(x, a) (((x) + (a - 1)) & ~(a - 1))
 
+DECLARE_GLOBAL_DATA_PTR;
+
 extern int mmc_get_bootdevindex(void);
 
 /*
@@ -146,18 +154,221 @@ uint get_env_hwpart(void)
 	return mmc_get_env_part(mmc);
 }
 
+/*
+ * Check the first @len bytes of the blocks from @start against a digest,
+ * reading them back a piece at a time.
+ * The function returns:
+ *	0 if the data matches
+ *	-EIO if the media could not be read
+ *	-EBADMSG if the data does not match
+ */
+static int verify_digest(struct blk_desc *mmc_dev, lbaint_t start, u64 len,
+			 const u8 *expect)
+{
+	lbaint_t blkcnt = DIV_ROUND_UP(len, mmc_dev->blksz);
+	struct update_verify uv;
+	long read;
+	int ret;
+
+	ret = update_verify_init(&uv, len);
+	if (ret)
+		return ret;
+
+	read = blk_dread_stream(mmc_dev, start, blkcnt,
+				SZ_1M / mmc_dev->blksz, &uv.sink);
+	ret = update_verify_finish(&uv, expect);
+	if (read != blkcnt)
+		return -EIO;
+
+	return ret;
+}
+
+/*
+ * Verify data written to the media without a second copy of it in RAM, by
+ * comparing the digest of @src with that of the data read back.
+ * The function returns:
+ *	0 if the data matches
+ *	-EIO if the media could not be read
+ *	-EBADMSG if the data does not match
+ */
+int mmc_verify_written(struct blk_desc *mmc_dev, lbaint_t start,
+		       const void *src, unsigned long len)
+{
+	u8 expect[HASH_MAX_DIGEST_SIZE];
+	int ret;
+
+	ret = update_digest(src, len, expect);
+	if (ret)
+		return ret;
+
+	return verify_digest(mmc_dev, start, len, expect);
+}
+
+/*
+ * Write @src to the media starting at block @start, skipping the regions
+ * that already hold the same data. The media is read and compared
+ * CONFIG_DIGI_UPDATE_COMPARE_CHUNK bytes at a time and runs of differing
+ * regions are written with a single request.
+ * The function returns:
+ *	0 if success, with the number of bytes actually written in @written
+ *	-ENOMEM if out of memory
+ *	-EIO if the media could not be read or written
+ */
+int mmc_write_changed(struct blk_desc *mmc_dev, lbaint_t start,
+		      const void *src, unsigned long len,
+		      unsigned long *written)
+{
+	lbaint_t chunk = CONFIG_DIGI_UPDATE_COMPARE_CHUNK / mmc_dev->blksz;
+	lbaint_t blkcnt = DIV_ROUND_UP(len, mmc_dev->blksz);
+	lbaint_t blk, cnt, dirty = 0, ndirty = 0;
+	unsigned long off, n;
+	void *buf;
+	int ret = 0;
+
+	*written = 0;
+	buf = malloc_cache_aligned(chunk * mmc_dev->blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	for (blk = 0; blk <= blkcnt; blk += cnt) {
+		cnt = min(chunk, blkcnt - blk);
+		off = blk * mmc_dev->blksz;
+		/* the padding of the last block is not compared */
+		n = min_t(unsigned long, cnt * mmc_dev->blksz, len - off);
+
+		if (cnt && blk_dread(mmc_dev, start + blk, cnt, buf) != cnt) {
+			ret = -EIO;
+			break;
+		}
+		if (cnt && memcmp(buf, src + off, n)) {
+			if (!ndirty)
+				dirty = blk;
+			ndirty += cnt;
+			continue;
+		}
+
+		/* write the run of differing regions before this one */
+		if (ndirty) {
+			if (blk_dwrite(mmc_dev, start + dirty, ndirty,
+				       src + dirty * mmc_dev->blksz) != ndirty) {
+				ret = -EIO;
+				break;
+			}
+			*written += ndirty * mmc_dev->blksz;
+			ndirty = 0;
+		}
+		if (!cnt)
+			break;
+	}
+	free(buf);
+
+	return ret;
+}
+
 #ifdef CONFIG_FSL_ESDHC_IMX
 extern int mmc_get_bootdevindex(void);
 
-static int write_chunk(struct mmc *mmc, struct blk_desc *mmc_dev,
+/*
+ * Raw images are written through two RAM buffers: while one chunk is being
+ * written to the media, the next one keeps filling from the source. The
+ * write is done a slice at a time from OTF_FLAG_IDLE calls, which the
+ * source makes while it waits for more data (TFTP does so right after
+ * acknowledging a window), so that the transfer keeps flowing instead of
+ * stalling (and being retransmitted) while a whole chunk is written.
+ *
+ * Rather than reading back every chunk into $verifyaddr, a digest of the
+ * image is kept as each chunk is received and another one as its slices
+ * are handed to the media, and both are compared at the end. This catches
+ * a buffer being overwritten while its chunk is still in flight.
+ */
+#define OTF_BUF_SIZE	ALIGN(CONFIG_OTF_CHUNK + SZ_64K, SZ_64K)
+
+struct otf_pipeline {
+	void *buf[2];		/* receive buffers */
+	int cur;		/* index of the buffer being filled */
+	void *wbuf;		/* data of the chunk being written */
+	lbaint_t wblk;		/* next block of it to write */
+	lbaint_t wleft;		/* blocks of it still to write */
+	unsigned int wbytes;	/* bytes of the chunk in flight to hash */
+	struct hash_stream hs;	/* digest of the bytes queued */
+	struct hash_stream whs;	/* digest of the bytes written */
+};
+
+static struct otf_pipeline otfp;
+
+static int otf_pipeline_init(otf_data_t *otfd)
+{
+	ulong ram_top = gd->bd->bi_dram[0].start + gd->bd->bi_dram[0].size -
+			CONFIG_UBOOT_RESERVED;
+
+	/* Both buffers must lie below the RAM reserved for U-Boot */
+	if ((ulong)otfd->loadaddr + 2 * OTF_BUF_SIZE > ram_top) {
+		printf("[Error]: 0x%x bytes of buffers at 0x%p overlap U-Boot\n",
+		       2 * OTF_BUF_SIZE, otfd->loadaddr);
+		return -1;
+	}
+
+	otfp.buf[0] = otfd->loadaddr;
+	otfp.buf[1] = otfd->loadaddr + OTF_BUF_SIZE;
+	otfp.cur = 0;
+	otfp.wleft = 0;
+	otfp.wbytes = 0;
+
+	/* the contexts are freed by hash_stream_finish() */
+	if (otfp.hs.ctx)
+		hash_stream_finish(&otfp.hs, NULL, 0);
+	if (otfp.whs.ctx)
+		hash_stream_finish(&otfp.whs, NULL, 0);
+
+	if (hash_stream_init(&otfp.hs, CONFIG_DIGI_UPDATE_VERIFY_ALGO))
+		return -1;
+
+	return hash_stream_init(&otfp.whs, CONFIG_DIGI_UPDATE_VERIFY_ALGO);
+}
+
+/* Write up to @max blocks of the chunk in flight */
+static int otf_write_slice(struct blk_desc *mmc_dev, lbaint_t max)
+{
+	lbaint_t cnt = min(otfp.wleft, max);
+	unsigned long written;
+	unsigned int len;
+
+	if (!cnt)
+		return 0;
+
+	/* the padding of the last block is not part of the image */
+	len = min_t(unsigned long, cnt * mmc_dev->blksz, otfp.wbytes);
+	if (stream_write(&otfp.whs.sink, otfp.wbuf, len)) {
+		otfp.wleft = 0;
+		return -1;
+	}
+	otfp.wbytes -= len;
+
+	written = blk_dwrite(mmc_dev, otfp.wblk, cnt, otfp.wbuf);
+	if (written != cnt) {
+		printf("\n[Error]: written sectors != sectors to write\n");
+		otfp.wleft = 0;
+		return -1;
+	}
+	otfp.wbuf += cnt * mmc_dev->blksz;
+	otfp.wblk += cnt;
+	otfp.wleft -= cnt;
+
+	return 0;
+}
+
+/* Finish writing the chunk in flight, so that its buffer can be reused */
+static int otf_drain(struct blk_desc *mmc_dev)
+{
+	return otf_write_slice(mmc_dev, otfp.wleft);
+}
+
+static int queue_chunk(struct mmc *mmc, struct blk_desc *mmc_dev,
 		       otf_data_t *otfd, lbaint_t dstblk,
 		       unsigned int chunklen)
 {
 	int sectors;
-	unsigned long written, read;
-	void *verifyaddr;
 
-	printf("\nWriting chunk...");
 	/* Check WP */
 	if (mmc_getwp(mmc) == 1) {
 		printf("[Error]: card is write protected!\n");
@@ -177,45 +388,39 @@ static int write_chunk(struct mmc *mmc, struct blk_desc *mmc_dev,
 		return -1;
 	}
 
-	/* Write chunklen bytes of chunk to media */
-	debug("writing chunk of 0x%x bytes (0x%x sectors) "
+	debug("queueing chunk of 0x%x bytes (0x%x sectors) "
 		"from 0x%p to block " LBAFU "\n",
 		chunklen, sectors, otfd->loadaddr, dstblk);
-	written = blk_dwrite(mmc_dev, dstblk, sectors, otfd->loadaddr);
-	if (written != sectors) {
-		printf("[Error]: written sectors != sectors to write\n");
+	if (stream_write(&otfp.hs.sink, otfd->loadaddr, chunklen))
+		return -1;
+	otfp.wbuf = otfd->loadaddr;
+	otfp.wblk = dstblk;
+	otfp.wleft = sectors;
+	otfp.wbytes = chunklen;
+
+	return 0;
+}
+
+/* Check that the image written matches the image received */
+static int verify_image(void)
+{
+	u8 expect[HASH_MAX_DIGEST_SIZE];
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	int ret;
+
+	ret = hash_stream_finish(&otfp.hs, expect, sizeof(expect));
+	ret |= hash_stream_finish(&otfp.whs, digest, sizeof(digest));
+	if (ret)
+		return -1;
+
+	printf("\nVerifying image...");
+	if (memcmp(expect, digest, otfp.hs.algo->digest_size)) {
+		printf("[Error]\n");
 		return -1;
 	}
 	printf("[OK]\n");
 
-	/* Verify written chunk if $loadaddr + chunk size does not overlap
-	 * $verifyaddr (where the read-back copy will be placed)
-	 */
-	verifyaddr = (void *) env_get_ulong("verifyaddr", 16, 0);
-	if (otfd->loadaddr + sectors * mmc_dev->blksz < verifyaddr) {
-		/* Read back data... */
-		printf("Reading back chunk...");
-		read = blk_dread(mmc_dev, dstblk, sectors, verifyaddr);
-		if (read != sectors) {
-			printf("[Error]: read sectors != sectors to read\n");
-			return -1;
-		}
-		printf("[OK]\n");
-		/* ...then compare */
-		printf("Verifying chunk...");
-		if (memcmp(otfd->loadaddr, verifyaddr,
-			      sectors * mmc_dev->blksz)) {
-			printf("[Error]\n");
-			return -1;
-		} else {
-			printf("[OK]\n");
-			return 0;
-		}
-	} else {
-		printf("[Warning]: Cannot verify chunk. "
-			"It overlaps $verifyaddr!\n");
-		return 0;
-	}
+	return 0;
 }
 
 #ifdef CONFIG_FASTBOOT_FLASH
@@ -439,6 +644,14 @@ int update_chunk(otf_data_t *otfd)
 		}
 	}
 
+	/*
+	 * The source is waiting for more data (e.g. TFTP has acknowledged a
+	 * window), so move the chunk in flight along by one slice.
+	 */
+	if (otfd->flags & OTF_FLAG_IDLE)
+		return otf_write_slice(mmc_dev,
+				       CONFIG_OTF_WRITE_SLICE / mmc_dev->blksz);
+
 	/*
 	 * There are two variants:
 	 *  - otfd.buf == NULL
@@ -462,6 +675,8 @@ int update_chunk(otf_data_t *otfd)
 		chunk_len = 0;
 		dstblk = otfd->part->start;
 		otfd->flags &= ~OTF_FLAG_INIT;
+		if (otf_pipeline_init(otfd))
+			return -1;
 
 #ifdef CONFIG_FASTBOOT_FLASH
 		if (is_sparse_image(otfd->loadaddr)) {
@@ -495,6 +710,7 @@ int update_chunk(otf_data_t *otfd)
 	 * set) write it to storage.
 	 */
 	if (chunk_len >= CONFIG_OTF_CHUNK || (otfd->flags & OTF_FLAG_FLUSH)) {
+		void *next = otfd->loadaddr;
 		unsigned int remaining;
 
 #ifdef CONFIG_FASTBOOT_FLASH
@@ -534,20 +750,26 @@ int update_chunk(otf_data_t *otfd)
 				/* chunk_len is now multiple of blksz */
 			}
 
-			if (write_chunk(mmc, mmc_dev, otfd, dstblk, chunk_len))
+			/* The other buffer is only free once its chunk is written */
+			if (otf_drain(mmc_dev) ||
+			    queue_chunk(mmc, mmc_dev, otfd, dstblk, chunk_len))
 				return -1;
 
 			/* increment destiny block */
 			dstblk += (chunk_len / mmc_dev->blksz);
+
+			/* keep receiving into the other buffer */
+			otfp.cur = !otfp.cur;
+			next = otfp.buf[otfp.cur];
 		}
 
 		/* copy excess of bytes from previous chunk to offset 0 */
 		if (remaining) {
-			memcpy(otfd->loadaddr, otfd->loadaddr + chunk_len,
-			       remaining);
+			memcpy(next, otfd->loadaddr + chunk_len, remaining);
 			debug("Copying excess of %d bytes to offset 0\n",
 			      remaining);
 		}
+		otfd->loadaddr = next;
 		/* reset chunk_len to excess of bytes from previous chunk
 		 * (or zero, if that's the case) */
 		chunk_len = remaining;
@@ -558,6 +780,11 @@ int update_chunk(otf_data_t *otfd)
 	 * Reset all static variables.
 	 */
 	if (otfd->flags & OTF_FLAG_FLUSH) {
+		if (otf_drain(mmc_dev))
+			return -1;
+		if (!(otfd->flags & OTF_FLAG_SPARSE) && verify_image())
+			return -1;
+
 		chunk_len = 0;
 		dstblk = 0;
 		mmc_dev = NULL;
@@ -7,9 +7,12 @@
  *  the Free Software Foundation.
 */
 #include <common.h>
+#include <malloc.h>
 #include <nand.h>
 #include "helper.h"
 #include <env.h>
+#include <linux/errno.h>
+#include <linux/mtd/mtd.h>
 
 /*
  * Get the block size of the storage media.
@@ -125,3 +128,138 @@ uint get_env_hwpart(void)
 {
 	return 0;
 }
+
+#ifdef CONFIG_CMD_UPDATE
+/*
+ * Verify data raw-written to a partition without a second copy of it in
+ * RAM, by comparing the digest of @src with that of the data read back one
+ * erase block at a time. Bad blocks are skipped like 'nand write' does.
+ * The function returns:
+ *	0 if the data matches
+ *	-EIO if the media could not be read
+ *	-EBADMSG if the data does not match
+ */
+int nand_verify_written(struct part_info *part, const void *src,
+			unsigned long len)
+{
+	struct mtd_info *nand = get_nand_dev_by_index(0);
+	u8 expect[HASH_MAX_DIGEST_SIZE];
+	loff_t off = part->offset;
+	loff_t end = part->offset + part->size;
+	struct update_verify uv;
+	u_char *buf;
+	int ret, verify;
+
+	ret = update_digest(src, len, expect);
+	if (ret)
+		return ret;
+
+	buf = malloc(nand->erasesize);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = update_verify_init(&uv, len);
+	if (ret)
+		goto out;
+
+	while (uv.left && !ret) {
+		size_t rdlen = min_t(u64, uv.left, nand->erasesize);
+
+		if (off >= end) {
+			ret = -EIO;
+			break;
+		}
+		if (nand_block_isbad(nand, off)) {
+			off += nand->erasesize;
+			continue;
+		}
+
+		ret = nand_read(nand, off, &rdlen, buf);
+		if (ret && !mtd_is_bitflip(ret)) {
+			ret = -EIO;
+			break;
+		}
+		ret = stream_write(&uv.sink, buf, rdlen);
+		off += nand->erasesize;
+	}
+
+	verify = update_verify_finish(&uv, expect);
+	if (!ret)
+		ret = verify;
+out:
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * Raw-write @src to a partition, touching only the erase blocks whose
+ * contents differ from the new ones. Blocks which are already blank are
+ * written without erasing them first, and the blocks past the end of the
+ * image are only erased if they are not blank, so the partition ends up as
+ * after 'nand erase.part' plus 'nand write'. Bad blocks are skipped.
+ * The function returns:
+ *	0 if success, with the number of bytes actually written in @written
+ *	-ENOMEM if out of memory
+ *	-ENOSPC if the image does not fit in the good blocks of the partition
+ *	-EIO if the media could not be read, erased or written
+ */
+int nand_write_changed(struct part_info *part, const void *src,
+		       unsigned long len, unsigned long *written)
+{
+	struct mtd_info *nand = get_nand_dev_by_index(0);
+	loff_t off = part->offset;
+	loff_t end = part->offset + part->size;
+	unsigned long done = 0;
+	u_char *buf, *data;
+	size_t rdlen, n;
+	int ret = 0;
+
+	*written = 0;
+	buf = malloc(2 * nand->erasesize);
+	if (!buf)
+		return -ENOMEM;
+	data = buf + nand->erasesize;
+
+	for (; off < end; off += nand->erasesize) {
+		if (nand_block_isbad(nand, off))
+			continue;
+
+		/* new contents of the block, padded as if freshly erased */
+		n = min_t(unsigned long, len - done, nand->erasesize);
+		memcpy(data, src + done, n);
+		memset(data + n, 0xff, nand->erasesize - n);
+		done += n;
+
+		rdlen = nand->erasesize;
+		ret = nand_read(nand, off, &rdlen, buf);
+		if (ret && !mtd_is_bitflip(ret)) {
+			ret = -EIO;
+			break;
+		}
+		ret = 0;
+		if (!memcmp(buf, data, nand->erasesize))
+			continue;
+
+		if (memchr_inv(buf, 0xff, nand->erasesize) &&
+		    nand_erase(nand, off, nand->erasesize)) {
+			ret = -EIO;
+			break;
+		}
+		if (!n)
+			continue;
+
+		rdlen = ALIGN(n, nand->writesize);
+		if (nand_write(nand, off, &rdlen, data)) {
+			ret = -EIO;
+			break;
+		}
+		*written += n;
+	}
+	free(buf);
+	if (!ret && done < len)
+		ret = -ENOSPC;
+
+	return ret;
+}
+#endif
@@ -7,43 +7,64 @@
 #include <command.h>
 #include <config.h>
 #include <common.h>
+#include <blk.h>
 #include <malloc.h>
 #include <part.h>
 
 static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
+	struct block_cache_dev_stats dev_stats;
 	struct block_cache_stats stats;
+	int i;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "readahead blocks: %u\n"
 	       "entries: %u\n"
-	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "cache size: %lu KiB\n"
+	       "blocks/entry: %u\n"
+	       "max cache size: %lu KiB\n"
+	       "readahead: %u blocks\n",
+	       stats.hits, stats.misses, stats.readahead, stats.entries,
+	       stats.bytes / 1024, stats.max_blocks_per_entry,
+	       stats.max_bytes / 1024, stats.readahead_blocks);
+
+	for (i = 0; !blkcache_dev_stats(i, &dev_stats); i++)
+		printf("%s %d: hits %u, misses %u, readahead blocks %u\n",
+		       blk_get_if_type_name(dev_stats.iftype),
+		       dev_stats.devnum, dev_stats.hits, dev_stats.misses,
+		       dev_stats.readahead);
+
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	unsigned blocks_per_entry, max_kbytes, readahead;
+	unsigned long max_bytes;
+
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
+	blkcache_get_config(&blocks_per_entry, &max_bytes, &readahead);
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	max_kbytes = simple_strtoul(argv[2], 0, 0);
+	if (argc == 4)
+		readahead = simple_strtoul(argv[3], 0, 0);
+	blkcache_configure(blocks_per_entry, max_kbytes * 1024UL, readahead);
+	printf("changed to max of %u KiB in entries of %u blocks each, "
+	       "readahead %u blocks\n", max_kbytes, blocks_per_entry,
+	       readahead);
 	return 0;
 }
 
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -80,9 +101,9 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
-	"show - show and reset statistics\n"
-	"blkcache configure <blocks> <entries> "
-	"- set max blocks per entry and max cache entries\n"
+	"show - show and reset global and per-device statistics\n"
+	"blkcache configure <blocks> <kbytes> [<readahead>] "
+	"- set blocks per entry, memory budget and readahead blocks\n"
 );
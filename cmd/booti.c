@@ -171,7 +171,7 @@ static char booti_help_text[] =
 	"\tThe argument 'initrd' is optional and specifies the address\n"
 	"\tof an initrd in memory. The optional parameter ':size' allows\n"
 	"\tspecifying the size of a RAW initrd.\n"
-	"\tCurrently only booting from gz, bz2, lzma and lz4 compression\n"
+	"\tCurrently only booting from gz, bz2, lzma, lz4 and zstd compression\n"
 	"\ttypes are supported. In order to boot from any of these compressed\n"
 	"\timages, user have to set kernel_comp_addr_r and kernel_comp_size environment\n"
 	"\tvariables beforehand.\n"
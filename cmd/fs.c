@@ -41,6 +41,25 @@ U_BOOT_CMD(
 	"      If 'pos' is 0 or omitted, the file is read from the start."
 )
 
+#ifdef CONFIG_CMD_ZLOAD
+static int do_zload_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	return do_zload(cmdtp, flag, argc, argv, FS_TYPE_ANY);
+}
+
+U_BOOT_CMD(
+	zload,	5,	0,	do_zload_wrapper,
+	"load and decompress a file from a filesystem",
+	"<interface> [<dev[:part]> [<addr> [<filename>]]]\n"
+	"    - Load file 'filename' from partition 'part' on device\n"
+	"       type 'interface' instance 'dev' to address 'addr' in memory,\n"
+	"      decompressing it while it is read. gzip, lz4 and zstd files\n"
+	"      are decompressed, other files are loaded as they are.\n"
+	"      'filesize' is set to the uncompressed size."
+)
+#endif
+
 static int do_save_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
 			   char *const argv[])
 {
@@ -13,6 +13,7 @@
 #include <command.h>
 #include <hash.h>
 #include <linux/ctype.h>
+#include <linux/sizes.h>
 
 static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 		   char *const argv[])
@@ -20,6 +21,17 @@ static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 	char *s;
 	int flags = HASH_FLAG_ENV;
 
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		ulong size = SZ_1M;
+
+		if (argc > 2)
+			size = hextoul(argv[2], NULL);
+		if (!size || hash_bench(size))
+			return CMD_RET_FAILURE;
+
+		return 0;
+	}
+
 #ifdef CONFIG_HASH_VERIFY
 	if (argc < 4)
 		return CMD_RET_USAGE;
@@ -53,4 +65,7 @@ U_BOOT_CMD(
 		"    - verify message digest of memory area to immediate value, \n"
 		"      env var or *address"
 #endif
+	"\nhash bench [size]\n"
+		"    - show the speed of each algorithm on a buffer of 'size'\n"
+		"      bytes (default 0x100000)"
 );
@@ -34,6 +34,9 @@
 
 /* Private own data */
 static struct ubi_device *ubi;
+/* How the current device was attached, see ubi_part_attached() */
+static char ubi_vid_header_offset[16];
+static unsigned long ubi_other_writes;
 
 int ubi_silent = 0;
 
@@ -767,6 +770,22 @@ int is_ubi_attached(char *part_name)
 }
 #endif
 
+/*
+ * Check whether @part_name is attached already with the same VID header
+ * offset, and no MTD device has been changed by anything other than UBI
+ * since then.
+ */
+static bool ubi_part_attached(const char *part_name,
+			      const char *vid_header_offset)
+{
+	if (!IS_ENABLED(CONFIG_MTD_UBI_KEEP_ATTACHED) || !ubi)
+		return false;
+
+	return !strcmp(ubi->mtd->name, part_name) &&
+	       !strcmp(ubi_vid_header_offset, vid_header_offset ?: "") &&
+	       mtd_write_count() - ubi->mtd_writes == ubi_other_writes;
+}
+
 int ubi_part(char *part_name, const char *vid_header_offset)
 {
 	struct mtd_info *mtd;
@@ -777,6 +796,9 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 		return 0;
 #endif
 
+	if (ubi_part_attached(part_name, vid_header_offset))
+		return 0;
+
 	ubi_detach();
 
 	mtd_probe_devices();
@@ -795,6 +817,9 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 	}
 
 	ubi = ubi_devices[0];
+	strlcpy(ubi_vid_header_offset, vid_header_offset ?: "",
+		sizeof(ubi_vid_header_offset));
+	ubi_other_writes = mtd_write_count() - ubi->mtd_writes;
 
 	return 0;
 }
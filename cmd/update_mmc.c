@@ -13,9 +13,11 @@
 #ifdef CONFIG_FASTBOOT_FLASH
 #include <image-sparse.h>
 #endif
+#include <mapmem.h>
 #include <mmc.h>
 #include <otf_update.h>
 #include <part.h>
+#include <linux/errno.h>
 #include "../board/digi/common/helper.h"
 
 #ifdef CONFIG_FSL_FASTBOOT
@@ -104,7 +106,8 @@ static int write_firmware(char *partname, unsigned long loadaddr,
 			  unsigned long filesize, struct disk_partition *info)
 {
 	char cmd[CONFIG_SYS_CBSIZE] = "";
-	unsigned long size_blks, verifyaddr, u, m;
+	unsigned long size_blks;
+	int ret;
 
 #ifdef CONFIG_FASTBOOT_FLASH
 	if (is_sparse_image((void *)loadaddr)) {
@@ -161,66 +164,34 @@ static int write_firmware(char *partname, unsigned long loadaddr,
 		return -1;
 	}
 
-	/* Write firmware command */
-	sprintf(cmd, "%s write %lx %lx %lx", CONFIG_SYS_STORAGE_MEDIA,
-		loadaddr, info->start, size_blks);
-	if (run_command(cmd, 0))
-		return ERR_WRITE;
-
-	/* If there is enough RAM to hold two copies of the firmware,
-	 * verify written firmware.
-	 * +--------|---------------------|------------------|--------------+
-	 * |        L                     V                  | U-Boot+Stack |
-	 * +--------|---------------------|------------------|--------------+
-	 * P                                                 U              M
-	 *
-	 *  P = CONFIG_SYS_SDRAM_BASE (base address of SDRAM)
-	 *  L = $loadaddr
-	 *  V = $verifyaddr
-	 *  M = last address of SDRAM ((size of SDRAM) + P)
-	 *  U = SDRAM address where U-Boot is located (plus margin)
-	 */
-	verifyaddr = env_get_ulong("verifyaddr", 16, 0);
-	m = CONFIG_SYS_SDRAM_BASE + gd->ram_size;
-	u = m - CONFIG_UBOOT_RESERVED;
+	if (env_get_yesno("incremental-update") == 1) {
+		unsigned long written;
 
-	/* ($loadaddr + firmware size) must not exceed $verifyaddr
-	 * ($verifyaddr + firmware size) must not exceed U
-	 */
-	if ((loadaddr + size_blks * mmc_dev->blksz) < verifyaddr &&
-	    (verifyaddr + size_blks * mmc_dev->blksz) < u) {
-		unsigned long filesize_padded;
-		int i;
-
-		/* Read back data... */
-		printf("Reading back firmware...\n");
-		sprintf(cmd, "%s read %lx %lx %lx", CONFIG_SYS_STORAGE_MEDIA,
-			verifyaddr, info->start, size_blks);
-		if (run_command(cmd, 0))
-			return ERR_READ;
-		/* ...then compare by 32-bit words (faster than by bytes)
-		 * padding with zeros any bytes at the end to make the size
-		 * be a multiple of 4.
-		 *
-		 * Reference: http://stackoverflow.com/a/2022252
-		 */
-		printf("Verifying firmware...\n");
-		filesize_padded = (filesize + (4 - 1)) & ~(4 - 1);
-
-		for (i = filesize; i < filesize_padded; i++) {
-			*((char *)loadaddr + i) = 0;
-			*((char *)verifyaddr + i) = 0;
-		}
-		sprintf(cmd, "cmp.l %lx %lx %lx", loadaddr, verifyaddr,
-			(filesize_padded / 4));
-		if (run_command(cmd, 0))
-			return ERR_VERIFY;
-		printf("Update was successful\n");
+		/* Only write the regions that differ from the image */
+		printf("Writing changed blocks...\n");
+		if (mmc_write_changed(mmc_dev, info->start,
+				      map_sysmem(loadaddr, filesize), filesize,
+				      &written))
+			return ERR_WRITE;
+		printf("%lu of %lu bytes written\n", written, filesize);
 	} else {
-		printf("Firmware updated but not verified "
-		       "(not enough available RAM to verify)\n");
+		/* Write firmware command */
+		sprintf(cmd, "%s write %lx %lx %lx", CONFIG_SYS_STORAGE_MEDIA,
+			loadaddr, info->start, size_blks);
+		if (run_command(cmd, 0))
+			return ERR_WRITE;
 	}
 
+	/* Verify written firmware against the image in RAM */
+	printf("Verifying firmware...\n");
+	ret = mmc_verify_written(mmc_dev, info->start,
+				 map_sysmem(loadaddr, filesize), filesize);
+	if (ret == -EIO)
+		return ERR_READ;
+	if (ret)
+		return ERR_VERIFY;
+	printf("Update was successful\n");
+
 	return 0;
 }
 
@@ -373,9 +344,6 @@ static int do_update(struct cmd_tbl* cmdtp, int flag, int argc, char * const arg
 		return CMD_RET_FAILURE;
 
 	loadaddr = env_get_ulong("update_addr", 16, CONFIG_DIGI_UPDATE_ADDR );
-	/* If undefined, calculate 'verifyaddr' */
-	if (NULL == env_get("verifyaddr"))
-		set_verifyaddr(loadaddr);
 
 	if (fwinfo.src == SRC_RAM) {
 		/* Get address in RAM where firmware file is */
@@ -14,6 +14,7 @@
 #include <common.h>
 #include <env.h>
 #include <jffs2/load_kernel.h>
+#include <linux/errno.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/rawnand.h>
 #include <mapmem.h>
@@ -93,7 +94,11 @@ static int write_firmware(unsigned long loadaddr, unsigned long filesize,
 	uint32_t *magic;
 	const char *ubivolname = NULL;
 	char cmd[CONFIG_SYS_CBSIZE] = "";
-	unsigned long verifyaddr, u, m;
+	bool incremental;
+	int ret;
+
+	/* Rewriting only what changed doesn't make sense on a forced erase */
+	incremental = !force_erase && env_get_yesno("incremental-update") == 1;
 
 	if (filesize > part->size) {
 		printf("File size (%lu bytes) exceeds partition size (%lu bytes)!\n",
@@ -131,7 +136,7 @@ static int write_firmware(unsigned long loadaddr, unsigned long filesize,
 				ubi_attach_getcreatevol(part->name, &ubivolname);
 			}
 		}
-	} else {
+	} else if (!incremental) {
 		/*
 		 * If the file is not UBIFS, erase the entire partition before
 		 * raw-writing.
@@ -142,17 +147,31 @@ static int write_firmware(unsigned long loadaddr, unsigned long filesize,
 	}
 #endif /* CONFIG_DIGI_UBI */
 
-	if (ubivolname) {
-		/* A UBI volume exists in the partition, use 'ubi write' */
-		sprintf(cmd, "ubi write %lx %s %lx", loadaddr, ubivolname,
-			filesize);
+	if (!ubivolname && incremental) {
+		unsigned long written;
+
+		/*
+		 * Only erase and write the blocks that differ from the image,
+		 * leaving the rest of the partition as 'nand erase.part' would
+		 */
+		printf("Writing changed blocks...\n");
+		if (nand_write_changed(part, map_sysmem(loadaddr, filesize),
+				       filesize, &written))
+			return ERR_WRITE;
+		printf("%lu of %lu bytes written\n", written, filesize);
 	} else {
-		/* raw-write firmware command */
-		sprintf(cmd, "nand write %lx %s %lx", loadaddr, part->name,
-			filesize);
+		if (ubivolname) {
+			/* A UBI volume exists in the partition, use 'ubi write' */
+			sprintf(cmd, "ubi write %lx %s %lx", loadaddr,
+				ubivolname, filesize);
+		} else {
+			/* raw-write firmware command */
+			sprintf(cmd, "nand write %lx %s %lx", loadaddr,
+				part->name, filesize);
+		}
+		if (run_command(cmd, 0))
+			return ERR_WRITE;
 	}
-	if (run_command(cmd, 0))
-		return ERR_WRITE;
 
 #ifdef CONFIG_DIGI_UBI
 	/* If it is a UBIFS file system, verify it using a special function */
@@ -167,62 +186,15 @@ static int write_firmware(unsigned long loadaddr, unsigned long filesize,
 	}
 #endif
 
-	/*
-	 * If there is enough RAM to hold two copies of the firmware,
-	 * verify written firmware.
-	 * +--------|---------------------|------------------|--------------+
-	 * |        L                     V                  | U-Boot+Stack |
-	 * +--------|---------------------|------------------|--------------+
-	 * P                                                 U              M
-	 *
-	 *  P = CONFIG_SYS_SDRAM_BASE (base address of SDRAM)
-	 *  L = $loadaddr
-	 *  V = $verifyaddr
-	 *  M = last address of SDRAM ((size of SDRAM) + P)
-	 *  U = SDRAM address where U-Boot is located (plus margin)
-	 */
-	verifyaddr = env_get_ulong("verifyaddr", 16, 0);
-	m = CONFIG_SYS_SDRAM_BASE + gd->ram_size;
-	u = m - CONFIG_UBOOT_RESERVED;
-
-	/*
-	 * ($loadaddr + firmware size) must not exceed $verifyaddr
-	 * ($verifyaddr + firmware size) must not exceed U.
-	 */
-	if ((loadaddr + filesize) < verifyaddr &&
-	    (verifyaddr + filesize) < u) {
-		unsigned long filesize_padded;
-		int i;
-
-		/* Read back data... */
-		printf("Reading back firmware...\n");
-		sprintf(cmd, "nand read %lx %s %lx", verifyaddr, part->name,
-			filesize);
-		if (run_command(cmd, 0))
-			return ERR_READ;
-		/*
-		 * ...then compare by 32-bit words (faster than by bytes)
-		 * padding with zeros any bytes at the end to make the size
-		 * be a multiple of 4.
-		 *
-		 * Reference: http://stackoverflow.com/a/2022252
-		 */
-		printf("Verifying firmware...\n");
-		filesize_padded = (filesize + (4 - 1)) & ~(4 - 1);
-
-		for (i = filesize; i < filesize_padded; i++) {
-			*((char *)loadaddr + i) = 0;
-			*((char *)verifyaddr + i) = 0;
-		}
-		sprintf(cmd, "cmp.l %lx %lx %lx", loadaddr, verifyaddr,
-			(filesize_padded / 4));
-		if (run_command(cmd, 0))
-			return ERR_VERIFY;
-		printf("Update was successful\n");
-	} else {
-		printf("Firmware updated but not verified "
-		       "(not enough available RAM to verify)\n");
-	}
+	/* Verify written firmware against the image in RAM */
+	printf("Verifying firmware...\n");
+	ret = nand_verify_written(part, map_sysmem(loadaddr, filesize),
+				  filesize);
+	if (ret == -EIO)
+		return ERR_READ;
+	if (ret)
+		return ERR_VERIFY;
+	printf("Update was successful\n");
 
 	return 0;
 }
@@ -338,9 +310,6 @@ static int do_update(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv
 		return CMD_RET_FAILURE;
 
 	loadaddr = env_get_ulong("update_addr", 16, CONFIG_DIGI_UPDATE_ADDR);
-	/* If undefined, calculate 'verifyaddr' */
-	if (NULL == env_get("verifyaddr"))
-		set_verifyaddr(loadaddr);
 
 	if (fwinfo.src == SRC_RAM) {
 		/* Get address in RAM where firmware file is */
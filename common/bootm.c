@@ -21,7 +21,9 @@
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 #include <linux/sizes.h>
+#include <linux/zstd.h>
 #ifdef CONFIG_AUTH_ARTIFACTS
 #include "../board/digi/common/auth.h"
 #endif
@@ -37,7 +39,10 @@
 #include <image.h>
 
 #ifndef CONFIG_SYS_BOOTM_LEN
-/* use 8MByte as default max gunzip size */
+/*
+ * use 8MByte as default max gunzip size, where lmb does not know the
+ * memory at the load address
+ */
 #define CONFIG_SYS_BOOTM_LEN	0x800000
 #endif
 
@@ -345,10 +350,12 @@ static int bootm_find_other(struct cmd_tbl *cmdtp, int flag, int argc,
  *
  * @comp_type:		Compression type being used (IH_COMP_...)
  * @uncomp_size:	Number of bytes uncompressed
+ * @buf_size:		Space that was available for the uncompressed data
  * @ret:		errno error code received from compression library
  * @return Appropriate BOOTM_ERR_ error code
  */
-static int handle_decomp_error(int comp_type, size_t uncomp_size, int ret)
+static int handle_decomp_error(int comp_type, size_t uncomp_size,
+			       size_t buf_size, int ret)
 {
 	const char *name = genimg_get_comp_name(comp_type);
 
@@ -356,8 +363,9 @@ static int handle_decomp_error(int comp_type, size_t uncomp_size, int ret)
 	if (ret == -ENOSYS)
 		return BOOTM_ERR_UNIMPLEMENTED;
 
-	if (uncomp_size >= CONFIG_SYS_BOOTM_LEN)
-		printf("Image too large: increase CONFIG_SYS_BOOTM_LEN\n");
+	if (uncomp_size >= buf_size)
+		printf("Image too large: only %#zx bytes free at load address\n",
+		       buf_size);
 	else
 		printf("%s: uncompress error %d\n", name, ret);
 
@@ -376,7 +384,208 @@ static int handle_decomp_error(int comp_type, size_t uncomp_size, int ret)
 #endif
 
 #ifndef USE_HOSTCC
-static int bootm_load_os(bootm_headers_t *images, int boot_progress)
+/* Reduce @limit so that the space at @load stops before @addr */
+static ulong bootm_clip_limit(ulong limit, ulong load, ulong addr)
+{
+	if (addr > load && addr - load < limit)
+		return addr - load;
+
+	return limit;
+}
+
+/**
+ * bootm_keep_blob() - check whether the OS image blob is still needed
+ *
+ * Once the OS is loaded, the compressed OS data is finished with. The rest
+ * of a FIT (its other images and the structure describing them) and the
+ * other components of a legacy multi-image may still be needed. A plain
+ * legacy image is not, since bootm keeps a copy of its header.
+ *
+ * @images:	Images being booted
+ * @return true if the blob, apart from the OS data, must be preserved
+ */
+static bool bootm_keep_blob(bootm_headers_t *images)
+{
+	return !images->legacy_hdr_valid ||
+	       image_get_type(&images->legacy_hdr_os_copy) == IH_TYPE_MULTI;
+}
+
+/**
+ * bootm_blob_end() - find the end of the OS image blob
+ *
+ * A FIT with external data keeps the data of its images after the FIT
+ * structure, so this data is part of the blob too.
+ *
+ * @images:	Images being booted
+ * @return address just past the end of the blob
+ */
+static ulong bootm_blob_end(bootm_headers_t *images)
+{
+	ulong end = images->os.end;
+#if IMAGE_ENABLE_FIT
+	const void *fit = images->fit_hdr_os;
+	int images_noffset, noffset, offset, size;
+	ulong base;
+
+	if (images->legacy_hdr_valid || !fit)
+		return end;
+
+	base = map_to_sysmem(fit);
+	images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
+	fdt_for_each_subnode(noffset, fit, images_noffset) {
+		if (fit_image_get_data_size(fit, noffset, &size))
+			continue;
+		if (!fit_image_get_data_offset(fit, noffset, &offset))
+			offset += ALIGN(fdt_totalsize(fit), 4);
+		else if (fit_image_get_data_position(fit, noffset, &offset))
+			continue;
+		end = max(end, base + offset + size);
+	}
+#endif
+
+	return end;
+}
+
+/**
+ * bootm_overwrites_blob() - check whether a region hits data still needed
+ *
+ * @images:	Images being booted
+ * @start:	Start of the region
+ * @end:	End of the region (exclusive)
+ * @return true if the region overlaps part of the OS image blob which must
+ * be preserved, i.e. anything apart from the OS data itself
+ */
+static bool bootm_overwrites_blob(bootm_headers_t *images, ulong start,
+				  ulong end)
+{
+	image_info_t *os = &images->os;
+	ulong blob_end, data_end;
+
+	if (!bootm_keep_blob(images) || start >= end)
+		return false;
+
+	blob_end = bootm_blob_end(images);
+	data_end = os->image_start + os->image_len;
+
+	return (os->start < os->image_start && start < os->image_start &&
+		end > os->start) ||
+	       (data_end < blob_end && start < blob_end && end > data_end);
+}
+
+/**
+ * bootm_load_limit() - find out how much space there is for the OS image
+ *
+ * The OS image may use the free memory at its load address up to the next
+ * region reserved in lmb, or the next image which is still needed: the
+ * ramdisk, the device tree and, for a FIT or legacy multi-image, the parts
+ * of the blob around the OS data. If the load address is not in memory
+ * known to lmb, CONFIG_SYS_BOOTM_LEN is used.
+ *
+ * @images:	Images being booted
+ * @load:	Load address of the OS image
+ * @return number of bytes available at @load
+ */
+static ulong bootm_load_limit(bootm_headers_t *images, ulong load)
+{
+	ulong limit = 0;
+
+#ifdef CONFIG_LMB
+	limit = lmb_get_free_size(&images->lmb, load);
+#endif
+	if (!limit)
+		return CONFIG_SYS_BOOTM_LEN;
+
+	if (images->rd_start)
+		limit = bootm_clip_limit(limit, load, images->rd_start);
+	if (images->ft_addr)
+		limit = bootm_clip_limit(limit, load,
+					 map_to_sysmem(images->ft_addr));
+	if (bootm_keep_blob(images)) {
+		ulong data_end = images->os.image_start + images->os.image_len;
+
+		limit = bootm_clip_limit(limit, load, images->os.start);
+		if (data_end < bootm_blob_end(images))
+			limit = bootm_clip_limit(limit, load, data_end);
+	}
+
+	return limit;
+}
+
+/**
+ * bootm_move_image() - move compressed data out of the way of its output
+ *
+ * This moves the data to the top of the space at the load address, so that
+ * the output can use everything below it.
+ *
+ * @load:	Load address of the OS image
+ * @limit:	Number of bytes available at @load
+ * @image_start: Address of the compressed data
+ * @image_len:	Length of the compressed data
+ * @return new address of the compressed data, or 0 if there is no room
+ */
+static ulong bootm_move_image(ulong load, ulong limit, ulong image_start,
+			      ulong image_len)
+{
+	ulong dst;
+
+	if (image_len >= limit)
+		return 0;
+	dst = ALIGN_DOWN(load + limit - image_len, ARCH_DMA_MINALIGN);
+	if (dst <= max(load, image_start))
+		return 0;
+
+	debug("   moving compressed image from 0x%08lx to 0x%08lx\n",
+	      image_start, dst);
+	memmove(map_sysmem(dst, image_len), map_sysmem(image_start, image_len),
+		image_len);
+
+	return dst;
+}
+
+/* image_decomp() takes a uint, so clamp the space to what it can handle */
+static uint bootm_decomp_max(ulong size)
+{
+	return min_t(ulong, size, UINT_MAX);
+}
+
+/**
+ * bootm_uncomp_size() - get the uncompressed size recorded in an image
+ *
+ * @comp:	Compression type being used (IH_COMP_...)
+ * @buf:	Compressed data
+ * @len:	Length of compressed data
+ * @return uncompressed size, or 0 if not known
+ */
+static ulong bootm_uncomp_size(int comp, const void *buf, ulong len)
+{
+	const u8 *p = buf;
+
+	switch (comp) {
+	case IH_COMP_GZIP:
+		/* the trailer ends with the size, modulo 2^32 */
+		if (len > 18)
+			return get_unaligned_le32(p + len - 4);
+		break;
+	case IH_COMP_LZ4:
+		/* the frame may start with the content size */
+		if (len > 14 && (p[4] & 0x08))
+			return get_unaligned_le64(p + 6);
+		break;
+#if CONFIG_IS_ENABLED(ZSTD)
+	case IH_COMP_ZSTD: {
+		unsigned long long size = ZSTD_getFrameContentSize(buf, len);
+
+		if (size < ZSTD_CONTENTSIZE_ERROR)
+			return size;
+		break;
+	}
+#endif
+	}
+
+	return 0;
+}
+
+int bootm_load_os(bootm_headers_t *images, int boot_progress)
 {
 	image_info_t os = images->os;
 	ulong load = os.load;
@@ -386,17 +595,49 @@ static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 	ulong image_start = os.image_start;
 	ulong image_len = os.image_len;
 	ulong flush_start = ALIGN_DOWN(load, ARCH_DMA_MINALIGN);
-	bool no_overlap;
+	ulong limit, size, src;
+	bool in_place;
 	void *load_buf, *image_buf;
 	int err;
 
+	limit = bootm_load_limit(images, load);
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
-	err = image_decomp(os.comp, load, os.image_start, os.type,
-			   load_buf, image_buf, image_len,
-			   CONFIG_SYS_BOOTM_LEN, &load_end);
+
+	/*
+	 * If the compressed data is in the space at the load address, try to
+	 * decompress into the part below it, so nothing is moved in the
+	 * common case. If that is not enough, or the output would start on
+	 * top of the data, move the data to the top of the space and
+	 * decompress into everything below that.
+	 */
+	in_place = os.comp != IH_COMP_NONE && image_start < load + limit &&
+		   image_start + image_len > load;
+	size = limit;
+	if (in_place) {
+		size = image_start > load ? image_start - load : 0;
+		if (bootm_uncomp_size(os.comp, image_buf, image_len) > size)
+			size = 0;
+	}
+
+	err = -ENOSPC;
+	load_end = load;
+	if (size)
+		err = image_decomp(os.comp, load, image_start, os.type,
+				   load_buf, image_buf, image_len,
+				   bootm_decomp_max(size), &load_end);
+	if (err && err != -ENOSYS && in_place) {
+		src = bootm_move_image(load, limit, image_start, image_len);
+		if (src) {
+			size = src - load;
+			err = image_decomp(os.comp, load, src, os.type,
+					   load_buf, map_sysmem(src, image_len),
+					   image_len, bootm_decomp_max(size),
+					   &load_end);
+		}
+	}
 	if (err) {
-		err = handle_decomp_error(os.comp, load_end - load, err);
+		err = handle_decomp_error(os.comp, load_end - load, size, err);
 		bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
 		return err;
 	}
@@ -408,9 +649,12 @@ static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 	debug("   kernel loaded at 0x%08lx, end = 0x%08lx\n", load, load_end);
 	bootstage_mark(BOOTSTAGE_ID_KERNEL_LOADED);
 
-	no_overlap = (os.comp == IH_COMP_NONE && load == image_start);
-
-	if (!no_overlap && load < blob_end && load_end > blob_start) {
+	/*
+	 * The OS data has been consumed, whether it was decompressed in
+	 * place, moved out of the way first or is being executed in place,
+	 * so only complain if the output reached other parts of the blob
+	 */
+	if (bootm_overwrites_blob(images, load, load_end)) {
 		debug("images.os.start = 0x%lX, images.os.end = 0x%lx\n",
 		      blob_start, blob_end);
 		debug("images.os.load = 0x%lx, load_end = 0x%lx\n", load,
@@ -1039,7 +1283,8 @@ static int bootm_host_load_image(const void *fit, int req_image_type,
 	free(load_buf);
 
 	if (ret) {
-		ret = handle_decomp_error(imape_comp, load_end - 0, ret);
+		ret = handle_decomp_error(imape_comp, load_end - 0,
+					  CONFIG_SYS_BOOTM_LEN, ret);
 		if (ret != BOOTM_ERR_UNIMPLEMENTED)
 			return ret;
 	}
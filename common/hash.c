@@ -12,11 +12,13 @@
 #ifndef USE_HOSTCC
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <env.h>
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <hw_sha.h>
+#include <time.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
@@ -176,7 +178,8 @@ static int hash_finish_crc16_ccitt(struct hash_algo *algo, void *ctx,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint16_t *)dest_buf) = *((uint16_t *)ctx);
+	/* big-endian, as with crc16_ccitt_wd_buf() */
+	*((uint16_t *)dest_buf) = cpu_to_be16(*((uint16_t *)ctx));
 	free(ctx);
 	return 0;
 }
@@ -202,7 +205,8 @@ static int hash_finish_crc32(struct hash_algo *algo, void *ctx, void *dest_buf,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* big-endian, as with crc32_wd_buf() */
+	*((uint32_t *)dest_buf) = cpu_to_be32(*((uint32_t *)ctx));
 	free(ctx);
 	return 0;
 }
@@ -438,6 +442,63 @@ int hash_block(const char *algo_name, const void *data, unsigned int len,
 	return 0;
 }
 
+static int hash_stream_write(struct stream_sink *sink, const void *buf,
+			     ulong len)
+{
+	struct hash_stream *hs = container_of(sink, struct hash_stream, sink);
+	int ret;
+
+	if (!hs->ctx)
+		return -EINVAL;
+
+	ret = hs->algo->hash_update(hs->algo, hs->ctx, buf, len, 0);
+	if (ret) {
+		/* the context has been freed */
+		hs->ctx = NULL;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int hash_stream_init(struct hash_stream *hs, const char *algo_name)
+{
+	int ret;
+
+	ret = hash_progressive_lookup_algo(algo_name, &hs->algo);
+	if (ret)
+		return ret;
+
+	ret = hs->algo->hash_init(hs->algo, &hs->ctx);
+	if (ret)
+		return -ENOMEM;
+	hs->sink.write = hash_stream_write;
+
+	return 0;
+}
+
+int hash_stream_finish(struct hash_stream *hs, void *output, int size)
+{
+	uint8_t digest[HASH_MAX_DIGEST_SIZE];
+	int ret;
+
+	if (!hs->ctx)
+		return -EINVAL;
+
+	/* the algorithms only free the context if the digest fits */
+	if (size < hs->algo->digest_size) {
+		hs->algo->hash_finish(hs->algo, hs->ctx, digest,
+				      sizeof(digest));
+		hs->ctx = NULL;
+		return -ENOSPC;
+	}
+
+	ret = hs->algo->hash_finish(hs->algo, hs->ctx, output, size);
+	hs->ctx = NULL;
+
+	return ret;
+}
+
 #if defined(CONFIG_CMD_HASH) || defined(CONFIG_CMD_SHA1SUM) || defined(CONFIG_CMD_CRC32)
 /**
  * store_result: Store the resulting sum to an address or variable
@@ -649,4 +710,43 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 	return 0;
 }
 #endif /* CONFIG_CMD_HASH || CONFIG_CMD_SHA1SUM || CONFIG_CMD_CRC32) */
+
+#ifdef CONFIG_CMD_HASH
+int hash_bench(ulong size)
+{
+	u8 output[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	ulong start, ms, loops, j;
+	u8 *buf;
+	int i;
+
+	reloc_update();
+
+	buf = malloc(size);
+	if (!buf)
+		return -ENOMEM;
+	for (j = 0; j < size; j++)
+		buf[j] = j ^ (j >> 8);
+
+	printf("Hashing %lu bytes\n", size);
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		algo = &hash_algo[i];
+
+		/* run for at least half a second to get a sensible figure */
+		start = get_timer(0);
+		loops = 0;
+		do {
+			algo->hash_func_ws(buf, size, output, algo->chunk_size);
+			loops++;
+			ms = get_timer(start);
+		} while (ms < 500);
+
+		printf("%-12s %6llu MB/s\n", algo->name,
+		       lldiv((u64)loops * size, ms * 1000));
+	}
+	free(buf);
+
+	return 0;
+}
+#endif
 #endif /* !USE_HOSTCC */
@@ -24,6 +24,7 @@
 #include <mapmem.h>
 #include <asm/io.h>
 #include <malloc.h>
+#include <watchdog.h>
 #include <asm/global_data.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
@@ -1277,6 +1278,341 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
+/*
+ * Images are hashed in chunks of this size, so that the second and later
+ * digests find the data still in the cache
+ */
+#define FIT_HASH_CHUNK_SIZE	(32 * 1024)
+/* Maximum number of hash nodes which are computed in the same pass */
+#define FIT_HASH_MAX_NODES	8
+
+/**
+ * struct fit_hash_node - a hash node which is being checked
+ *
+ * @noffset:	Offset of the hash node
+ * @name:	Name of the hash algorithm
+ * @skip:	true if the node is marked to be ignored
+ * @value:	Expected hash value, from the FIT
+ * @value_len:	Length of @value in bytes
+ * @algo:	Hash algorithm, NULL if it does not support progressive hashing
+ * @ctx:	Progressive hashing context, or NULL if not set up
+ */
+struct fit_hash_node {
+	int noffset;
+	char *name;
+	bool skip;
+	uint8_t *value;
+	int value_len;
+	struct hash_algo *algo;
+	void *ctx;
+};
+
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(FIT_VERIFY_CACHE)
+/* Number of verified images to remember */
+#define FIT_VERIFIED_COUNT	8
+/* Number of bytes at each end of the image which are checked on a hit */
+#define FIT_VERIFIED_SAMPLE	SZ_4K
+
+/**
+ * struct fit_verified - an image whose hashes have been checked
+ *
+ * @fit:		FIT containing the image
+ * @image_noffset:	Offset of the image node
+ * @data:		Image data
+ * @size:		Size of the image data in bytes
+ * @sample:		CRC32 of the start and end of the data, to catch a
+ *			different image having been loaded at the same place
+ * @value:		First hash value which was checked
+ * @value_len:		Length of @value in bytes
+ */
+struct fit_verified {
+	const void *fit;
+	int image_noffset;
+	const void *data;
+	size_t size;
+	uint32_t sample;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+};
+
+static struct fit_verified fit_verified[FIT_VERIFIED_COUNT];
+static int fit_verified_next;
+
+static uint32_t fit_verified_sample(const void *data, size_t size)
+{
+	size_t len = min_t(size_t, size, FIT_VERIFIED_SAMPLE);
+	uint32_t crc;
+
+	crc = crc32(0, data, len);
+	if (size > len)
+		crc = crc32(crc, data + size - len, len);
+
+	return crc;
+}
+
+/**
+ * fit_verified_find() - check whether an image has already been verified
+ *
+ * @fit:		FIT containing the image
+ * @image_noffset:	Offset of the image node
+ * @data:		Image data
+ * @size:		Size of the image data in bytes
+ * @hn:			First hash node of the image which is not ignored
+ * @return true if the hashes of this image were checked earlier
+ */
+static bool fit_verified_find(const void *fit, int image_noffset,
+			      const void *data, size_t size,
+			      const struct fit_hash_node *hn)
+{
+	struct fit_verified *fv;
+	int i;
+
+	for (i = 0; i < FIT_VERIFIED_COUNT; i++) {
+		fv = &fit_verified[i];
+		if (fv->fit == fit && fv->image_noffset == image_noffset &&
+		    fv->data == data && fv->size == size &&
+		    fv->value_len == hn->value_len &&
+		    !memcmp(fv->value, hn->value, hn->value_len))
+			return fv->sample == fit_verified_sample(data, size);
+	}
+
+	return false;
+}
+
+static void fit_verified_add(const void *fit, int image_noffset,
+			     const void *data, size_t size,
+			     const struct fit_hash_node *hn)
+{
+	struct fit_verified *fv = &fit_verified[fit_verified_next];
+
+	fit_verified_next = (fit_verified_next + 1) % FIT_VERIFIED_COUNT;
+	fv->fit = fit;
+	fv->image_noffset = image_noffset;
+	fv->data = data;
+	fv->size = size;
+	fv->sample = fit_verified_sample(data, size);
+	memcpy(fv->value, hn->value, hn->value_len);
+	fv->value_len = hn->value_len;
+}
+#else
+static bool fit_verified_find(const void *fit, int image_noffset,
+			      const void *data, size_t size,
+			      const struct fit_hash_node *hn)
+{
+	return false;
+}
+
+static void fit_verified_add(const void *fit, int image_noffset,
+			     const void *data, size_t size,
+			     const struct fit_hash_node *hn)
+{
+}
+#endif
+
+/*
+ * Tell whether hardware computes the @name digest in one go, while the
+ * progressive functions for it are software. The one-shot hardware path
+ * then beats hashing alongside other digests.
+ */
+static bool fit_hash_hw_oneshot(const char *name)
+{
+	if (IS_ENABLED(CONFIG_SHA_PROG_HW_ACCEL))
+		return false;
+	if (IS_ENABLED(CONFIG_SHA_HW_ACCEL) &&
+	    (!strcmp(name, "sha1") || !strcmp(name, "sha256")))
+		return true;
+	if (IS_ENABLED(CONFIG_SHA512_HW_ACCEL) &&
+	    (!strcmp(name, "sha384") || !strcmp(name, "sha512")))
+		return true;
+
+	return false;
+}
+
+/**
+ * fit_image_check_hashes() - check all hash nodes of an image
+ *
+ * When an image has several hashes, e.g. both crc32 and sha256, the digests
+ * are computed in a single pass over the image data, so that it is only read
+ * from memory once. A lone hash, algorithms which do not support progressive
+ * hashing and those which hardware only accelerates in one go are computed
+ * separately with calculate_hash().
+ *
+ * @fit:		FIT to check
+ * @image_noffset:	Offset of the image node
+ * @data:		Image data
+ * @size:		Size of the image data in bytes
+ * @noffsetp:		Returns the offset of the failing hash node on error
+ * @err_msgp:		Returns the error message on error
+ * @return 0 if all hashes are valid, -1 on error
+ */
+static int fit_image_check_hashes(const void *fit, int image_noffset,
+				  const void *data, size_t size,
+				  int *noffsetp, char **err_msgp)
+{
+	struct fit_hash_node node[FIT_HASH_MAX_NODES];
+	struct fit_hash_node *hn, *first = NULL, *prog = NULL;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int count = 0, nprog = 0, noffset, value_len, i;
+	bool cached = false;
+	size_t pos, len;
+	int ignore;
+
+	*err_msgp = NULL;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		/*
+		 * Check subnode name, must be equal to "hash".
+		 * Multiple hash nodes require unique unit node
+		 * names, e.g. hash-1, hash-2, etc.
+		 */
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		*noffsetp = noffset;
+
+		/* more than we can handle at once, so check this on its own */
+		if (count == FIT_HASH_MAX_NODES) {
+			if (fit_image_check_hash(fit, noffset, data, size,
+						 err_msgp))
+				return -1;
+			puts("+ ");
+			continue;
+		}
+
+		hn = &node[count];
+		memset(hn, '\0', sizeof(*hn));
+		hn->noffset = noffset;
+		if (fit_image_hash_get_algo(fit, noffset, &hn->name)) {
+			*err_msgp = "Can't get hash algo property";
+			return -1;
+		}
+		count++;
+
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore) {
+				hn->skip = true;
+				continue;
+			}
+		}
+
+		if (fit_image_hash_get_value(fit, noffset, &hn->value,
+					     &hn->value_len)) {
+			*err_msgp = "Can't get hash value property";
+			return -1;
+		}
+		if (fit_hash_hw_oneshot(hn->name) ||
+		    hash_progressive_lookup_algo(hn->name, &hn->algo)) {
+			hn->algo = NULL;
+		} else {
+			prog = hn;
+			nprog++;
+		}
+		if (!first)
+			first = hn;
+	}
+
+	/* a single pass only pays off if it serves several digests */
+	if (nprog == 1)
+		prog->algo = NULL;
+
+	if (first)
+		cached = fit_verified_find(fit, image_noffset, data, size, first);
+
+	if (!cached) {
+		for (i = 0; i < count; i++) {
+			hn = &node[i];
+			if (!hn->skip && hn->algo &&
+			    hn->algo->hash_init(hn->algo, &hn->ctx)) {
+				hn->ctx = NULL;
+				*noffsetp = hn->noffset;
+				*err_msgp = "Can't set up hash";
+				goto err;
+			}
+		}
+
+		/* Pass each chunk to all the digests while it is in cache */
+		pos = 0;
+		do {
+			len = size - pos;
+			if (len > FIT_HASH_CHUNK_SIZE)
+				len = FIT_HASH_CHUNK_SIZE;
+			for (i = 0; i < count; i++) {
+				hn = &node[i];
+				if (hn->ctx &&
+				    hn->algo->hash_update(hn->algo, hn->ctx,
+							  data + pos, len,
+							  pos + len == size)) {
+					*noffsetp = hn->noffset;
+					*err_msgp = "Can't calculate hash";
+					goto err;
+				}
+			}
+			pos += len;
+#ifndef USE_HOSTCC
+			WATCHDOG_RESET();
+#endif
+		} while (pos < size);
+	}
+
+	for (i = 0; i < count; i++) {
+		hn = &node[i];
+		*noffsetp = hn->noffset;
+		printf("%s", hn->name);
+		if (hn->skip) {
+			printf("-skipped ");
+			continue;
+		}
+		if (cached) {
+			puts("+ ");
+			continue;
+		}
+
+		if (hn->ctx) {
+			value_len = hn->algo->digest_size;
+			if (hn->algo->hash_finish(hn->algo, hn->ctx, value,
+						  sizeof(value))) {
+				hn->ctx = NULL;
+				*err_msgp = "Can't calculate hash";
+				goto err;
+			}
+			hn->ctx = NULL;
+		} else if (calculate_hash(data, size, hn->name, value,
+					  &value_len)) {
+			*err_msgp = "Unsupported hash algorithm";
+			goto err;
+		}
+
+		if (value_len != hn->value_len) {
+			*err_msgp = "Bad hash value len";
+			goto err;
+		} else if (memcmp(value, hn->value, value_len) != 0) {
+			*err_msgp = "Bad hash value";
+			goto err;
+		}
+		puts("+ ");
+	}
+
+	if (cached)
+		puts("(cached) ");
+	else if (first)
+		fit_verified_add(fit, image_noffset, data, size, first);
+
+	return 0;
+
+err:
+	/* free any contexts which are still set up */
+	for (i = 0; i < count; i++) {
+		hn = &node[i];
+		if (hn->ctx)
+			hn->algo->hash_finish(hn->algo, hn->ctx, value,
+					      sizeof(value));
+	}
+
+	return -1;
+}
+
 int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *data, size_t size)
 {
@@ -1294,21 +1630,15 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 	}
 
 	/* Process all hash subnodes of the component image node */
+	if (fit_image_check_hashes(fit, image_noffset, data, size, &noffset,
+				   &err_msg))
+		goto error;
+
+	/* Then any signature subnodes */
 	fdt_for_each_subnode(noffset, fit, image_noffset) {
 		const char *name = fit_get_name(fit, noffset, NULL);
 
-		/*
-		 * Check subnode name, must be equal to "hash".
-		 * Multiple hash nodes require unique unit node
-		 * names, e.g. hash-1, hash-2, etc.
-		 */
-		if (!strncmp(name, FIT_HASH_NODENAME,
-			     strlen(FIT_HASH_NODENAME))) {
-			if (fit_image_check_hash(fit, noffset, data, size,
-						 &err_msg))
-				goto error;
-			puts("+ ");
-		} else if (FIT_IMAGE_ENABLE_VERIFY && verify_all &&
+		if (FIT_IMAGE_ENABLE_VERIFY && verify_all &&
 				!strncmp(name, FIT_SIG_NODENAME,
 					strlen(FIT_SIG_NODENAME))) {
 			ret = fit_image_check_sig(fit, noffset, data,
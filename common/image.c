@@ -222,6 +222,8 @@ static const struct comp_magic_map image_comp[] = {
 	{	IH_COMP_GZIP,	"gzip",		{0x1f, 0x8b},},
 	{	IH_COMP_LZMA,	"lzma",		{0x5d, 0x00},},
 	{	IH_COMP_LZO,	"lzo",		{0x89, 0x4c},},
+	{	IH_COMP_LZ4,	"lz4",		{0x04, 0x22},},
+	{	IH_COMP_ZSTD,	"zstd",		{0x28, 0xb5},},
 	{	IH_COMP_NONE,	"none",		{},	},
 };
 
@@ -590,6 +592,105 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 	return ret;
 }
 
+#ifndef USE_HOSTCC
+/* Consumers for each compression type handled by image_decomp_stream_init() */
+union image_decomp_sink {
+	struct stream_copy copy;
+#if CONFIG_IS_ENABLED(GZIP)
+	struct gunzip_stream gzip;
+#endif
+#if CONFIG_IS_ENABLED(LZ4)
+	struct lz4_stream lz4;
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	struct stream_zstd zstd;
+#endif
+};
+
+int image_decomp_stream_init(struct image_decomp_stream *ids, int comp,
+			     void *dst, ulong max)
+{
+	union image_decomp_sink *ds;
+	int ret = 0;
+
+	ds = malloc(sizeof(*ds));
+	if (!ds)
+		return -ENOMEM;
+
+	switch (comp) {
+	case IH_COMP_NONE:
+		stream_copy_init(&ds->copy, dst, max);
+		ids->sink = &ds->copy.sink;
+		break;
+#if CONFIG_IS_ENABLED(GZIP)
+	case IH_COMP_GZIP:
+		ret = gunzip_stream_init(&ds->gzip, dst, max);
+		ids->sink = &ds->gzip.sink;
+		break;
+#endif
+#if CONFIG_IS_ENABLED(LZ4)
+	case IH_COMP_LZ4:
+		lz4_stream_init(&ds->lz4, dst, max);
+		ids->sink = &ds->lz4.sink;
+		break;
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	case IH_COMP_ZSTD:
+		ret = stream_zstd_init(&ds->zstd, dst, max);
+		ids->sink = &ds->zstd.sink;
+		break;
+#endif
+	default:
+		ret = -ENOSYS;
+		break;
+	}
+	if (ret) {
+		free(ds);
+		return ret;
+	}
+	ids->comp = comp;
+	ids->priv = ds;
+
+	return 0;
+}
+
+int image_decomp_stream_finish(struct image_decomp_stream *ids, ulong *sizep)
+{
+	union image_decomp_sink *ds = ids->priv;
+	int ret;
+
+	switch (ids->comp) {
+	case IH_COMP_NONE:
+		*sizep = ds->copy.size;
+		ret = 0;
+		break;
+#if CONFIG_IS_ENABLED(GZIP)
+	case IH_COMP_GZIP:
+		ret = gunzip_stream_finish(&ds->gzip, sizep);
+		break;
+#endif
+#if CONFIG_IS_ENABLED(LZ4)
+	case IH_COMP_LZ4:
+		ret = lz4_stream_finish(&ds->lz4, sizep);
+		break;
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	case IH_COMP_ZSTD:
+		ret = stream_zstd_finish(&ds->zstd, sizep);
+		break;
+#endif
+	default:
+		*sizep = 0;
+		ret = -ENOSYS;
+		break;
+	}
+	free(ds);
+	ids->priv = NULL;
+
+	return ret;
+}
+#endif /* !USE_HOSTCC */
+
 
 #ifndef USE_HOSTCC
 #if CONFIG_IS_ENABLED(LEGACY_IMAGE_FORMAT)
@@ -9,6 +9,7 @@
 #include <command.h>
 #include <env.h>
 #include <errno.h>
+#include <fs.h>
 #include <ide.h>
 #include <log.h>
 #include <malloc.h>
@@ -240,6 +241,8 @@ void part_init(struct blk_desc *dev_desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	part_efi_cache_invalidate(dev_desc);
+	fs_invalidate_dev(dev_desc);
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -668,6 +671,12 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 	part_drv = part_driver_lookup_type(dev_desc);
 	if (!part_drv)
 		return -1;
+	if (part_drv->get_info_by_name) {
+		ret = part_drv->get_info_by_name(dev_desc, name, info);
+		if (ret != -1)
+			return ret;
+		/* the driver could not use its index, fall back to a scan */
+	}
 	for (i = 1; i < part_drv->max_entries; i++) {
 		ret = part_drv->get_info(dev_desc, i, info);
 		if (ret != 0) {
@@ -683,6 +692,41 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 	return -ENOENT;
 }
 
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  struct disk_partition *info)
+{
+	struct part_driver *part_drv;
+	int ret;
+
+	part_drv = part_driver_lookup_type(dev_desc);
+	if (!part_drv)
+		return -1;
+	if (part_drv->get_info_by_uuid) {
+		ret = part_drv->get_info_by_uuid(dev_desc, uuid, info);
+		if (ret != -1)
+			return ret;
+	}
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	int i;
+
+	for (i = 1; i < part_drv->max_entries; i++) {
+		ret = part_drv->get_info(dev_desc, i, info);
+		if (ret != 0) {
+			/* no more entries in table */
+			break;
+		}
+		if (strcasecmp(uuid, info->uuid) == 0) {
+			/* matched */
+			return i;
+		}
+	}
+
+	return -ENOENT;
+#else
+	return -ENOSYS;
+#endif
+}
+
 int part_get_info_by_name(struct blk_desc *dev_desc, const char *name,
 			  struct disk_partition *info)
 {
@@ -214,38 +214,257 @@ static void prepare_backup_gpt_header(gpt_header *gpt_h)
  * Public Functions (include/part.h)
  */
 
+#if CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+/*
+ * Parsed GPT of a block device (and hardware partition), kept until it is
+ * invalidated by part_init() or by a write to the GPT area. This saves
+ * re-reading and re-validating the table on each partition lookup, and
+ * lets partitions be found by name or UUID through hash tables.
+ */
+struct gpt_cache {
+	struct gpt_cache *next;
+	struct blk_desc *dev_desc;
+	int hwpart;
+	gpt_header *gpt_head;
+	gpt_entry *gpt_pte;
+	u32 hash_mask;
+	int *name_hash;		/* partition index + 1, or 0 if empty */
+	int *uuid_hash;		/* partition index + 1, or 0 if empty */
+};
+
+static struct gpt_cache *gpt_caches;
+
+/*
+ * Hash at most the PART_NAME_LEN - 1 characters which gpt_pte_to_info()
+ * keeps of a name, since those are what lookups by name compare
+ */
+static u32 gpt_name_hash(const char *name)
+{
+	u32 hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < PART_NAME_LEN - 1 && name[i]; i++)
+		hash = (hash ^ (u8)name[i]) * 16777619u;
+
+	return hash;
+}
+
+static u32 gpt_guid_hash(const u8 *guid)
+{
+	return get_unaligned_le32(guid) ^ get_unaligned_le32(guid + 12);
+}
+
+static void gpt_hash_add(int *table, u32 mask, u32 hash, int idx)
+{
+	while (table[hash & mask])
+		hash++;
+	table[hash & mask] = idx + 1;
+}
+
+static void gpt_cache_free(struct gpt_cache *gc)
+{
+	free(gc->name_hash);
+	free(gc->uuid_hash);
+	free(gc->gpt_pte);
+	free(gc->gpt_head);
+	free(gc);
+}
+
+static struct gpt_cache *gpt_cache_get(struct blk_desc *dev_desc)
+{
+	struct gpt_cache *gc;
+	u32 num, size;
+	int i;
+
+	for (gc = gpt_caches; gc; gc = gc->next)
+		if (gc->dev_desc == dev_desc && gc->hwpart == dev_desc->hwpart)
+			return gc;
+
+	gc = calloc(1, sizeof(*gc));
+	if (!gc)
+		return NULL;
+	gc->dev_desc = dev_desc;
+	gc->hwpart = dev_desc->hwpart;
+	gc->gpt_head = memalign(ARCH_DMA_MINALIGN,
+				PAD_TO_BLOCKSIZE(sizeof(gpt_header), dev_desc));
+	if (!gc->gpt_head ||
+	    find_valid_gpt(dev_desc, gc->gpt_head, &gc->gpt_pte) != 1) {
+		free(gc->gpt_head);
+		free(gc);
+		return NULL;
+	}
+
+	/* keep the tables at most half full */
+	num = le32_to_cpu(gc->gpt_head->num_partition_entries);
+	for (size = 16; size < 2 * num; size <<= 1)
+		;
+	gc->hash_mask = size - 1;
+	gc->name_hash = calloc(size, sizeof(int));
+	gc->uuid_hash = calloc(size, sizeof(int));
+	if (!gc->name_hash || !gc->uuid_hash) {
+		gpt_cache_free(gc);
+		return NULL;
+	}
+	for (i = 0; i < num; i++) {
+		gpt_entry *pte = &gc->gpt_pte[i];
+
+		if (!is_pte_valid(pte))
+			continue;
+		gpt_hash_add(gc->name_hash, gc->hash_mask,
+			     gpt_name_hash(print_efiname(pte)), i);
+		gpt_hash_add(gc->uuid_hash, gc->hash_mask,
+			     gpt_guid_hash(pte->unique_partition_guid.b), i);
+	}
+
+	gc->next = gpt_caches;
+	gpt_caches = gc;
+
+	return gc;
+}
+
+void part_efi_cache_invalidate(struct blk_desc *dev_desc)
+{
+	struct gpt_cache **pgc = &gpt_caches;
+	struct gpt_cache *gc;
+
+	while ((gc = *pgc)) {
+		if (gc->dev_desc == dev_desc) {
+			*pgc = gc->next;
+			gpt_cache_free(gc);
+		} else {
+			pgc = &gc->next;
+		}
+	}
+}
+
+void part_efi_cache_write(struct blk_desc *dev_desc, lbaint_t start,
+			  lbaint_t blkcnt)
+{
+	struct gpt_cache *gc;
+
+	for (gc = gpt_caches; gc; gc = gc->next) {
+		gpt_header *gpt_h = gc->gpt_head;
+
+		if (gc->dev_desc != dev_desc || gc->hwpart != dev_desc->hwpart)
+			continue;
+
+		/* the primary and backup GPT lie outside the usable area */
+		if (start < le64_to_cpu(gpt_h->first_usable_lba) ||
+		    start + blkcnt > le64_to_cpu(gpt_h->last_usable_lba) + 1) {
+			part_efi_cache_invalidate(dev_desc);
+			return;
+		}
+	}
+}
+#endif
+
+/*
+ * get_valid_gpt() - get the validated GPT header and PTEs of a device
+ *
+ * These come from the GPT cache if enabled, otherwise they are read from
+ * the device. Release them with put_valid_gpt().
+ *
+ * Description: returns 1 if found a valid gpt,  0 on error.
+ */
+static int get_valid_gpt(struct blk_desc *dev_desc, gpt_header **pgpt_head,
+			 gpt_entry **pgpt_pte)
+{
+#if CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+	struct gpt_cache *gc = gpt_cache_get(dev_desc);
+
+	if (!gc)
+		return 0;
+	*pgpt_head = gc->gpt_head;
+	*pgpt_pte = gc->gpt_pte;
+
+	return 1;
+#else
+	*pgpt_head = memalign(ARCH_DMA_MINALIGN,
+			      PAD_TO_BLOCKSIZE(sizeof(gpt_header), dev_desc));
+	if (!*pgpt_head)
+		return 0;
+
+	/* This function validates AND fills in the GPT header and PTE */
+	if (find_valid_gpt(dev_desc, *pgpt_head, pgpt_pte) != 1) {
+		free(*pgpt_head);
+		return 0;
+	}
+
+	return 1;
+#endif
+}
+
+static void put_valid_gpt(gpt_header *gpt_head, gpt_entry *gpt_pte)
+{
+#if !CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+	free(gpt_head);
+#if !defined(CONFIG_DUAL_BOOTLOADER) || !defined(CONFIG_SPL_BUILD)
+	/* Heap memory is very limited in SPL, if the dual bootloader is
+	 * enabled, just load pte to dram instead of oc-ram. In such case,
+	 * this part of  memory shouldn't be freed. But in common routine,
+	 * don't forget to free the memory after use.
+	 */
+	free(gpt_pte);
+#endif
+#endif
+}
+
+static void gpt_pte_to_info(struct blk_desc *dev_desc, gpt_entry *pte,
+			    struct disk_partition *info)
+{
+	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
+	info->start = (lbaint_t)le64_to_cpu(pte->starting_lba);
+	/* The ending LBA is inclusive, to calculate size, add 1 to it */
+	info->size = (lbaint_t)le64_to_cpu(pte->ending_lba) + 1
+		     - info->start;
+	info->blksz = dev_desc->blksz;
+
+	snprintf((char *)info->name, sizeof(info->name), "%s",
+		 print_efiname(pte));
+	strcpy((char *)info->type, "U-Boot");
+	info->bootable = get_bootable(pte);
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	uuid_bin_to_str(pte->unique_partition_guid.b, info->uuid,
+			UUID_STR_FORMAT_GUID);
+#endif
+#ifdef CONFIG_PARTITION_TYPE_GUID
+	uuid_bin_to_str(pte->partition_type_guid.b, info->type_guid,
+			UUID_STR_FORMAT_GUID);
+#endif
+
+	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
+	      info->start, info->size, info->name);
+}
+
 /*
  * UUID is displayed as 32 hexadecimal digits, in 5 groups,
  * separated by hyphens, in the form 8-4-4-4-12 for a total of 36 characters
  */
 int get_disk_guid(struct blk_desc * dev_desc, char *guid)
 {
-	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
+	gpt_header *gpt_head;
 	gpt_entry *gpt_pte = NULL;
 	unsigned char *guid_bin;
 
-	/* This function validates AND fills in the GPT header and PTE */
-	if (find_valid_gpt(dev_desc, gpt_head, &gpt_pte) != 1)
+	if (get_valid_gpt(dev_desc, &gpt_head, &gpt_pte) != 1)
 		return -EINVAL;
 
 	guid_bin = gpt_head->disk_guid.b;
 	uuid_bin_to_str(guid_bin, guid, UUID_STR_FORMAT_GUID);
 
-	/* Remember to free pte */
-	free(gpt_pte);
+	put_valid_gpt(gpt_head, gpt_pte);
 	return 0;
 }
 
 void part_print_efi(struct blk_desc *dev_desc)
 {
-	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
+	gpt_header *gpt_head;
 	gpt_entry *gpt_pte = NULL;
 	int i = 0;
 	char uuid[UUID_STR_LEN + 1];
 	unsigned char *uuid_bin;
 
-	/* This function validates AND fills in the GPT header and PTE */
-	if (find_valid_gpt(dev_desc, gpt_head, &gpt_pte) != 1)
+	if (get_valid_gpt(dev_desc, &gpt_head, &gpt_pte) != 1)
 		return;
 
 	debug("%s: gpt-entry at %p\n", __func__, gpt_pte);
@@ -278,17 +497,14 @@ void part_print_efi(struct blk_desc *dev_desc)
 		printf("\tguid:\t%s\n", uuid);
 	}
 
-#if !defined(CONFIG_DUAL_BOOTLOADER) || !defined(CONFIG_SPL_BUILD)
-	/* Remember to free pte */
-	free(gpt_pte);
-#endif
+	put_valid_gpt(gpt_head, gpt_pte);
 	return;
 }
 
 int part_get_info_efi(struct blk_desc *dev_desc, int part,
 		      struct disk_partition *info)
 {
-	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
+	gpt_header *gpt_head;
 	gpt_entry *gpt_pte = NULL;
 
 	/* "part" argument must be at least 1 */
@@ -297,53 +513,76 @@ int part_get_info_efi(struct blk_desc *dev_desc, int part,
 		return -1;
 	}
 
-	/* This function validates AND fills in the GPT header and PTE */
-	if (find_valid_gpt(dev_desc, gpt_head, &gpt_pte) != 1)
+	if (get_valid_gpt(dev_desc, &gpt_head, &gpt_pte) != 1)
 		return -1;
 
 	if (part > le32_to_cpu(gpt_head->num_partition_entries) ||
 	    !is_pte_valid(&gpt_pte[part - 1])) {
 		debug("%s: *** ERROR: Invalid partition number %d ***\n",
 			__func__, part);
-#if !defined(CONFIG_DUAL_BOOTLOADER) || !defined(CONFIG_SPL_BUILD)
-		free(gpt_pte);
-#endif
+		put_valid_gpt(gpt_head, gpt_pte);
 		return -1;
 	}
 
-	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
-	info->start = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].starting_lba);
-	/* The ending LBA is inclusive, to calculate size, add 1 to it */
-	info->size = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].ending_lba) + 1
-		     - info->start;
-	info->blksz = dev_desc->blksz;
+	gpt_pte_to_info(dev_desc, &gpt_pte[part - 1], info);
 
-	snprintf((char *)info->name, sizeof(info->name), "%s",
-		 print_efiname(&gpt_pte[part - 1]));
-	strcpy((char *)info->type, "U-Boot");
-	info->bootable = get_bootable(&gpt_pte[part - 1]);
-#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
-	uuid_bin_to_str(gpt_pte[part - 1].unique_partition_guid.b, info->uuid,
-			UUID_STR_FORMAT_GUID);
-#endif
-#ifdef CONFIG_PARTITION_TYPE_GUID
-	uuid_bin_to_str(gpt_pte[part - 1].partition_type_guid.b,
-			info->type_guid, UUID_STR_FORMAT_GUID);
-#endif
+	put_valid_gpt(gpt_head, gpt_pte);
+	return 0;
+}
 
-	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
-	      info->start, info->size, info->name);
+#if CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+static int part_get_info_efi_name(struct blk_desc *dev_desc, const char *name,
+				  struct disk_partition *info)
+{
+	struct gpt_cache *gc = gpt_cache_get(dev_desc);
+	u32 hash = gpt_name_hash(name);
+	int idx;
 
-#if !defined(CONFIG_DUAL_BOOTLOADER) || !defined(CONFIG_SPL_BUILD)
-	/* Heap memory is very limited in SPL, if the dual bootloader is
-	 * enabled, just load pte to dram instead of oc-ram. In such case,
-	 * this part of  memory shouldn't be freed. But in common routine,
-	 * don't forget to free the memory after use.
+	/*
+	 * A name which does not fit in struct disk_partition never matches
+	 * in the scan by part_get_info_by_name_type(), so leave it to that
 	 */
-	free(gpt_pte);
-#endif
-	return 0;
+	if (!gc || strlen(name) >= PART_NAME_LEN)
+		return -1;
+
+	for (; (idx = gc->name_hash[hash & gc->hash_mask]); hash++) {
+		if (!strncmp(name, print_efiname(&gc->gpt_pte[idx - 1]),
+			     PART_NAME_LEN - 1)) {
+			gpt_pte_to_info(dev_desc, &gc->gpt_pte[idx - 1], info);
+			return idx;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static int part_get_info_efi_uuid(struct blk_desc *dev_desc, const char *uuid,
+				  struct disk_partition *info)
+{
+	struct gpt_cache *gc = gpt_cache_get(dev_desc);
+	efi_guid_t guid;
+	u32 hash;
+	int idx;
+
+	if (uuid_str_to_bin(uuid, guid.b, UUID_STR_FORMAT_GUID))
+		return -EINVAL;
+	if (!gc)
+		return -1;
+
+	hash = gpt_guid_hash(guid.b);
+	for (; (idx = gc->uuid_hash[hash & gc->hash_mask]); hash++) {
+		gpt_entry *pte = &gc->gpt_pte[idx - 1];
+
+		if (!memcmp(pte->unique_partition_guid.b, guid.b,
+			    sizeof(guid))) {
+			gpt_pte_to_info(dev_desc, pte, info);
+			return idx;
+		}
+	}
+
+	return -ENOENT;
 }
+#endif
 
 #if defined(CONFIG_DUAL_BOOTLOADER) && defined(CONFIG_SPL_BUILD)
 int part_get_info_efi_by_name(struct blk_desc *dev_desc, const char *name,
@@ -1275,5 +1514,9 @@ U_BOOT_PART_TYPE(a_efi) = {
 	.get_info	= part_get_info_ptr(part_get_info_efi),
 	.print		= part_print_ptr(part_print_efi),
 	.test		= part_test_efi,
+#if CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+	.get_info_by_name	= part_get_info_efi_name,
+	.get_info_by_uuid	= part_get_info_efi_uuid,
+#endif
 };
 #endif /* CONFIG_HAVE_BLOCK_DEVICE */
@@ -9,9 +9,13 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <fs.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
+#include <stream.h>
+#include <watchdog.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -439,6 +443,7 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	lbaint_t fetch, fetch_start = 0;
 	ulong blks_read;
 
 	if (!ops->read)
@@ -447,6 +452,29 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
+
+	fetch = blkcache_fetch_range(block_dev->if_type, block_dev->devnum,
+				     start, blkcnt, block_dev->blksz,
+				     &fetch_start);
+	if (fetch && block_dev->lba && fetch_start + fetch > block_dev->lba)
+		fetch = block_dev->lba - fetch_start;
+	if (fetch && fetch_start + fetch >= start + blkcnt) {
+		char *buf = malloc_cache_aligned(fetch * block_dev->blksz);
+
+		/* read whole cache lines, plus readahead, then copy out */
+		if (buf && ops->read(dev, fetch_start, fetch, buf) == fetch) {
+			blkcache_fill(block_dev->if_type, block_dev->devnum,
+				      fetch_start, fetch, block_dev->blksz,
+				      buf);
+			memcpy(buffer,
+			       buf + (start - fetch_start) * block_dev->blksz,
+			       blkcnt * block_dev->blksz);
+			free(buf);
+			return blkcnt;
+		}
+		free(buf);
+	}
+
 	blks_read = ops->read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
@@ -455,6 +483,207 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	return blks_read;
 }
 
+unsigned long blk_dreadv(struct blk_desc *block_dev, lbaint_t start,
+			 lbaint_t blkcnt, const struct blk_seg *segs,
+			 int nsegs)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_read, total = 0, off = 0, n, len;
+	lbaint_t blk, cnt;
+	char *buf = NULL;
+	int i;
+
+	if (!ops->read)
+		return -ENOSYS;
+
+	for (i = 0; i < nsegs; i++)
+		total += segs[i].len;
+	if (total != blkcnt * block_dev->blksz)
+		return -EINVAL;
+
+	if (ops->readv) {
+		blks_read = ops->readv(dev, start, blkcnt, segs, nsegs);
+		if (blks_read != -ENOSYS)
+			return blks_read;
+	}
+
+	/*
+	 * Read the blocks which lie within a segment straight into it, and
+	 * only bounce those which straddle two segments. @off is where in
+	 * segment @i block @blk starts.
+	 */
+	for (blk = 0, i = 0; blk < blkcnt; ) {
+		while (off == segs[i].len) {
+			off = 0;
+			i++;
+		}
+
+		cnt = (segs[i].len - off) / block_dev->blksz;
+		if (cnt) {
+			if (blk_dread(block_dev, start + blk, cnt,
+				      segs[i].buffer + off) != cnt)
+				goto err;
+			blk += cnt;
+			off += cnt * block_dev->blksz;
+			continue;
+		}
+
+		if (!buf) {
+			buf = malloc_cache_aligned(block_dev->blksz);
+			if (!buf)
+				return -ENOMEM;
+		}
+		if (blk_dread(block_dev, start + blk, 1, buf) != 1)
+			goto err;
+		for (n = 0; ; i++, off = 0) {
+			len = min(segs[i].len - off, block_dev->blksz - n);
+			memcpy(segs[i].buffer + off, buf + n, len);
+			n += len;
+			off += len;
+			if (n == block_dev->blksz)
+				break;
+		}
+		blk++;
+	}
+	free(buf);
+
+	return blkcnt;
+
+err:
+	free(buf);
+
+	return -EIO;
+}
+
+int blk_dread_async(struct blk_desc *block_dev, lbaint_t start,
+		    lbaint_t blkcnt, void *buffer, struct blk_req *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	req->desc = block_dev;
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = buffer;
+	req->result = 0;
+	req->complete = false;
+
+	if (!ops->read)
+		return -ENOSYS;
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	if (ops->read_submit) {
+		int ret = ops->read_submit(dev, req);
+
+		if (ret != -ENOSYS)
+			return ret;
+	}
+#endif
+
+	/* synchronous fallback, which also uses the block cache */
+	req->result = blk_dread(block_dev, start, blkcnt, buffer);
+	req->complete = true;
+	if (req->done)
+		req->done(req);
+
+	return 0;
+}
+
+int blk_poll(struct blk_req *req)
+{
+	long ret;
+
+	if (req->complete)
+		return 0;
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	ret = blk_get_ops(req->desc->bdev)->read_poll(req->desc->bdev, req);
+	if (ret == -EBUSY)
+		return -EBUSY;
+	if (ret == req->blkcnt)
+		blkcache_fill(req->desc->if_type, req->desc->devnum,
+			      req->start, req->blkcnt, req->desc->blksz,
+			      req->buffer);
+#else
+	ret = -ENOSYS;
+#endif
+	req->result = ret;
+	req->complete = true;
+	if (req->done)
+		req->done(req);
+
+	return 0;
+}
+
+long blk_wait(struct blk_req *req)
+{
+	while (blk_poll(req) == -EBUSY)
+		WATCHDOG_RESET();
+
+	return req->result;
+}
+
+long blk_dread_stream(struct blk_desc *block_dev, lbaint_t start,
+		      lbaint_t blkcnt, lbaint_t chunk,
+		      struct stream_sink *sink)
+{
+	lbaint_t blk, next, end = start + blkcnt;
+	struct blk_req req[2] = {};
+	void *buf[2] = {};
+	long ret;
+	int cur;
+
+	if (!blkcnt)
+		return 0;
+	if (!chunk || chunk > blkcnt)
+		chunk = blkcnt;
+
+	buf[0] = malloc_cache_aligned(chunk * block_dev->blksz);
+	if (chunk < blkcnt)
+		buf[1] = malloc_cache_aligned(chunk * block_dev->blksz);
+	if (!buf[0] || (chunk < blkcnt && !buf[1])) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = blk_dread_async(block_dev, start, chunk, buf[0], &req[0]);
+	if (ret)
+		goto out;
+
+	for (blk = start, cur = 0; blk < end; blk = next, cur = !cur) {
+		next = blk + req[cur].blkcnt;
+		ret = blk_wait(&req[cur]);
+		if (ret != req[cur].blkcnt) {
+			ret = ret < 0 ? ret : -EIO;
+			goto out;
+		}
+
+		/* fetch the next chunk while this one is consumed */
+		if (next < end) {
+			ret = blk_dread_async(block_dev, next,
+					      min(chunk, end - next),
+					      buf[!cur], &req[!cur]);
+			if (ret)
+				goto out;
+		}
+
+		ret = stream_write(sink, buf[cur],
+				   req[cur].blkcnt * block_dev->blksz);
+		if (ret) {
+			if (next < end)
+				blk_wait(&req[!cur]);
+			goto out;
+		}
+	}
+	ret = blkcnt;
+out:
+	free(buf[1]);
+	free(buf[0]);
+
+	return ret;
+}
+
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt, const void *buffer)
 {
@@ -465,6 +694,8 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	part_efi_cache_write(block_dev, start, blkcnt);
+	fs_invalidate_dev(block_dev);
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -478,6 +709,8 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	part_efi_cache_write(block_dev, start, blkcnt);
+	fs_invalidate_dev(block_dev);
 	return ops->erase(dev, start, blkcnt);
 }
 
@@ -11,14 +11,25 @@
 #include <part.h>
 #include <asm/global_data.h>
 #include <linux/ctype.h>
+#include <linux/errno.h>
 #include <linux/list.h>
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 DECLARE_GLOBAL_DATA_PTR;
 #endif
 
+/*
+ * The cache is made of fixed-size lines of max_blocks_per_entry blocks,
+ * aligned on a multiple of the line size. Lines are looked up through a
+ * hash table keyed by (iftype, devnum, line) and evicted in LRU order
+ * once the memory budget is used up.
+ */
+#define BLKCACHE_HASH_BITS	6
+#define BLKCACHE_HASH_SIZE	(1 << BLKCACHE_HASH_BITS)
+
 struct block_cache_node {
 	struct list_head lh;
+	struct hlist_node hn;
 	int iftype;
 	int devnum;
 	lbaint_t start;
@@ -27,11 +38,26 @@ struct block_cache_node {
 	char *cache;
 };
 
+/* per-device sequential access detector and statistics */
+struct block_cache_dev {
+	struct list_head lh;
+	int iftype;
+	int devnum;
+	lbaint_t next;
+	bool sequential;
+	unsigned hits;
+	unsigned misses;
+	unsigned readahead;
+};
+
 static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_devs);
+static struct hlist_head block_cache_hash[BLKCACHE_HASH_SIZE];
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_BLOCKS,
+	.max_bytes = CONFIG_BLOCK_CACHE_SIZE * 1024,
+	.readahead_blocks = CONFIG_BLOCK_CACHE_READAHEAD,
 };
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
@@ -42,22 +68,58 @@ int blkcache_init(void)
 	head->next = (uintptr_t)head->next + gd->reloc_off;
 	head->prev = (uintptr_t)head->prev + gd->reloc_off;
 
+	head = &block_cache_devs;
+	head->next = (uintptr_t)head->next + gd->reloc_off;
+	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+
 	return 0;
 }
 #endif
 
+static inline lbaint_t cache_line(lbaint_t lba)
+{
+	return lba / _stats.max_blocks_per_entry;
+}
+
+static struct hlist_head *cache_bucket(int iftype, int devnum, lbaint_t line)
+{
+	u32 key = (u32)line ^ ((u32)((u64)line >> 32)) ^
+		  ((u32)devnum << 8) ^ ((u32)iftype << 16);
+
+	return &block_cache_hash[(key * 0x9e3779b1) >>
+				 (32 - BLKCACHE_HASH_BITS)];
+}
+
+static struct block_cache_dev *cache_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, lh)
+		if (bdev->iftype == iftype && bdev->devnum == devnum)
+			return bdev;
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (!bdev)
+		return NULL;
+	bdev->iftype = iftype;
+	bdev->devnum = devnum;
+	list_add_tail(&bdev->lh, &block_cache_devs);
+
+	return bdev;
+}
+
 static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+					   lbaint_t line, unsigned long blksz)
 {
 	struct block_cache_node *node;
+	struct hlist_node *pos;
 
-	list_for_each_entry(node, &block_cache, lh)
+	hlist_for_each(pos, cache_bucket(iftype, devnum, line)) {
+		node = hlist_entry(pos, struct block_cache_node, hn);
 		if ((node->iftype == iftype) &&
 		    (node->devnum == devnum) &&
 		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
+		    (cache_line(node->start) == line)) {
 			if (block_cache.next != &node->lh) {
 				/* maintain MRU ordering */
 				list_del(&node->lh);
@@ -65,121 +127,237 @@ static struct block_cache_node *cache_find(int iftype, int devnum,
 			}
 			return node;
 		}
-	return 0;
+	}
+	return NULL;
+}
+
+static void cache_drop(struct block_cache_node *node)
+{
+	list_del(&node->lh);
+	hlist_del(&node->hn);
+	_stats.entries--;
+	_stats.bytes -= node->blkcnt * node->blksz;
+}
+
+/*
+ * largest request, in blocks, that is served through the cache: this is
+ * what blkcache_fetch_range() may ask for, i.e. two lines for a request
+ * which straddles a line boundary, plus readahead
+ */
+static lbaint_t cache_window(void)
+{
+	lbaint_t line = _stats.max_blocks_per_entry;
+
+	return 2 * line + roundup(_stats.readahead_blocks, line);
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	lbaint_t line, last, blk;
+	char *dst = buffer;
+
+	bdev = cache_dev(iftype, devnum);
+	if (bdev) {
+		bdev->sequential = (start == bdev->next);
+		bdev->next = start + blkcnt;
+	}
+
+	if (!_stats.max_blocks_per_entry || !_stats.max_bytes ||
+	    blkcnt > cache_window())
+		goto miss;
+
+	/* make sure every line is present before copying anything */
+	last = cache_line(start + blkcnt - 1);
+	for (line = cache_line(start); line <= last; line++)
+		if (!cache_find(iftype, devnum, line, blksz))
+			goto miss;
+
+	for (blk = start; blk < start + blkcnt; ) {
+		lbaint_t count;
+
+		node = cache_find(iftype, devnum, cache_line(blk), blksz);
+		count = min(node->start + node->blkcnt, start + blkcnt) - blk;
+		memcpy(dst, node->cache + (blk - node->start) * blksz,
+		       count * blksz);
+		dst += count * blksz;
+		blk += count;
 	}
 
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	++_stats.hits;
+	if (bdev)
+		++bdev->hits;
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 	++_stats.misses;
+	if (bdev)
+		++bdev->misses;
 	return 0;
 }
 
+lbaint_t blkcache_fetch_range(int iftype, int devnum,
+			      lbaint_t start, lbaint_t blkcnt,
+			      unsigned long blksz, lbaint_t *fetch_start)
+{
+	lbaint_t line = _stats.max_blocks_per_entry;
+	struct block_cache_dev *bdev;
+	lbaint_t first, end;
+
+	if (!line || !_stats.max_bytes || blkcnt > line)
+		return 0;
+
+	first = rounddown(start, line);
+	end = roundup(start + blkcnt, line);
+
+	bdev = cache_dev(iftype, devnum);
+	if (bdev && bdev->sequential && _stats.readahead_blocks) {
+		lbaint_t ra = roundup(_stats.readahead_blocks, line);
+
+		/* never prefetch more than half of the cache */
+		if ((end - first + ra) * blksz <= _stats.max_bytes / 2) {
+			end += ra;
+			bdev->readahead += ra;
+			_stats.readahead += ra;
+		}
+	}
+
+	if ((end - first) * blksz > _stats.max_bytes)
+		return 0;
+
+	*fetch_start = first;
+	return end - first;
+}
+
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
+	lbaint_t line = _stats.max_blocks_per_entry;
+	unsigned long bytes = line * blksz;
 	struct block_cache_node *node;
+	lbaint_t blk;
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (!line || !_stats.max_bytes)
 		return;
 
-	if (_stats.max_entries == 0)
+	/* don't cache big stuff */
+	if (blkcnt > cache_window())
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
+	/* only whole lines are cached */
+	for (blk = roundup(start, line); blk + line <= start + blkcnt;
+	     blk += line) {
+		if (cache_find(iftype, devnum, cache_line(blk), blksz))
+			continue;
+
+		if (bytes > _stats.max_bytes)
 			return;
-		node->cache = 0;
-	}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
+		node = NULL;
+		while (_stats.bytes + bytes > _stats.max_bytes) {
+			/* pop LRU */
+			node = list_last_entry(&block_cache,
+					       struct block_cache_node, lh);
+			cache_drop(node);
+			debug("drop: start " LBAF ", count " LBAFU "\n",
+			      node->start, node->blkcnt);
+			if (node->blkcnt * node->blksz == bytes)
+				break;
+			free(node->cache);
 			free(node);
-			return;
+			node = NULL;
 		}
-	}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+		if (!node) {
+			node = malloc(sizeof(*node));
+			if (!node)
+				return;
+			node->cache = malloc(bytes);
+			if (!node->cache) {
+				free(node);
+				return;
+			}
+		}
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+		debug("fill: start " LBAF ", count " LBAFU "\n",
+		      blk, line);
+
+		node->iftype = iftype;
+		node->devnum = devnum;
+		node->start = blk;
+		node->blkcnt = line;
+		node->blksz = blksz;
+		memcpy(node->cache, (const char *)buffer +
+		       (blk - start) * blksz, bytes);
+		list_add(&node->lh, &block_cache);
+		hlist_add_head(&node->hn,
+			       cache_bucket(iftype, devnum, cache_line(blk)));
+		_stats.entries++;
+		_stats.bytes += bytes;
+	}
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
 	struct list_head *entry, *n;
 	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
 
 	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
+		node = list_entry(entry, struct block_cache_node, lh);
 		if ((node->iftype == iftype) &&
 		    (node->devnum == devnum)) {
-			list_del(entry);
+			cache_drop(node);
 			free(node->cache);
 			free(node);
-			--_stats.entries;
 		}
 	}
+
+	list_for_each_entry(bdev, &block_cache_devs, lh)
+		if (bdev->iftype == iftype && bdev->devnum == devnum)
+			bdev->sequential = false;
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_configure(unsigned blocks, unsigned long max_bytes,
+			unsigned readahead)
 {
 	struct block_cache_node *node;
+
 	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
+	    (max_bytes < _stats.bytes)) {
 		/* invalidate cache */
 		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
+			node = list_first_entry(&block_cache,
+						struct block_cache_node, lh);
+			cache_drop(node);
 			free(node->cache);
 			free(node);
 		}
-		_stats.entries = 0;
 	}
 
 	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	_stats.max_bytes = max_bytes;
+	_stats.readahead_blocks = readahead;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.readahead = 0;
+}
+
+void blkcache_get_config(unsigned *blocks, unsigned long *max_bytes,
+			 unsigned *readahead)
+{
+	*blocks = _stats.max_blocks_per_entry;
+	*max_bytes = _stats.max_bytes;
+	*readahead = _stats.readahead_blocks;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -187,4 +365,28 @@ void blkcache_stats(struct block_cache_stats *stats)
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.readahead = 0;
+}
+
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, lh) {
+		if (index--)
+			continue;
+
+		stats->iftype = bdev->iftype;
+		stats->devnum = bdev->devnum;
+		stats->hits = bdev->hits;
+		stats->misses = bdev->misses;
+		stats->readahead = bdev->readahead;
+		bdev->hits = 0;
+		bdev->misses = 0;
+		bdev->readahead = 0;
+
+		return 0;
+	}
+
+	return -ENOENT;
 }
@@ -88,6 +88,22 @@ static unsigned long host_block_write(struct blk_desc *block_dev,
 	return -1;
 }
 
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+/*
+ * Sandbox is single-threaded, so the transfer is deferred until the first
+ * poll. This exercises the same submit/poll/complete sequence as real DMA.
+ */
+static int host_block_read_submit(struct udevice *dev, struct blk_req *req)
+{
+	return 0;
+}
+
+static long host_block_read_poll(struct udevice *dev, struct blk_req *req)
+{
+	return host_block_read(dev, req->start, req->blkcnt, req->buffer);
+}
+#endif
+
 #ifdef CONFIG_BLK
 int host_dev_bind(int devnum, char *filename, bool removable)
 {
@@ -246,6 +262,10 @@ int sandbox_host_unbind(struct udevice *dev)
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.read_submit	= host_block_read_submit,
+	.read_poll	= host_block_read_poll,
+#endif
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
@@ -395,31 +395,31 @@ int mmc_send_tuning(struct mmc *mmc, u32 opcode, int *cmd_error)
 }
 #endif
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
-			   lbaint_t blkcnt)
+static void mmc_read_blocks_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+				struct mmc_data *data, void *dst,
+				lbaint_t start, lbaint_t blkcnt)
 {
-	struct mmc_cmd cmd;
-	struct mmc_data data;
-
 	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		cmd->cmdarg = start * mmc->read_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
 
-	if (mmc_send_cmd(mmc, &cmd, &data))
-		return 0;
+static int mmc_read_blocks_stop(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
 
 	if (blkcnt > 1) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
@@ -429,10 +429,27 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
 			pr_err("mmc fail to send stop cmd\n");
 #endif
-			return 0;
+			return -EIO;
 		}
 	}
 
+	return 0;
+}
+
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+
+	mmc_read_blocks_cmd(mmc, &cmd, &data, dst, start, blkcnt);
+
+	if (mmc_send_cmd(mmc, &cmd, &data))
+		return 0;
+
+	if (mmc_read_blocks_stop(mmc, blkcnt))
+		return 0;
+
 	return blkcnt;
 }
 
@@ -446,6 +463,35 @@ static int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt)
 }
 #endif
 
+static int mmc_bread_prepare(struct mmc *mmc, struct blk_desc *block_dev,
+			     lbaint_t start, lbaint_t blkcnt)
+{
+	int err;
+
+	if (CONFIG_IS_ENABLED(MMC_TINY))
+		err = mmc_switch_part(mmc, block_dev->hwpart);
+	else
+		err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
+
+	if (err < 0)
+		return err;
+
+	if ((start + blkcnt) > block_dev->lba) {
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
+		pr_err("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
+		       start + blkcnt, block_dev->lba);
+#endif
+		return -EINVAL;
+	}
+
+	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
+		pr_debug("%s: Failed to set blocklen\n", __func__);
+		return -EIO;
+	}
+
+	return 0;
+}
+
 #if CONFIG_IS_ENABLED(BLK)
 ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *dst)
 #else
@@ -457,7 +503,6 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
 #endif
 	int dev_num = block_dev->devnum;
-	int err;
 	lbaint_t cur, blocks_todo = blkcnt;
 	uint b_max;
 
@@ -468,26 +513,8 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	if (!mmc)
 		return 0;
 
-	if (CONFIG_IS_ENABLED(MMC_TINY))
-		err = mmc_switch_part(mmc, block_dev->hwpart);
-	else
-		err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
-
-	if (err < 0)
-		return 0;
-
-	if ((start + blkcnt) > block_dev->lba) {
-#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-		pr_err("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
-		       start + blkcnt, block_dev->lba);
-#endif
-		return 0;
-	}
-
-	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
-		pr_debug("%s: Failed to set blocklen\n", __func__);
+	if (mmc_bread_prepare(mmc, block_dev, start, blkcnt))
 		return 0;
-	}
 
 	b_max = mmc_get_b_max(mmc, dst, blkcnt);
 
@@ -505,6 +532,128 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	return blkcnt;
 }
 
+#if CONFIG_IS_ENABLED(BLK) && CONFIG_IS_ENABLED(DM_MMC)
+ulong mmc_breadv(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		 const struct blk_seg *segs, int nsegs)
+{
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	int ret;
+
+	if (!mmc || !blkcnt)
+		return 0;
+
+	/* the whole list must go in one command */
+	if (!(mmc->cfg->host_caps & MMC_CAP_SG) ||
+	    blkcnt > mmc_get_b_max(mmc, segs[0].buffer, blkcnt))
+		return -ENOSYS;
+
+	if (mmc_bread_prepare(mmc, block_dev, start, blkcnt))
+		return 0;
+
+	mmc_read_blocks_cmd(mmc, &cmd, &data, NULL, start, blkcnt);
+	data.flags |= MMC_DATA_SG;
+	data.segs = segs;
+	data.nsegs = nsegs;
+
+	ret = mmc_send_cmd(mmc, &cmd, &data);
+	if (ret == -ENOSYS)
+		return -ENOSYS;
+	if (ret || mmc_read_blocks_stop(mmc, blkcnt)) {
+		pr_debug("%s: Failed to read blocks\n", __func__);
+		return 0;
+	}
+
+	return blkcnt;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC) && CONFIG_IS_ENABLED(DM_MMC)
+static int mmc_bread_submit_chunk(struct mmc *mmc)
+{
+	struct blk_req *req = mmc->async_req;
+	lbaint_t offset = mmc->async_start - req->start;
+	lbaint_t cur = min_t(lbaint_t, mmc->async_todo, mmc->async_b_max);
+	struct mmc_cmd cmd;
+
+	mmc_read_blocks_cmd(mmc, &cmd, &mmc->async_data,
+			    req->buffer + offset * mmc->read_bl_len,
+			    mmc->async_start, cur);
+
+	return mmc_send_cmd_async(mmc, &cmd, &mmc->async_data);
+}
+
+int mmc_bread_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+	int ret;
+
+	if (!mmc)
+		return -ENODEV;
+	if (mmc->async_req)
+		return -EBUSY;
+
+	/* the data goes straight to the buffer, so it must be DMA-safe */
+	if (!req->blkcnt || !IS_ALIGNED((ulong)req->buffer, ARCH_DMA_MINALIGN))
+		return -ENOSYS;
+
+	ret = mmc_bread_prepare(mmc, block_dev, req->start, req->blkcnt);
+	if (ret)
+		return ret;
+
+	mmc->async_req = req;
+	mmc->async_start = req->start;
+	mmc->async_todo = req->blkcnt;
+	mmc->async_b_max = mmc_get_b_max(mmc, req->buffer, req->blkcnt);
+
+	ret = mmc_bread_submit_chunk(mmc);
+	if (ret)
+		mmc->async_req = NULL;
+
+	return ret;
+}
+
+long mmc_bread_poll(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+	lbaint_t cur;
+	int ret;
+
+	if (!mmc || mmc->async_req != req)
+		return -EINVAL;
+
+	ret = mmc_poll_data(mmc, &mmc->async_data);
+	if (ret == -EBUSY)
+		return -EBUSY;
+
+	cur = mmc->async_data.blocks;
+	if (!ret)
+		ret = mmc_read_blocks_stop(mmc, cur);
+	if (!ret) {
+		mmc->async_start += cur;
+		mmc->async_todo -= cur;
+		if (!mmc->async_todo) {
+			mmc->async_req = NULL;
+			return req->blkcnt;
+		}
+
+		/* start on the next chunk while the caller gets on */
+		ret = mmc_bread_submit_chunk(mmc);
+		if (!ret)
+			return -EBUSY;
+	}
+
+	pr_debug("%s: Failed to read blocks (err=%d)\n", __func__, ret);
+	mmc->async_req = NULL;
+
+	return ret;
+}
+#endif
+
 static int mmc_go_idle(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
@@ -20,6 +20,12 @@ int mmc_set_blocklen(struct mmc *mmc, int len);
 #if CONFIG_IS_ENABLED(BLK)
 ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 		void *dst);
+ulong mmc_breadv(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		 const struct blk_seg *segs, int nsegs);
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+int mmc_bread_submit(struct udevice *dev, struct blk_req *req);
+long mmc_bread_poll(struct udevice *dev, struct blk_req *req);
+#endif
 #else
 ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		void *dst);
@@ -24,10 +24,49 @@ struct sandbox_mmc_plat {
 #define MMC_CAPACITY (((MMC_CSIZE + 1) << (MMC_CMULT + 2)) \
 		      * MMC_BL_LEN) /* 1 MiB */
 
+/**
+ * struct sandbox_mmc_priv - Emulated card
+ *
+ * @buf:	Card contents
+ * @async_cmd:	Read started by send_cmd_async(), if @async_data is set
+ * @async_data:	Data for that read, copied when it is polled a second time
+ * @async_polls: Number of times the read has been polled
+ * @sg_reads:	Number of scatter-gather reads done
+ */
 struct sandbox_mmc_priv {
 	u8 buf[MMC_CAPACITY];
+	int sg_reads;
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	struct mmc_cmd async_cmd;
+	struct mmc_data *async_data;
+	int async_polls;
+#endif
 };
 
+/*
+ * Scatter the data over the segments, accepting only those which an ADMA
+ * controller could describe, i.e. 32-bit aligned in address and length
+ */
+static int sandbox_mmc_read_sg(struct sandbox_mmc_priv *priv,
+			       struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	u8 *src = &priv->buf[cmd->cmdarg * data->blocksize];
+	uint i;
+
+	for (i = 0; i < data->nsegs; i++) {
+		if (!IS_ALIGNED((ulong)data->segs[i].buffer, 4) ||
+		    !IS_ALIGNED(data->segs[i].len, 4))
+			return -ENOSYS;
+	}
+	for (i = 0; i < data->nsegs; i++) {
+		memcpy(data->segs[i].buffer, src, data->segs[i].len);
+		src += data->segs[i].len;
+	}
+	priv->sg_reads++;
+
+	return 0;
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
@@ -76,6 +115,8 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
 	case MMC_CMD_READ_MULTIPLE_BLOCK:
+		if (data->flags & MMC_DATA_SG)
+			return sandbox_mmc_read_sg(priv, cmd, data);
 		memcpy(data->dest, &priv->buf[cmd->cmdarg * data->blocksize],
 		       data->blocks * data->blocksize);
 		break;
@@ -120,6 +161,44 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+/*
+ * Reads are left 'in flight' so that callers see -EBUSY from the first
+ * poll, as they would from a DMA controller
+ */
+static int sandbox_mmc_send_cmd_async(struct udevice *dev,
+				      struct mmc_cmd *cmd,
+				      struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (cmd->cmdidx != MMC_CMD_READ_SINGLE_BLOCK &&
+	    cmd->cmdidx != MMC_CMD_READ_MULTIPLE_BLOCK)
+		return -ENOSYS;
+	if (priv->async_data)
+		return -EBUSY;
+
+	priv->async_cmd = *cmd;
+	priv->async_data = data;
+	priv->async_polls = 0;
+
+	return 0;
+}
+
+static int sandbox_mmc_poll_data(struct udevice *dev, struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (priv->async_data != data)
+		return -EINVAL;
+	if (!priv->async_polls++)
+		return -EBUSY;
+	priv->async_data = NULL;
+
+	return sandbox_mmc_send_cmd(dev, &priv->async_cmd, data);
+}
+#endif
+
 static int sandbox_mmc_set_ios(struct udevice *dev)
 {
 	return 0;
@@ -134,8 +213,19 @@ static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.send_cmd_async = sandbox_mmc_send_cmd_async,
+	.poll_data = sandbox_mmc_poll_data,
+#endif
 };
 
+int sandbox_mmc_get_sg_reads(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->sg_reads;
+}
+
 static int sandbox_mmc_of_to_plat(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_plat(dev);
@@ -166,7 +256,8 @@ static int sandbox_mmc_bind(struct udevice *dev)
 	struct mmc_config *cfg = &plat->cfg;
 
 	cfg->name = dev->name;
-	cfg->host_caps = MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_8BIT;
+	cfg->host_caps = MMC_MODE_HS_52MHz | MMC_MODE_HS | MMC_MODE_8BIT |
+			 MMC_CAP_SG;
 	cfg->voltages = MMC_VDD_165_195 | MMC_VDD_32_33 | MMC_VDD_33_34;
 	cfg->f_min = 1000000;
 	cfg->f_max = 52000000;
@@ -7,6 +7,8 @@
 #include <cpu_func.h>
 #include <sdhci.h>
 #include <malloc.h>
+#include <mmc.h>
+#include <phys2bus.h>
 #include <asm/cache.h>
 
 static void sdhci_adma_desc(struct sdhci_adma_desc *desc,
@@ -61,6 +63,137 @@ void sdhci_prepare_adma_table(struct sdhci_adma_desc *table,
 			  ARCH_DMA_MINALIGN));
 }
 
+/*
+ * Split a segment at @addr of @len bytes into a partial cache line at
+ * each end, which are bounced, and the whole cache lines in between,
+ * which the controller transfers directly
+ */
+static void sdhci_adma_sg_split(ulong addr, ulong len, ulong *head,
+				ulong *tail)
+{
+	*head = min_t(ulong, len, ALIGN(addr, ARCH_DMA_MINALIGN) - addr);
+	*tail = (len - *head) & (ARCH_DMA_MINALIGN - 1);
+}
+
+static struct sdhci_adma_desc *sdhci_adma_sg_desc(struct udevice *dev,
+						  struct sdhci_adma_desc *desc,
+						  ulong addr, ulong len,
+						  uint *desc_count)
+{
+	while (len) {
+		u16 cur = min_t(ulong, len, ADMA_MAX_LEN);
+
+		len -= cur;
+		sdhci_adma_desc(desc, dev_phys_to_bus(dev, addr), cur,
+				--*desc_count == 0);
+		addr += cur;
+		desc++;
+	}
+
+	return desc;
+}
+
+/**
+ * sdhci_prepare_adma_table_sg() - Populate the ADMA table from a segment list
+ *
+ * @dev:	MMC controller, used to translate to bus addresses
+ * @table:	Pointer to the ADMA table
+ * @data:	Pointer to MMC data with MMC_DATA_SG set
+ * @bounce:	Cache-aligned buffer of SDHCI_SG_BOUNCE_SIZE(data->nsegs)
+ *		bytes
+ *
+ * Give each segment of @data its own descriptors so that the controller
+ * transfers straight to or from the final buffers. Only the whole cache
+ * lines of a segment can be handed to the controller, since invalidating
+ * a line that it shares with other data would throw away the CPU's writes
+ * to that data. A partial line at either end of a segment therefore goes
+ * through its own cache line in @bounce, and sdhci_adma_sg_done() copies
+ * it into place once the transfer is complete.
+ *
+ * @return 0 if OK, -ENOSYS if a segment is not aligned as ADMA requires or
+ * the segments need more descriptors than the table holds
+ */
+int sdhci_prepare_adma_table_sg(struct udevice *dev,
+				struct sdhci_adma_desc *table,
+				struct mmc_data *data, void *bounce)
+{
+	struct sdhci_adma_desc *desc = table;
+	ulong addr, len, head, tail;
+	uint desc_count = 0;
+	u8 *slot = bounce;
+	uint i;
+
+	for (i = 0; i < data->nsegs; i++) {
+		addr = (ulong)data->segs[i].buffer;
+		len = data->segs[i].len;
+		if (!IS_ALIGNED(addr, ADMA_SG_ALIGN) ||
+		    !IS_ALIGNED(len, ADMA_SG_ALIGN))
+			return -ENOSYS;
+		sdhci_adma_sg_split(addr, len, &head, &tail);
+		desc_count += !!head + !!tail +
+			      DIV_ROUND_UP(len - head - tail, ADMA_MAX_LEN);
+	}
+	if (!desc_count || desc_count > ADMA_TABLE_NO_ENTRIES)
+		return -ENOSYS;
+
+	for (i = 0; i < data->nsegs; i++) {
+		addr = (ulong)data->segs[i].buffer;
+		len = data->segs[i].len;
+		sdhci_adma_sg_split(addr, len, &head, &tail);
+		if (!(data->flags & MMC_DATA_READ)) {
+			memcpy(slot, (void *)addr, head);
+			memcpy(slot + ARCH_DMA_MINALIGN,
+			       (void *)(addr + len - tail), tail);
+		}
+
+		desc = sdhci_adma_sg_desc(dev, desc, (ulong)slot, head,
+					  &desc_count);
+		flush_dcache_range(addr + head, addr + len - tail);
+		desc = sdhci_adma_sg_desc(dev, desc, addr + head,
+					  len - head - tail, &desc_count);
+		desc = sdhci_adma_sg_desc(dev, desc,
+					  (ulong)slot + ARCH_DMA_MINALIGN, tail,
+					  &desc_count);
+		slot += 2 * ARCH_DMA_MINALIGN;
+	}
+	flush_dcache_range((ulong)bounce, (ulong)slot);
+
+	flush_cache((dma_addr_t)table,
+		    ROUND((desc - table) * sizeof(struct sdhci_adma_desc),
+			  ARCH_DMA_MINALIGN));
+
+	return 0;
+}
+
+/**
+ * sdhci_adma_sg_done() - Make the segments of a transfer available to the CPU
+ *
+ * @data:	Pointer to MMC data passed to sdhci_prepare_adma_table_sg()
+ * @bounce:	Bounce buffer passed to sdhci_prepare_adma_table_sg()
+ */
+void sdhci_adma_sg_done(struct mmc_data *data, void *bounce)
+{
+	ulong addr, len, head, tail;
+	u8 *slot = bounce;
+	uint i;
+
+	if (!(data->flags & MMC_DATA_READ))
+		return;
+
+	invalidate_dcache_range((ulong)bounce,
+				(ulong)bounce + SDHCI_SG_BOUNCE_SIZE(data->nsegs));
+	for (i = 0; i < data->nsegs; i++) {
+		addr = (ulong)data->segs[i].buffer;
+		len = data->segs[i].len;
+		sdhci_adma_sg_split(addr, len, &head, &tail);
+		invalidate_dcache_range(addr + head, addr + len - tail);
+		memcpy((void *)addr, slot, head);
+		memcpy((void *)(addr + len - tail), slot + ARCH_DMA_MINALIGN,
+		       tail);
+		slot += 2 * ARCH_DMA_MINALIGN;
+	}
+}
+
 /**
  * sdhci_adma_init() - initialize the ADMA descriptor table
  *
@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <mmc.h>
 #include <sdhci.h>
 #include <asm/cache.h>
@@ -63,7 +64,7 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 	char *offs;
 	for (i = 0; i < data->blocksize; i += 4) {
 		offs = data->dest + i;
-		if (data->flags == MMC_DATA_READ)
+		if (data->flags & MMC_DATA_READ)
 			*(u32 *)offs = sdhci_readl(host, SDHCI_BUFFER);
 		else
 			sdhci_writel(host, *(u32 *)offs, SDHCI_BUFFER);
@@ -71,14 +72,14 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 }
 
 #if (defined(CONFIG_MMC_SDHCI_SDMA) || CONFIG_IS_ENABLED(MMC_SDHCI_ADMA))
-static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
-			      int *is_aligned, int trans_bytes)
+static int sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
+			     int *is_aligned, int trans_bytes)
 {
 	dma_addr_t dma_addr;
 	unsigned char ctrl;
 	void *buf;
 
-	if (data->flags == MMC_DATA_READ)
+	if (data->flags & MMC_DATA_READ)
 		buf = data->dest;
 	else
 		buf = (void *)data->src;
@@ -91,12 +92,34 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 		ctrl |= SDHCI_CTRL_ADMA32;
 	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
 
+#if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
+	if (data->flags & MMC_DATA_SG) {
+		ulong size = SDHCI_SG_BOUNCE_SIZE(data->nsegs);
+		int ret;
+
+		/* kept for later transfers, like the align buffer */
+		if (size > host->sg_bounce_size) {
+			free(host->sg_bounce);
+			host->sg_bounce = malloc_cache_aligned(size);
+			host->sg_bounce_size = host->sg_bounce ? size : 0;
+			if (!host->sg_bounce)
+				return -ENOSYS;
+		}
+		ret = sdhci_prepare_adma_table_sg(mmc_to_dev(host->mmc),
+						  host->adma_desc_table, data,
+						  host->sg_bounce);
+		if (ret)
+			return ret;
+		goto set_adma_addr;
+	}
+#endif
+
 	if (host->flags & USE_SDMA &&
 	    (host->force_align_buffer ||
 	     (host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR &&
 	      ((unsigned long)buf & 0x7) != 0x0))) {
 		*is_aligned = 0;
-		if (data->flags != MMC_DATA_READ)
+		if (!(data->flags & MMC_DATA_READ))
 			memcpy(host->align_buffer, buf, trans_bytes);
 		buf = host->align_buffer;
 	}
@@ -112,7 +135,7 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 	else if (host->flags & (USE_ADMA | USE_ADMA64)) {
 		sdhci_prepare_adma_table(host->adma_desc_table, data,
 					 host->start_addr);
-
+set_adma_addr:
 		sdhci_writel(host, lower_32_bits(host->adma_addr),
 			     SDHCI_ADMA_ADDRESS);
 		if (host->flags & USE_ADMA64)
@@ -120,11 +143,27 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 				     SDHCI_ADMA_ADDRESS_HI);
 	}
 #endif
+
+	return 0;
+}
+
+static void sdhci_unmap_dma(struct sdhci_host *host, struct mmc_data *data)
+{
+#if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
+	if (data->flags & MMC_DATA_SG) {
+		sdhci_adma_sg_done(data, host->sg_bounce);
+		return;
+	}
+#endif
+	dma_unmap_single(host->start_addr, data->blocks * data->blocksize,
+			 mmc_get_dma_dir(data));
 }
 #else
-static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
-			      int *is_aligned, int trans_bytes)
-{}
+static int sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
+			     int *is_aligned, int trans_bytes)
+{
+	return 0;
+}
 #endif
 static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 {
@@ -178,8 +217,7 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 	} while (!(stat & SDHCI_INT_DATA_END));
 
 #if (defined(CONFIG_MMC_SDHCI_SDMA) || CONFIG_IS_ENABLED(MMC_SDHCI_ADMA))
-	dma_unmap_single(host->start_addr, data->blocks * data->blocksize,
-			 mmc_get_dma_dir(data));
+	sdhci_unmap_dma(host, data);
 #endif
 
 	return 0;
@@ -196,17 +234,16 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 #define SDHCI_CMD_DEFAULT_TIMEOUT		100
 #define SDHCI_READ_STATUS_TIMEOUT		1000
 
-#ifdef CONFIG_DM_MMC
-static int sdhci_send_command(struct udevice *dev, struct mmc_cmd *cmd,
-			      struct mmc_data *data)
-{
-	struct mmc *mmc = mmc_get_mmc_dev(dev);
+#define SDHCI_ASYNC_DATA_TIMEOUT		10000
 
-#else
-static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
-			      struct mmc_data *data)
+/*
+ * With @async set, a data command returns as soon as the command has been
+ * accepted, leaving the (ADMA) data transfer running; sdhci_poll_data()
+ * then completes it.
+ */
+static int sdhci_do_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
+				 struct mmc_data *data, bool async)
 {
-#endif
 	struct sdhci_host *host = mmc->priv;
 	unsigned int stat = 0;
 	int ret = 0;
@@ -216,10 +253,16 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	int mmc_dev = mmc_get_blk_desc(mmc)->devnum;
 	ulong start = get_timer(0);
 
-	host->start_addr = 0;
 	/* Timeout unit - ms */
 	static unsigned int cmd_timeout = SDHCI_CMD_DEFAULT_TIMEOUT;
 
+	/* Asynchronous and scatter-gather transfers need ADMA */
+	if ((async || (data && data->flags & MMC_DATA_SG)) &&
+	    !(data && (host->flags & (USE_ADMA | USE_ADMA64))))
+		return -ENOSYS;
+
+	host->start_addr = 0;
+
 	mask = SDHCI_CMD_INHIBIT | SDHCI_DATA_INHIBIT;
 
 	/* We shouldn't wait for data inihibit for stop commands, even
@@ -278,12 +321,15 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->blocks > 1)
 			mode |= SDHCI_TRNS_MULTI;
 
-		if (data->flags == MMC_DATA_READ)
+		if (data->flags & MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
 		if (host->flags & USE_DMA) {
 			mode |= SDHCI_TRNS_DMA;
-			sdhci_prepare_dma(host, data, &is_aligned, trans_bytes);
+			ret = sdhci_prepare_dma(host, data, &is_aligned,
+						trans_bytes);
+			if (ret)
+				return ret;
 		}
 
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
@@ -320,8 +366,13 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	} else
 		ret = -1;
 
-	if (!ret && data)
+	if (!ret && data) {
+		if (async) {
+			host->async_start = get_timer(0);
+			return 0;
+		}
 		ret = sdhci_transfer_data(host, data);
+	}
 
 	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
 		udelay(1000);
@@ -330,7 +381,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
 	if (!ret) {
 		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				!is_aligned && (data->flags == MMC_DATA_READ))
+				!is_aligned && (data->flags & MMC_DATA_READ))
 			memcpy(data->dest, host->align_buffer, trans_bytes);
 		return 0;
 	}
@@ -343,6 +394,57 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		return -ECOMM;
 }
 
+#ifdef CONFIG_DM_MMC
+static int sdhci_send_command(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data)
+{
+	return sdhci_do_send_command(mmc_get_mmc_dev(dev), cmd, data, false);
+}
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+static int sdhci_send_command_async(struct udevice *dev, struct mmc_cmd *cmd,
+				    struct mmc_data *data)
+{
+	return sdhci_do_send_command(mmc_get_mmc_dev(dev), cmd, data, true);
+}
+
+static int sdhci_poll_data(struct udevice *dev, struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	unsigned int stat;
+	int ret = 0;
+
+	stat = sdhci_readl(host, SDHCI_INT_STATUS);
+	if (stat & SDHCI_INT_ERROR) {
+		pr_debug("%s: Error detected in status(0x%X)!\n",
+			 __func__, stat);
+		ret = -EIO;
+	} else if (!(stat & SDHCI_INT_DATA_END)) {
+		if (get_timer(host->async_start) < SDHCI_ASYNC_DATA_TIMEOUT)
+			return -EBUSY;
+		printf("%s: Transfer data timeout\n", __func__);
+		ret = -ETIMEDOUT;
+	}
+
+	sdhci_unmap_dma(host, data);
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	if (ret) {
+		sdhci_reset(host, SDHCI_RESET_CMD);
+		sdhci_reset(host, SDHCI_RESET_DATA);
+	}
+
+	return ret;
+}
+#endif
+#else
+static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
+			      struct mmc_data *data)
+{
+	return sdhci_do_send_command(mmc, cmd, data, false);
+}
+#endif
+
 #if defined(CONFIG_DM_MMC) && defined(MMC_SUPPORTS_TUNING)
 static int sdhci_execute_tuning(struct udevice *dev, uint opcode)
 {
@@ -788,6 +890,10 @@ const struct dm_mmc_ops sdhci_ops = {
 #ifdef MMC_SUPPORTS_TUNING
 	.execute_tuning	= sdhci_execute_tuning,
 #endif
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.send_cmd_async	= sdhci_send_command_async,
+	.poll_data	= sdhci_poll_data,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
@@ -838,6 +944,7 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 #else
 	host->flags |= USE_ADMA;
 #endif
+	cfg->host_caps |= MMC_CAP_SG;
 #endif
 	if (host->quirks & SDHCI_QUIRK_REG32_RW)
 		host->version =
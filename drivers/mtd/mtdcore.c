@@ -906,8 +906,21 @@ void __put_mtd_device(struct mtd_info *mtd)
 }
 EXPORT_SYMBOL_GPL(__put_mtd_device);
 
+/*
+ * Every erase, write or bad block marking, whichever MTD device it is for and
+ * whether or not it succeeds, counts as one change.
+ */
+static unsigned long mtd_writes;
+
+unsigned long mtd_write_count(void)
+{
+	return mtd_writes;
+}
+EXPORT_SYMBOL_GPL(mtd_write_count);
+
 int mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
 {
+	mtd_writes++;
 	if (instr->addr > mtd->size || instr->len > mtd->size - instr->addr)
 		return -EINVAL;
 	if (!(mtd->flags & MTD_WRITEABLE))
@@ -1012,6 +1025,7 @@ EXPORT_SYMBOL_GPL(mtd_read);
 int mtd_write(struct mtd_info *mtd, loff_t to, size_t len, size_t *retlen,
 	      const u_char *buf)
 {
+	mtd_writes++;
 	*retlen = 0;
 	if (to < 0 || to > mtd->size || len > mtd->size - to)
 		return -EINVAL;
@@ -1131,6 +1145,7 @@ int mtd_write_oob(struct mtd_info *mtd, loff_t to,
 {
 	int ret;
 
+	mtd_writes++;
 	ops->retlen = ops->oobretlen = 0;
 
 	if (!(mtd->flags & MTD_WRITEABLE))
@@ -1654,6 +1669,7 @@ EXPORT_SYMBOL_GPL(mtd_block_isbad);
 
 int mtd_block_markbad(struct mtd_info *mtd, loff_t ofs)
 {
+	mtd_writes++;
 	if (!mtd->_block_markbad)
 		return -EOPNOTSUPP;
 	if (ofs < 0 || ofs > mtd->size)
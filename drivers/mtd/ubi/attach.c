@@ -79,6 +79,7 @@
 #include <u-boot/crc.h>
 #else
 #include <div64.h>
+#include <time.h>
 #include <linux/bug.h>
 #include <linux/err.h>
 #endif
@@ -1401,6 +1402,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	unsigned long start = get_timer(0);
 
 	ai = alloc_ai();
 	if (!ai)
@@ -1479,6 +1481,8 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	}
 #endif
 
+	ubi_msg(ubi, "attached by %s in %lu ms",
+		ubi->fm ? "fastmap" : "scanning", get_timer(start));
 	destroy_ai(ai);
 	return 0;
 
@@ -1035,6 +1035,19 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 			goto out_detach;
 	}
 
+#if defined(CONFIG_MTD_UBI_FASTMAP) && defined(__UBOOT__)
+	/*
+	 * The OS is usually started without detaching, so write the fastmap
+	 * now if there was none or it could not be used, rather than only at
+	 * detach time. The next attach then does not need to scan.
+	 */
+	if (!ubi->fm && !ubi->fm_disabled && !ubi->ro_mode) {
+		err = ubi_update_fastmap(ubi);
+		if (err)
+			ubi_warn(ubi, "cannot write fastmap, error %d", err);
+	}
+#endif
+
 	err = uif_init(ubi, &ref);
 	if (err)
 		goto out_detach;
@@ -277,6 +277,7 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 	}
 
 	addr = (loff_t)pnum * ubi->peb_size + offset;
+	ubi->mtd_writes++;
 	err = mtd_write(ubi->mtd, addr, len, &written, buf);
 	if (err) {
 		ubi_err(ubi, "error %d while writing %d bytes to PEB %d:%d, written %zd bytes",
@@ -336,6 +337,7 @@ retry:
 	ei.len      = ubi->peb_size;
 	ei.priv     = (unsigned long)&wq;
 
+	ubi->mtd_writes++;
 	err = mtd_erase(ubi->mtd, &ei);
 	if (err) {
 		if (retries++ < UBI_IO_RETRIES) {
@@ -506,6 +508,7 @@ static int nor_erase_prepare(struct ubi_device *ubi, int pnum)
 	err = ubi_io_read_ec_hdr(ubi, pnum, &ec_hdr, 0);
 	if (err != UBI_IO_BAD_HDR_EBADMSG && err != UBI_IO_BAD_HDR &&
 	    err != UBI_IO_FF){
+		ubi->mtd_writes++;
 		err = mtd_write(ubi->mtd, addr, 4, &written, (void *)&data);
 		if(err)
 			goto error;
@@ -515,6 +518,7 @@ static int nor_erase_prepare(struct ubi_device *ubi, int pnum)
 	if (err != UBI_IO_BAD_HDR_EBADMSG && err != UBI_IO_BAD_HDR &&
 	    err != UBI_IO_FF){
 		addr += ubi->vid_hdr_aloffset;
+		ubi->mtd_writes++;
 		err = mtd_write(ubi->mtd, addr, 4, &written, (void *)&data);
 		if (err)
 			goto error;
@@ -634,6 +638,7 @@ int ubi_io_mark_bad(const struct ubi_device *ubi, int pnum)
 	if (!ubi->bad_allowed)
 		return 0;
 
+	/* not counted in @mtd_writes, so 'ubi part' will attach again */
 	err = mtd_block_markbad(mtd, (loff_t)pnum * ubi->peb_size);
 	if (err)
 		ubi_err(ubi, "cannot mark PEB %d bad, error %d", pnum, err);
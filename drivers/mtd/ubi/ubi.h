@@ -523,6 +523,7 @@ struct ubi_debug_info {
  * @max_write_size: maximum amount of bytes the underlying flash can write at a
  *                  time (MTD write buffer size)
  * @mtd: MTD device descriptor
+ * @mtd_writes: number of changes made to @mtd by UBI, see mtd_write_count()
  *
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
@@ -622,6 +623,7 @@ struct ubi_device {
 	unsigned int nor_flash:1;
 	int max_write_size;
 	struct mtd_info *mtd;
+	unsigned long mtd_writes;
 
 	void *peb_buf;
 	struct mutex buf_mutex;
@@ -268,6 +268,36 @@ int btrfs_read(const char *file, void *buf, loff_t offset, loff_t len,
 	return 0;
 }
 
+int btrfs_get_extents(const char *file, loff_t *size, struct fs_extent **extp)
+{
+	struct btrfs_fs_info *fs_info = current_fs_info;
+	struct btrfs_root *root;
+	loff_t real_size;
+	u64 ino;
+	u8 type;
+	int ret;
+
+	ASSERT(fs_info);
+	*extp = NULL;
+	ret = btrfs_lookup_path(fs_info->fs_root, BTRFS_FIRST_FREE_OBJECTID,
+				file, &root, &ino, &type, 40);
+	if (ret < 0)
+		return ret;
+
+	if (type != BTRFS_FT_REG_FILE)
+		return -EINVAL;
+
+	ret = btrfs_size(file, &real_size);
+	if (ret < 0)
+		return ret;
+
+	ret = btrfs_file_extents(root, ino, real_size, extp);
+	if (ret >= 0)
+		*size = real_size;
+
+	return ret;
+}
+
 void btrfs_close(void)
 {
 	if (current_fs_info) {
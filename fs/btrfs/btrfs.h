@@ -21,6 +21,8 @@ u32 btrfs_decompress(u8 type, const char *, u32, char *, u32);
 int btrfs_readlink(struct btrfs_root *root, u64 ino, char *target);
 int btrfs_file_read(struct btrfs_root *root, u64 ino, u64 file_offset, u64 len,
 		    char *dest);
+int btrfs_file_extents(struct btrfs_root *root, u64 ino, u64 size,
+		       struct fs_extent **extp);
 
 /* subvolume.c */
 u64 btrfs_get_default_subvol_objectid(void);
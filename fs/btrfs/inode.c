@@ -5,6 +5,8 @@
  * 2017 Marek Behun, CZ.NIC, marek.behun@nic.cz
  */
 
+#include <fs.h>
+#include <fs_internal.h>
 #include <linux/kernel.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -765,3 +767,98 @@ out:
 		return ret;
 	return len;
 }
+
+/*
+ * Describe the data of regular file @ino, of size @size, as runs on the
+ * partition holding the filesystem.
+ *
+ * Only single-device filesystems with uncompressed, non-inline file extents
+ * can be described, -ENOSYS is returned otherwise.
+ *
+ * Return the number of extents, with the array returned in @extp.
+ * Return <0 for error.
+ */
+int btrfs_file_extents(struct btrfs_root *root, u64 ino, u64 size,
+		       struct fs_extent **extp)
+{
+	struct btrfs_fs_info *fs_info = root->fs_info;
+	struct btrfs_file_extent_item *fi;
+	struct btrfs_path path;
+	struct btrfs_key key;
+	u64 next_offset;
+	u64 cur = 0;
+	int count = 0;
+	int ret = 0;
+
+	*extp = NULL;
+	if (!list_is_singular(&fs_info->fs_devices->devices))
+		return -ENOSYS;
+
+	btrfs_init_path(&path);
+	while (cur < size) {
+		u64 logical, end;
+
+		btrfs_release_path(&path);
+		ret = lookup_data_extent(root, &path, ino, cur, &next_offset);
+		if (ret < 0)
+			goto out;
+		if (ret > 0) {
+			/* Hole up to the next extent, or up to the end */
+			if (!next_offset)
+				break;
+			cur = next_offset;
+			continue;
+		}
+		fi = btrfs_item_ptr(path.nodes[0], path.slots[0],
+				    struct btrfs_file_extent_item);
+		btrfs_item_key_to_cpu(path.nodes[0], &key, path.slots[0]);
+		end = min(size, key.offset +
+			  btrfs_file_extent_num_bytes(path.nodes[0], fi));
+
+		if (btrfs_file_extent_type(path.nodes[0], fi) ==
+		    BTRFS_FILE_EXTENT_INLINE ||
+		    btrfs_file_extent_compression(path.nodes[0], fi) !=
+		    BTRFS_COMPRESS_NONE) {
+			ret = -ENOSYS;
+			goto out;
+		}
+		/* Skip holes, they read as zeroes */
+		if (btrfs_file_extent_type(path.nodes[0], fi) ==
+		    BTRFS_FILE_EXTENT_PREALLOC ||
+		    btrfs_file_extent_disk_bytenr(path.nodes[0], fi) == 0) {
+			cur = end;
+			continue;
+		}
+
+		logical = btrfs_file_extent_disk_bytenr(path.nodes[0], fi) +
+			  btrfs_file_extent_offset(path.nodes[0], fi) +
+			  cur - key.offset;
+		while (cur < end) {
+			struct btrfs_multi_bio *multi = NULL;
+			u64 len = end - cur;
+
+			ret = btrfs_map_block(fs_info, READ, logical, &len,
+					      &multi, 1, NULL);
+			if (ret)
+				goto out;
+			len = min(len, end - cur);
+			count = fs_add_extent(extp, count, cur, len,
+					      multi->stripes[0].physical);
+			kfree(multi);
+			if (count < 0) {
+				ret = count;
+				goto out;
+			}
+			logical += len;
+			cur += len;
+		}
+	}
+	ret = count;
+out:
+	btrfs_release_path(&path);
+	if (ret < 0) {
+		free(*extp);
+		*extp = NULL;
+	}
+	return ret;
+}
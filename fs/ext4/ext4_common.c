@@ -27,6 +27,7 @@
 #include <memalign.h>
 #include <part.h>
 #include <stddef.h>
+#include <linux/bitmap.h>
 #include <linux/stat.h>
 #include <linux/time.h>
 #include <asm/byteorder.h>
@@ -54,6 +55,13 @@ struct ext2_block_group *ext4fs_get_group_descriptor
 	return (struct ext2_block_group *)(fs->gdtable + (bg_idx * fs->gdsize));
 }
 
+/* Note that a group's bitmaps or descriptor changed, see ext4fs_update() */
+void ext4fs_bg_mark_dirty(const struct ext2_block_group *bg,
+			  const struct ext_filesystem *fs)
+{
+	__set_bit(((char *)bg - fs->gdtable) / fs->gdsize, fs->dirty_grps);
+}
+
 static inline void ext4fs_sb_free_inodes_dec(struct ext2_sblock *sb)
 {
 	sb->free_inodes = cpu_to_le32(le32_to_cpu(sb->free_inodes) - 1);
@@ -80,6 +88,7 @@ static inline void ext4fs_bg_free_inodes_dec
 	bg->free_inodes = cpu_to_le16(free_inodes & 0xffff);
 	if (fs->gdsize == 64)
 		bg->free_inodes_high = cpu_to_le16(free_inodes >> 16);
+	ext4fs_bg_mark_dirty(bg, fs);
 }
 
 static inline void ext4fs_bg_free_blocks_dec
@@ -93,6 +102,7 @@ static inline void ext4fs_bg_free_blocks_dec
 	bg->free_blocks = cpu_to_le16(free_blocks & 0xffff);
 	if (fs->gdsize == 64)
 		bg->free_blocks_high = cpu_to_le16(free_blocks >> 16);
+	ext4fs_bg_mark_dirty(bg, fs);
 }
 
 static inline void ext4fs_bg_itable_unused_dec
@@ -967,10 +977,14 @@ uint32_t ext4fs_get_new_blk_no(void)
 	static int prev_bg_bitmap_index = -1;
 	unsigned int blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
-		goto fail;
+	char *journal_buffer = NULL;
+
+	/* the old bitmaps are only needed to fill in the journal */
+	if (ext4fs_has_journal()) {
+		journal_buffer = zalloc(fs->blksz);
+		if (!journal_buffer)
+			goto fail;
+	}
 
 	if (fs->first_pass_bbmap == 0) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
@@ -981,10 +995,7 @@ uint32_t ext4fs_get_new_blk_no(void)
 				uint64_t b_bitmap_blk =
 					ext4fs_bg_get_block_id(bgd, fs);
 				if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-					memcpy(fs->blk_bmaps[i], zero_buffer,
-					       fs->blksz);
-					put_ext4(b_bitmap_blk * fs->blksz,
-						 fs->blk_bmaps[i], fs->blksz);
+					memset(fs->blk_bmaps[i], 0, fs->blksz);
 					bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
 					ext4fs_bg_set_flags(bgd, bg_flags);
 				}
@@ -998,6 +1009,8 @@ uint32_t ext4fs_get_new_blk_no(void)
 				fs->first_pass_bbmap++;
 				ext4fs_bg_free_blocks_dec(bgd, fs);
 				ext4fs_sb_free_blocks_dec(fs->sb);
+				if (!journal_buffer)
+					goto success;
 				status = ext4fs_devread(b_bitmap_blk *
 							fs->sect_perblk,
 							0, fs->blksz,
@@ -1045,9 +1058,7 @@ restart:
 		uint16_t bg_flags = ext4fs_bg_get_flags(bgd);
 		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
 		if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-			memcpy(fs->blk_bmaps[bg_idx], zero_buffer, fs->blksz);
-			put_ext4(b_bitmap_blk * fs->blksz,
-				 zero_buffer, fs->blksz);
+			memset(fs->blk_bmaps[bg_idx], 0, fs->blksz);
 			bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
 			ext4fs_bg_set_flags(bgd, bg_flags);
 		}
@@ -1061,7 +1072,7 @@ restart:
 		}
 
 		/* journal backup */
-		if (prev_bg_bitmap_index != bg_idx) {
+		if (journal_buffer && prev_bg_bitmap_index != bg_idx) {
 			status = ext4fs_devread(b_bitmap_blk * fs->sect_perblk,
 						0, fs->blksz, journal_buffer);
 			if (status == 0)
@@ -1077,12 +1088,10 @@ restart:
 	}
 success:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return fs->curr_blkno;
 fail:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return -1;
 }
@@ -1095,10 +1104,13 @@ int ext4fs_get_new_inode_no(void)
 	static int prev_inode_bitmap_index = -1;
 	unsigned int inodes_per_grp = le32_to_cpu(ext4fs_root->sblock.inodes_per_group);
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
-		goto fail;
+	char *journal_buffer = NULL;
+
+	if (ext4fs_has_journal()) {
+		journal_buffer = zalloc(fs->blksz);
+		if (!journal_buffer)
+			goto fail;
+	}
 	int has_gdt_chksum = le32_to_cpu(fs->sb->feature_ro_compat) &
 		EXT4_FEATURE_RO_COMPAT_GDT_CSUM ? 1 : 0;
 
@@ -1115,12 +1127,10 @@ int ext4fs_get_new_inode_no(void)
 				if (has_gdt_chksum)
 					bgd->bg_itable_unused = free_inodes;
 				if (bg_flags & EXT4_BG_INODE_UNINIT) {
-					put_ext4(i_bitmap_blk * fs->blksz,
-						 zero_buffer, fs->blksz);
 					bg_flags &= ~EXT4_BG_INODE_UNINIT;
 					ext4fs_bg_set_flags(bgd, bg_flags);
-					memcpy(fs->inode_bmaps[i],
-					       zero_buffer, fs->blksz);
+					memset(fs->inode_bmaps[i], 0,
+					       fs->blksz);
 				}
 				fs->curr_inode_no =
 				    _get_new_inode_no(fs->inode_bmaps[i]);
@@ -1134,6 +1144,8 @@ int ext4fs_get_new_inode_no(void)
 				if (has_gdt_chksum)
 					ext4fs_bg_itable_unused_dec(bgd, fs);
 				ext4fs_sb_free_inodes_dec(fs->sb);
+				if (!journal_buffer)
+					goto success;
 				status = ext4fs_devread(i_bitmap_blk *
 							fs->sect_perblk,
 							0, fs->blksz,
@@ -1159,12 +1171,9 @@ restart:
 		uint64_t i_bitmap_blk = ext4fs_bg_get_inode_id(bgd, fs);
 
 		if (bg_flags & EXT4_BG_INODE_UNINIT) {
-			put_ext4(i_bitmap_blk * fs->blksz,
-				 zero_buffer, fs->blksz);
 			bg_flags &= ~EXT4_BG_INODE_UNINIT;
 			ext4fs_bg_set_flags(bgd, bg_flags);
-			memcpy(fs->inode_bmaps[ibmap_idx], zero_buffer,
-				fs->blksz);
+			memset(fs->inode_bmaps[ibmap_idx], 0, fs->blksz);
 		}
 
 		if (ext4fs_set_inode_bmap(fs->curr_inode_no,
@@ -1176,7 +1185,7 @@ restart:
 		}
 
 		/* journal backup */
-		if (prev_inode_bitmap_index != ibmap_idx) {
+		if (journal_buffer && prev_inode_bitmap_index != ibmap_idx) {
 			status = ext4fs_devread(i_bitmap_blk * fs->sect_perblk,
 						0, fs->blksz, journal_buffer);
 			if (status == 0)
@@ -1195,12 +1204,10 @@ restart:
 
 success:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return fs->curr_inode_no;
 fail:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return -1;
 
@@ -1493,6 +1500,66 @@ fail:
 	free(ti_gp_buff_start_addr);
 }
 
+/*
+ * Point the block allocator at the first free run of @count blocks, or
+ * failing that at the longest free run, so that the blocks of a file are
+ * contiguous and go out in a few large writes. Groups whose block bitmap is
+ * not initialised yet are left to the allocator.
+ */
+static void ext4fs_find_free_run(unsigned int count)
+{
+	struct ext_filesystem *fs = get_fs();
+	unsigned int blk_per_grp =
+		le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
+	uint32_t first = le32_to_cpu(ext4fs_root->sblock.first_data_block);
+	unsigned int best_len = 0;
+	long int best = -1;
+	int i;
+
+	for (i = 0; i < fs->no_blkgrp && best_len < count; i++) {
+		struct ext2_block_group *bgd =
+			ext4fs_get_group_descriptor(fs, i);
+		unsigned char *bmap = fs->blk_bmaps[i];
+		unsigned int bit = 0, start;
+
+		if (ext4fs_bg_get_free_blocks(bgd, fs) <= best_len ||
+		    ext4fs_bg_get_flags(bgd) & EXT4_BG_BLOCK_UNINIT)
+			continue;
+
+		while (bit < blk_per_grp && best_len < count) {
+			/* step over whole bytes where possible */
+			if (!(bit & 7) && bmap[bit >> 3] == 0xff) {
+				bit += 8;
+				continue;
+			}
+			if (bmap[bit >> 3] & (1 << (bit & 7))) {
+				bit++;
+				continue;
+			}
+
+			start = bit;
+			while (bit < blk_per_grp &&
+			       !(bmap[bit >> 3] & (1 << (bit & 7)))) {
+				if (!(bit & 7) && !bmap[bit >> 3] &&
+				    bit + 8 <= blk_per_grp)
+					bit += 8;
+				else
+					bit++;
+			}
+			if (bit - start > best_len) {
+				best_len = bit - start;
+				best = (long int)i * blk_per_grp + start + first;
+			}
+		}
+	}
+
+	if (best != -1) {
+		/* ext4fs_get_new_blk_no() carries on after curr_blkno */
+		fs->curr_blkno = best - 1;
+		fs->first_pass_bbmap = 1;
+	}
+}
+
 void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 				unsigned int total_remaining_blocks,
 				unsigned int *total_no_of_block)
@@ -1500,6 +1567,13 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 	short i;
 	long int direct_blockno;
 	unsigned int no_blks_reqd = 0;
+	struct ext_filesystem *fs = get_fs();
+
+	/* room for the data and the indirect blocks which map it */
+	if (total_remaining_blocks)
+		ext4fs_find_free_run(total_remaining_blocks +
+				     total_remaining_blocks /
+				     (fs->blksz / sizeof(__le32)) + 3);
 
 	/* allocation of direct blocks */
 	for (i = 0; total_remaining_blocks && i < INDIRECT_BLOCKS; i++) {
@@ -1566,6 +1640,149 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 	}
 }
 
+static int ext4fs_add_run(struct ext2fs_node *node, int *max, uint32_t lblk,
+			  uint32_t len, uint64_t pblk)
+{
+	struct ext4_run *run;
+
+	if (node->nruns) {
+		uint64_t next;
+
+		run = &node->runs[node->nruns - 1];
+		next = (uint64_t)run->lblk + run->len;
+
+		/* the tree is sorted, anything else means it is corrupt */
+		if (lblk < next)
+			return -EINVAL;
+
+		/* merge runs which also follow each other on the disk */
+		if (lblk == next && (pblk ? run->pblk &&
+				     pblk == run->pblk + run->len :
+				     !run->pblk)) {
+			run->len += len;
+			return 0;
+		}
+	}
+
+	if (node->nruns == *max) {
+		int n = *max ? *max * 2 : 16;
+
+		run = realloc(node->runs, n * sizeof(*run));
+		if (!run)
+			return -ENOMEM;
+		node->runs = run;
+		*max = n;
+	}
+	run = &node->runs[node->nruns++];
+	run->lblk = lblk;
+	run->len = len;
+	run->pblk = pblk;
+
+	return 0;
+}
+
+static int ext4fs_walk_extents(struct ext2fs_node *node, int *max,
+			       struct ext4_extent_header *ext_block, int size,
+			       int depth)
+{
+	struct ext2_data *data = node->data;
+	int log2_blksz = LOG2_BLOCK_SIZE(data) - get_fs()->dev_desc->log2blksz;
+	int blksz = EXT2_BLOCK_SIZE(data);
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	struct ext4_extent_idx *index;
+	struct ext4_extent *extent;
+	unsigned long long block;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(ext_block->eh_depth) != depth ||
+	    (entries + 1) * (int)sizeof(*extent) > size)
+		return -EINVAL;
+
+	if (!depth) {
+		extent = (struct ext4_extent *)(ext_block + 1);
+		for (i = 0; i < entries && !ret; i++) {
+			uint32_t len = le16_to_cpu(extent[i].ee_len);
+
+			block = le16_to_cpu(extent[i].ee_start_hi);
+			block = (block << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+
+			/* unwritten extents read back as zeroes */
+			if (len > EXT4_EXT_INIT_MAX_LEN) {
+				len -= EXT4_EXT_INIT_MAX_LEN;
+				block = 0;
+			}
+			ret = ext4fs_add_run(node, max,
+					     le32_to_cpu(extent[i].ee_block),
+					     len, block);
+		}
+		return ret;
+	}
+
+	buf = memalign(ARCH_DMA_MINALIGN, blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0; i < entries && !ret; i++) {
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf))
+			ret = -EIO;
+		else
+			ret = ext4fs_walk_extents(node, max,
+						  (struct ext4_extent_header *)
+						  buf, blksz, depth - 1);
+	}
+	free(buf);
+
+	return ret;
+}
+
+/**
+ * ext4fs_map_extents() - decode the extent tree of an inode
+ *
+ * The whole tree is read once into node->runs, with runs which are
+ * contiguous both in the file and on disk merged, so that a file can be read
+ * with one device read per run. Nothing is done if it is already decoded.
+ *
+ * @node:	node of an inode which uses extents
+ * Return:	0 if OK, -ENOTSUPP if the inode has no extent tree, -EINVAL if
+ *		the tree is corrupt, other -ve on error
+ */
+int ext4fs_map_extents(struct ext2fs_node *node)
+{
+	struct ext4_extent_header *ext_block;
+	int depth, max = 0, ret;
+
+	if (node->runs)
+		return 0;
+	if (!(le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL))
+		return -ENOTSUPP;
+
+	ext_block = (struct ext4_extent_header *)node->inode.b.blocks.dir_blocks;
+	depth = le16_to_cpu(ext_block->eh_depth);
+	if (depth > EXT4_EXT_MAX_DEPTH)
+		return -EINVAL;
+
+	ret = ext4fs_walk_extents(node, &max, ext_block,
+				  sizeof(node->inode.b), depth);
+	if (ret)
+		ext4fs_drop_extents(node);
+
+	return ret;
+}
+
+void ext4fs_drop_extents(struct ext2fs_node *node)
+{
+	free(node->runs);
+	node->runs = NULL;
+	node->nruns = 0;
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
@@ -2042,6 +2259,60 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+/**
+ * ext4fs_dirent_node() - make a node for a directory entry
+ *
+ * The type of the entry is taken from the entry itself if it has one,
+ * otherwise the inode is read to find it.
+ *
+ * @dir:	directory holding the entry
+ * @dirent:	directory entry
+ * @type:	returns the FILETYPE_... of the entry
+ * Return:	new node, or NULL on error
+ */
+struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *dir,
+				       struct ext2_dirent *dirent, int *type)
+{
+	struct ext2fs_node *fdiro;
+	int mode;
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return NULL;
+
+	fdiro->data = dir->data;
+	fdiro->ino = le32_to_cpu(dirent->inode);
+	*type = FILETYPE_UNKNOWN;
+
+	if (dirent->filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (dirent->filetype == FILETYPE_DIRECTORY)
+			*type = FILETYPE_DIRECTORY;
+		else if (dirent->filetype == FILETYPE_SYMLINK)
+			*type = FILETYPE_SYMLINK;
+		else if (dirent->filetype == FILETYPE_REG)
+			*type = FILETYPE_REG;
+		return fdiro;
+	}
+
+	if (!ext4fs_read_inode(dir->data, fdiro->ino, &fdiro->inode)) {
+		free(fdiro);
+		return NULL;
+	}
+	fdiro->inode_read = 1;
+
+	mode = le16_to_cpu(fdiro->inode.mode) & FILETYPE_INO_MASK;
+	if (mode == FILETYPE_INO_DIRECTORY)
+		*type = FILETYPE_DIRECTORY;
+	else if (mode == FILETYPE_INO_SYMLINK)
+		*type = FILETYPE_SYMLINK;
+	else if (mode == FILETYPE_INO_REG)
+		*type = FILETYPE_REG;
+
+	return fdiro;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2059,6 +2330,12 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
+	/* Use the hash tree index to find a name, if the directory has one */
+	if (name && fnode && ftype) {
+		status = ext4fs_dx_find(diro, name, fnode, ftype);
+		if (status >= 0)
+			return status;
+	}
 	/* Search the file.  */
 	while (fpos < le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
@@ -2087,49 +2364,12 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			if (status < 0)
 				return 0;
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
+			fdiro = ext4fs_dirent_node(diro, &dirent, &type);
 			if (!fdiro)
 				return 0;
 
-			fdiro->data = diro->data;
-			fdiro->ino = le32_to_cpu(dirent.inode);
-
 			filename[dirent.namelen] = '\0';
 
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				status = ext4fs_read_inode(diro->data,
-							   le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (status == 0) {
-					free(fdiro);
-					return 0;
-				}
-				fdiro->inode_read = 1;
-
-				if ((le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
 #ifdef DEBUG
 			printf("iterate >%s<\n", filename);
 #endif /* of DEBUG */
@@ -2341,7 +2581,11 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* the filesystem may stay mounted across several opens */
+	if (ext4fs_file) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -2368,7 +2612,7 @@ int ext4fs_mount(unsigned part_length)
 	struct ext2_data *data;
 	int status;
 	struct ext_filesystem *fs = get_fs();
-	data = zalloc(SUPERBLOCK_SIZE);
+	data = zalloc(sizeof(*data));
 	if (!data)
 		return 0;
 
@@ -56,6 +56,20 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 			struct ext2fs_node **foundnode, int expecttype);
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
+struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *dir,
+				       struct ext2_dirent *dirent, int *type);
+int ext4fs_map_extents(struct ext2fs_node *node);
+#if IS_ENABLED(CONFIG_EXT4_HTREE)
+int ext4fs_dx_find(struct ext2fs_node *dir, const char *name,
+		   struct ext2fs_node **fnode, int *ftype);
+#else
+static inline int ext4fs_dx_find(struct ext2fs_node *dir, const char *name,
+				 struct ext2fs_node **fnode, int *ftype)
+{
+	return -ENOSYS;
+}
+#endif
+void ext4fs_drop_extents(struct ext2fs_node *node);
 
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
@@ -86,5 +100,8 @@ uint64_t ext4fs_sb_get_free_blocks(const struct ext2_sblock *sb);
 void ext4fs_sb_set_free_blocks(struct ext2_sblock *sb, uint64_t free_blocks);
 uint32_t ext4fs_bg_get_free_blocks(const struct ext2_block_group *bg,
 	const struct ext_filesystem *fs);
+void ext4fs_bg_mark_dirty(const struct ext2_block_group *bg,
+			  const struct ext_filesystem *fs);
+void ext4fs_wb_add(uint64_t blknr, const void *buf);
 #endif
 #endif
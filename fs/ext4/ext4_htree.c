@@ -0,0 +1,480 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Hash tree (htree) directory lookup for ext4
+ *
+ * Large directories carry an index, kept in the blocks of the directory
+ * itself, which maps the hash of a name to the leaf block holding it. This
+ * lets a name be found in a few block reads, whatever the directory size.
+ *
+ * The hash functions are taken from Linux fs/ext4/hash.c:
+ * Copyright (C) 2002 by Theodore Ts'o
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <ext4fs.h>
+#include <ext_common.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include "ext4_common.h"
+
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+#define EXT2_FLAGS_SIGNED_HASH		0x0001
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+#define EXT4_HTREE_EOF_32BIT		0x7fffffff
+
+/* Index levels including the root, Linux allows three only with largedir */
+#define DX_MAX_LEVELS			3
+
+struct dx_root_info {
+	__le32 reserved_zero;
+	u8 hash_version;
+	u8 info_length;		/* 8 */
+	u8 indirect_levels;
+	u8 unused_flags;
+};
+
+/* the first entry of each index block holds its limit and count */
+struct dx_entry {
+	__le32 hash;
+	__le32 block;
+};
+
+struct dx_countlimit {
+	__le16 limit;
+	__le16 count;
+};
+
+struct dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	struct dx_entry *at;
+	int count;
+};
+
+#define DELTA 0x9E3779B9
+
+static void tea_transform(u32 buf[4], const u32 in[])
+{
+	u32 sum = 0;
+	u32 b0 = buf[0], b1 = buf[1];
+	u32 a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+/* F, G and H are basic MD4 functions: selection, majority, parity */
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = (a << (s)) | (a >> (32 - (s))))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+static void half_md4_transform(u32 buf[4], const u32 in[8])
+{
+	u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+/* The old legacy hash */
+static u32 dx_hack_hash(const char *name, int len, bool is_unsigned)
+{
+	u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int c;
+
+	while (len--) {
+		c = is_unsigned ? (int)(unsigned char)*name :
+				  (int)(signed char)*name;
+		name++;
+		hash = hash1 + (hash0 ^ (c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return hash0 << 1;
+}
+
+static void str2hashbuf(const char *msg, int len, u32 *buf, int num,
+			bool is_unsigned)
+{
+	u32 pad, val;
+	int i, c;
+
+	pad = (u32)len | ((u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		c = is_unsigned ? (int)(unsigned char)msg[i] :
+				  (int)(signed char)msg[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/**
+ * ext4fs_dirhash() - hash a file name as the directory index does
+ *
+ * @name:	name to hash
+ * @len:	length of @name
+ * @version:	DX_HASH_... algorithm
+ * @seed:	hash seed from the superblock, all zero for the default
+ * @hashp:	returns the hash, with the bottom bit clear
+ * Return:	0 if OK, -ENOTSUPP for an unknown algorithm
+ */
+static int ext4fs_dirhash(const char *name, int len, int version,
+			  const u32 seed[4], u32 *hashp)
+{
+	bool is_unsigned = false;
+	u32 in[8], buf[4];
+	u32 hash;
+	int i;
+
+	/* Initialize the default seed for the hash checksum functions */
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	for (i = 0; i < 4; i++) {
+		if (seed[i]) {
+			memcpy(buf, seed, sizeof(buf));
+			break;
+		}
+	}
+
+	switch (version) {
+	case DX_HASH_LEGACY_UNSIGNED:
+		is_unsigned = true;
+		/* fall through */
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, is_unsigned);
+		break;
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		is_unsigned = true;
+		/* fall through */
+	case DX_HASH_HALF_MD4:
+		for (; len > 0; len -= 32, name += 32) {
+			str2hashbuf(name, len, in, 8, is_unsigned);
+			half_md4_transform(buf, in);
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA_UNSIGNED:
+		is_unsigned = true;
+		/* fall through */
+	case DX_HASH_TEA:
+		for (; len > 0; len -= 16, name += 16) {
+			str2hashbuf(name, len, in, 4, is_unsigned);
+			tea_transform(buf, in);
+		}
+		hash = buf[0];
+		break;
+	default:
+		return -ENOTSUPP;
+	}
+
+	hash &= ~1;
+	if (hash == (EXT4_HTREE_EOF_32BIT << 1))
+		hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+	*hashp = hash;
+
+	return 0;
+}
+
+static int dx_read_block(struct ext2fs_node *dir, struct ext_block_cache *cache,
+			 u32 block, char *buf)
+{
+	int log2_blksz = LOG2_BLOCK_SIZE(dir->data) -
+			 get_fs()->dev_desc->log2blksz;
+	long int blknr;
+
+	if ((u64)block << LOG2_BLOCK_SIZE(dir->data) >=
+	    le32_to_cpu(dir->inode.size))
+		return -EINVAL;
+
+	blknr = read_allocated_block(&dir->inode, block, cache);
+	if (blknr <= 0)
+		return -EINVAL;
+	if (!ext4fs_devread((lbaint_t)blknr << log2_blksz, 0,
+			    EXT2_BLOCK_SIZE(dir->data), buf))
+		return -EIO;
+
+	return 0;
+}
+
+/* Set up a frame for the index entries at @entries, checking their limits */
+static int dx_frame_init(struct dx_frame *frame, char *buf, int offset,
+			 int blksz)
+{
+	struct dx_countlimit *cl;
+	int limit;
+
+	frame->buf = buf;
+	frame->entries = (struct dx_entry *)(buf + offset);
+	cl = (struct dx_countlimit *)frame->entries;
+	limit = le16_to_cpu(cl->limit);
+	frame->count = le16_to_cpu(cl->count);
+	if (!frame->count || frame->count > limit ||
+	    offset + limit * (int)sizeof(struct dx_entry) > blksz)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Point the frame at the last entry whose hash is not above @hash */
+static void dx_frame_search(struct dx_frame *frame, u32 hash)
+{
+	struct dx_entry *p = frame->entries + 1;
+	struct dx_entry *q = frame->entries + frame->count - 1;
+
+	while (p <= q) {
+		struct dx_entry *m = p + (q - p) / 2;
+
+		if (le32_to_cpu(m->hash) > hash)
+			q = m - 1;
+		else
+			p = m + 1;
+	}
+	frame->at = p - 1;
+}
+
+static u32 dx_get_block(struct dx_entry *entry)
+{
+	return le32_to_cpu(entry->block) & 0x0fffffff;
+}
+
+/* Look for @name in a leaf block, returning the entry or NULL */
+static struct ext2_dirent *dx_search_leaf(char *buf, int blksz,
+					  const char *name, int len)
+{
+	int offset = 0;
+
+	while (offset + (int)sizeof(struct ext2_dirent) <= blksz) {
+		struct ext2_dirent *dirent = (struct ext2_dirent *)(buf + offset);
+		int direntlen = le16_to_cpu(dirent->direntlen);
+
+		if (direntlen < sizeof(struct ext2_dirent) ||
+		    offset + direntlen > blksz ||
+		    sizeof(struct ext2_dirent) + dirent->namelen > direntlen)
+			return NULL;
+		if (dirent->inode && dirent->namelen == len &&
+		    !memcmp(dirent + 1, name, len))
+			return dirent;
+		offset += direntlen;
+	}
+
+	return NULL;
+}
+
+/*
+ * Move on to the next leaf block if it may hold more names with the same
+ * hash, which happens when a run of colliding names spans two blocks
+ */
+static int dx_next_block(struct ext2fs_node *dir, struct ext_block_cache *cache,
+			 struct dx_frame *frames, struct dx_frame *frame,
+			 u32 hash)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame *p = frame;
+	int ret;
+
+	while (++p->at >= p->entries + p->count) {
+		if (p == frames)
+			return 0;
+		p--;
+	}
+
+	/* the bottom bit marks a continued collision */
+	if ((le32_to_cpu(p->at->hash) & ~1) != hash)
+		return 0;
+
+	while (p < frame) {
+		ret = dx_read_block(dir, cache, dx_get_block(p->at), p[1].buf);
+		if (ret)
+			return ret;
+		p++;
+		ret = dx_frame_init(p, p->buf, sizeof(struct ext2_dirent),
+				    blksz);
+		if (ret)
+			return ret;
+		p->at = p->entries;
+	}
+
+	return 1;
+}
+
+/**
+ * ext4fs_dx_find() - look up a name through a directory's hash tree index
+ *
+ * @dir:	directory to search
+ * @name:	name to find
+ * @fnode:	returns the node of the entry, if found
+ * @ftype:	returns the FILETYPE_... of the entry, if found
+ * Return:	1 if found, 0 if not, -ve if the directory has no usable index
+ *		and must be searched linearly
+ */
+int ext4fs_dx_find(struct ext2fs_node *dir, const char *name,
+		   struct ext2fs_node **fnode, int *ftype)
+{
+	struct ext2_sblock *sblock = &dir->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame frames[DX_MAX_LEVELS];
+	struct ext_block_cache cache;
+	struct dx_root_info *info;
+	struct ext2_dirent *dirent;
+	int len = strlen(name);
+	int levels, version, i, ret;
+	char *buf, *leaf;
+	u32 seed[4];
+	u32 hash;
+
+	if (!(le32_to_cpu(sblock->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL) ||
+	    le32_to_cpu(dir->inode.flags) & EXT4_CASEFOLD_FL)
+		return -ENOTSUPP;
+
+	buf = memalign(ARCH_DMA_MINALIGN, (DX_MAX_LEVELS + 1) * blksz);
+	if (!buf)
+		return -ENOMEM;
+	leaf = buf + DX_MAX_LEVELS * blksz;
+	ext_cache_init(&cache);
+
+	/* the root sits behind fake "." and ".." entries in block 0 */
+	ret = dx_read_block(dir, &cache, 0, buf);
+	if (ret)
+		goto out;
+	info = (struct dx_root_info *)(buf + 2 * 12);
+	levels = info->indirect_levels;
+	version = info->hash_version;
+	if (info->reserved_zero || info->info_length != sizeof(*info) ||
+	    levels >= DX_MAX_LEVELS) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (version <= DX_HASH_TEA) {
+		u32 flags = le32_to_cpu(sblock->flags);
+
+		if (flags & EXT2_FLAGS_UNSIGNED_HASH)
+			version += 3;
+#ifdef __CHAR_UNSIGNED__
+		else if (!(flags & EXT2_FLAGS_SIGNED_HASH))
+			version += 3;
+#endif
+	}
+
+	for (i = 0; i < 4; i++)
+		seed[i] = le32_to_cpu(sblock->hash_seed[i]);
+	ret = ext4fs_dirhash(name, len, version, seed, &hash);
+	if (ret)
+		goto out;
+
+	ret = dx_frame_init(&frames[0], buf, 2 * 12 + sizeof(*info), blksz);
+	if (ret)
+		goto out;
+	dx_frame_search(&frames[0], hash);
+	for (i = 1; i <= levels; i++) {
+		char *ibuf = buf + i * blksz;
+
+		ret = dx_read_block(dir, &cache, dx_get_block(frames[i - 1].at),
+				    ibuf);
+		if (ret)
+			goto out;
+		/* index blocks start with an empty entry covering the block */
+		ret = dx_frame_init(&frames[i], ibuf,
+				    sizeof(struct ext2_dirent), blksz);
+		if (ret)
+			goto out;
+		dx_frame_search(&frames[i], hash);
+	}
+	do {
+		ret = dx_read_block(dir, &cache, dx_get_block(frames[levels].at),
+				    leaf);
+		if (ret)
+			goto out;
+		dirent = dx_search_leaf(leaf, blksz, name, len);
+		if (dirent) {
+			*fnode = ext4fs_dirent_node(dir, dirent, ftype);
+			ret = *fnode ? 1 : -EIO;
+			goto out;
+		}
+		ret = dx_next_block(dir, &cache, frames, &frames[levels],
+				    hash);
+	} while (ret > 0);
+
+out:
+	ext_cache_fini(&cache);
+	free(buf);
+	if (ret < 0)
+		log_debug("htree lookup of %s failed (%d)\n", name, ret);
+
+	return ret;
+}
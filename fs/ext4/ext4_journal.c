@@ -58,6 +58,9 @@ int ext4fs_init_journal(void)
 		dirty_block_ptr[i]->blknr = -1;
 	}
 
+	if (!ext4fs_has_journal())
+		return 0;
+
 	if (fs->blksz == 4096) {
 		temp = zalloc(fs->blksz);
 		if (!temp)
@@ -90,16 +93,15 @@ fail:
 	return -1;
 }
 
+/* Queue the modified meta data for ext4fs_wb_flush() */
 void ext4fs_dump_metadata(void)
 {
-	struct ext_filesystem *fs = get_fs();
 	int i;
 	for (i = 0; i < MAX_JOURNAL_ENTRIES; i++) {
 		if (dirty_block_ptr[i]->blknr == -1)
 			break;
-		put_ext4((uint64_t) ((uint64_t)dirty_block_ptr[i]->blknr *
-				(uint64_t)fs->blksz), dirty_block_ptr[i]->buf,
-								fs->blksz);
+		ext4fs_wb_add(dirty_block_ptr[i]->blknr,
+			      dirty_block_ptr[i]->buf);
 	}
 }
 
@@ -132,6 +134,9 @@ int ext4fs_log_gdt(char *gd_table)
 	struct ext_filesystem *fs = get_fs();
 	short i;
 	long int var = fs->gdtable_blkno;
+
+	if (!ext4fs_has_journal())
+		return 0;
 	for (i = 0; i < fs->no_blk_pergdt; i++) {
 		journal_ptr[gindex]->buf = zalloc(fs->blksz);
 		if (!journal_ptr[gindex]->buf)
@@ -158,6 +163,8 @@ int ext4fs_log_journal(char *journal_buffer, uint32_t blknr)
 		printf("Invalid input arguments %s\n", __func__);
 		return -EINVAL;
 	}
+	if (!ext4fs_has_journal())
+		return 0;
 
 	for (i = 0; i < MAX_JOURNAL_ENTRIES; i++) {
 		if (journal_ptr[i]->blknr == -1)
@@ -646,7 +653,7 @@ void ext4fs_update_journal(void)
 	long int blknr;
 	int i;
 
-	if (!(fs->sb->feature_compatibility & EXT4_FEATURE_COMPAT_HAS_JOURNAL))
+	if (!ext4fs_has_journal())
 		return;
 
 	ext4fs_read_inode(ext4fs_root, EXT2_JOURNAL_INO, &inode_journal);
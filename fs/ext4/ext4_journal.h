@@ -114,6 +114,16 @@ struct revoke_blk_list {
 
 extern struct ext2_data *ext4fs_root;
 
+/*
+ * Without a journal there is nothing to log or replay, and metadata is just
+ * written back by ext4fs_update()
+ */
+static inline bool ext4fs_has_journal(void)
+{
+	return le32_to_cpu(get_fs()->sb->feature_compatibility) &
+		EXT4_FEATURE_COMPAT_HAS_JOURNAL;
+}
+
 int ext4fs_init_journal(void);
 int ext4fs_log_gdt(char *gd_table);
 int ext4fs_check_journal_state(int recovery_flag);
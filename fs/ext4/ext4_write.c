@@ -27,6 +27,8 @@
 #include <malloc.h>
 #include <memalign.h>
 #include <part.h>
+#include <sort.h>
+#include <linux/bitmap.h>
 #include <linux/stat.h>
 #include <div64.h>
 #include "ext4_common.h"
@@ -52,6 +54,7 @@ static inline void ext4fs_bg_free_inodes_inc
 	bg->free_inodes = cpu_to_le16(free_inodes & 0xffff);
 	if (fs->gdsize == 64)
 		bg->free_inodes_high = cpu_to_le16(free_inodes >> 16);
+	ext4fs_bg_mark_dirty(bg, fs);
 }
 
 static inline void ext4fs_bg_free_blocks_inc
@@ -65,42 +68,138 @@ static inline void ext4fs_bg_free_blocks_inc
 	bg->free_blocks = cpu_to_le16(free_blocks & 0xffff);
 	if (fs->gdsize == 64)
 		bg->free_blocks_high = cpu_to_le16(free_blocks >> 16);
+	ext4fs_bg_mark_dirty(bg, fs);
 }
 
+/* Largest number of adjacent metadata blocks written back in one go */
+#define EXT4_WB_RUN	32
+
+/* A metadata block waiting to be written back by ext4fs_wb_flush() */
+struct ext4_wb_block {
+	uint64_t blknr;
+	const void *buf;
+	int seq;
+};
+
+static struct ext4_wb_block *wb_list;
+static int wb_count, wb_max;
+
+/*
+ * Queue a metadata block for writing back. The buffer must stay valid until
+ * ext4fs_wb_flush(). If the queue cannot grow the block is written at once.
+ */
+void ext4fs_wb_add(uint64_t blknr, const void *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+
+	if (wb_count == wb_max) {
+		int n = wb_max ? wb_max * 2 : 64;
+		struct ext4_wb_block *list;
+
+		list = realloc(wb_list, n * sizeof(*list));
+		if (!list) {
+			put_ext4(blknr * fs->blksz, buf, fs->blksz);
+			return;
+		}
+		wb_list = list;
+		wb_max = n;
+	}
+	wb_list[wb_count].blknr = blknr;
+	wb_list[wb_count].buf = buf;
+	wb_list[wb_count].seq = wb_count;
+	wb_count++;
+}
+
+static int ext4fs_wb_cmp(const void *a, const void *b)
+{
+	const struct ext4_wb_block *wa = a, *wb = b;
+
+	if (wa->blknr != wb->blknr)
+		return wa->blknr < wb->blknr ? -1 : 1;
+
+	return wa->seq - wb->seq;
+}
+
+/*
+ * Write back the queued blocks in block order. Where a block was queued
+ * more than once the last copy wins, and runs of adjacent blocks are
+ * gathered into a single write.
+ */
+static void ext4fs_wb_flush(void)
+{
+	struct ext_filesystem *fs = get_fs();
+	char *run;
+	int i, j, k, n = 0;
+
+	qsort(wb_list, wb_count, sizeof(*wb_list), ext4fs_wb_cmp);
+	for (i = 0; i < wb_count; i++) {
+		if (i + 1 < wb_count && wb_list[i + 1].blknr == wb_list[i].blknr)
+			continue;
+		wb_list[n++] = wb_list[i];
+	}
+
+	run = memalign(ARCH_DMA_MINALIGN, EXT4_WB_RUN * fs->blksz);
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; run && j < n && j - i < EXT4_WB_RUN; j++) {
+			if (wb_list[j].blknr != wb_list[i].blknr + j - i)
+				break;
+		}
+		if (j - i == 1) {
+			put_ext4(wb_list[i].blknr * fs->blksz, wb_list[i].buf,
+				 fs->blksz);
+			continue;
+		}
+		for (k = i; k < j; k++)
+			memcpy(run + (k - i) * fs->blksz, wb_list[k].buf,
+			       fs->blksz);
+		put_ext4(wb_list[i].blknr * fs->blksz, run,
+			 (j - i) * fs->blksz);
+	}
+	free(run);
+
+	free(wb_list);
+	wb_list = NULL;
+	wb_count = 0;
+	wb_max = 0;
+}
+
+/*
+ * Write back all the metadata changed by an operation: the bitmaps and
+ * descriptors of the groups which changed and the blocks queued with
+ * ext4fs_put_metadata(), in block order
+ */
 static void ext4fs_update(void)
 {
-	short i;
-	ext4fs_update_journal();
 	struct ext_filesystem *fs = get_fs();
 	struct ext2_block_group *bgd = NULL;
+	int desc_per_blk = fs->blksz / fs->gdsize;
+	long int gdt_blk = -1;
+	int i;
+
+	ext4fs_update_journal();
 
 	/* update  super block */
 	put_ext4((uint64_t)(SUPERBLOCK_SIZE),
 		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 
-	/* update block bitmaps */
 	for (i = 0; i < fs->no_blkgrp; i++) {
+		if (!test_bit(i, fs->dirty_grps))
+			continue;
 		bgd = ext4fs_get_group_descriptor(fs, i);
 		bgd->bg_checksum = cpu_to_le16(ext4fs_checksum_update(i));
-		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
-		put_ext4(b_bitmap_blk * fs->blksz,
-			 fs->blk_bmaps[i], fs->blksz);
-	}
-
-	/* update inode bitmaps */
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		bgd = ext4fs_get_group_descriptor(fs, i);
-		uint64_t i_bitmap_blk = ext4fs_bg_get_inode_id(bgd, fs);
-		put_ext4(i_bitmap_blk * fs->blksz,
-			 fs->inode_bmaps[i], fs->blksz);
+		ext4fs_wb_add(ext4fs_bg_get_block_id(bgd, fs),
+			      fs->blk_bmaps[i]);
+		ext4fs_wb_add(ext4fs_bg_get_inode_id(bgd, fs),
+			      fs->inode_bmaps[i]);
+		if (i / desc_per_blk != gdt_blk) {
+			gdt_blk = i / desc_per_blk;
+			ext4fs_wb_add(fs->gdtable_blkno + gdt_blk,
+				      fs->gdtable + gdt_blk * fs->blksz);
+		}
 	}
-
-	/* update the block group descriptor table */
-	put_ext4((uint64_t)((uint64_t)fs->gdtable_blkno * (uint64_t)fs->blksz),
-		 (struct ext2_block_group *)fs->gdtable,
-		 (fs->blksz * fs->no_blk_pergdt));
-
 	ext4fs_dump_metadata();
+	ext4fs_wb_flush();
+	bitmap_zero(fs->dirty_grps, fs->no_blkgrp);
 
 	gindex = 0;
 	gd_index = 0;
@@ -630,6 +729,11 @@ int ext4fs_init(void)
 		goto fail;
 	}
 
+	fs->dirty_grps = zalloc(BITS_TO_LONGS(fs->no_blkgrp) *
+			       sizeof(unsigned long));
+	if (!fs->dirty_grps)
+		goto fail;
+
 	/* load all the available bitmap block of the partition */
 	fs->blk_bmaps = zalloc(fs->no_blkgrp * sizeof(char *));
 	if (!fs->blk_bmaps)
@@ -703,31 +807,39 @@ void ext4fs_deinit(void)
 	uint32_t new_feature_incompat;
 
 	/* free journal */
-	char *temp_buff = zalloc(fs->blksz);
-	if (temp_buff) {
-		ext4fs_read_inode(ext4fs_root, EXT2_JOURNAL_INO,
-				  &inode_journal);
-		blknr = read_allocated_block(&inode_journal,
-					EXT2_JOURNAL_SUPERBLOCK, NULL);
-		ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0, fs->blksz,
-			       temp_buff);
-		jsb = (struct journal_superblock_t *)temp_buff;
-		jsb->s_start = 0;
-		put_ext4((uint64_t) ((uint64_t)blknr * (uint64_t)fs->blksz),
-			 (struct journal_superblock_t *)temp_buff, fs->blksz);
-		free(temp_buff);
+	if (fs->sb && ext4fs_has_journal()) {
+		char *temp_buff = zalloc(fs->blksz);
+
+		if (temp_buff) {
+			ext4fs_read_inode(ext4fs_root, EXT2_JOURNAL_INO,
+					  &inode_journal);
+			blknr = read_allocated_block(&inode_journal,
+						EXT2_JOURNAL_SUPERBLOCK, NULL);
+			ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
+				       fs->blksz, temp_buff);
+			jsb = (struct journal_superblock_t *)temp_buff;
+			jsb->s_start = 0;
+			put_ext4((uint64_t) ((uint64_t)blknr *
+					     (uint64_t)fs->blksz),
+				 (struct journal_superblock_t *)temp_buff,
+				 fs->blksz);
+			free(temp_buff);
+		}
+
+		/* get the superblock */
+		ext4_read_superblock((char *)fs->sb);
+		new_feature_incompat = le32_to_cpu(fs->sb->feature_incompat);
+		new_feature_incompat &= ~EXT3_FEATURE_INCOMPAT_RECOVER;
+		fs->sb->feature_incompat = cpu_to_le32(new_feature_incompat);
+		put_ext4((uint64_t)(SUPERBLOCK_SIZE),
+			 (struct ext2_sblock *)fs->sb,
+			 (uint32_t)SUPERBLOCK_SIZE);
 	}
 	ext4fs_free_journal();
-
-	/* get the superblock */
-	ext4_read_superblock((char *)fs->sb);
-	new_feature_incompat = le32_to_cpu(fs->sb->feature_incompat);
-	new_feature_incompat &= ~EXT3_FEATURE_INCOMPAT_RECOVER;
-	fs->sb->feature_incompat = cpu_to_le32(new_feature_incompat);
-	put_ext4((uint64_t)(SUPERBLOCK_SIZE),
-		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 	free(fs->sb);
 	fs->sb = NULL;
+	free(fs->dirty_grps);
+	fs->dirty_grps = NULL;
 
 	if (fs->blk_bmaps) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
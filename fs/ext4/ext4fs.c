@@ -26,9 +26,12 @@
 #include <ext4fs.h>
 #include "ext4_common.h"
 #include <div64.h>
+#include <fs.h>
+#include <fs_internal.h>
 #include <malloc.h>
 #include <part.h>
 #include <uuid.h>
+#include <linux/sizes.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
@@ -40,8 +43,85 @@ struct ext_filesystem *get_fs(void)
 
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 {
-	if ((node != &ext4fs_root->diropen) && (node != currroot))
+	if ((node != &ext4fs_root->diropen) && (node != currroot)) {
+		ext4fs_drop_extents(node);
 		free(node);
+	}
+}
+
+/* Find the first run which ends after logical block @blk */
+static struct ext4_run *ext4fs_find_run(struct ext2fs_node *node, uint64_t blk)
+{
+	int lo = 0, hi = node->nruns;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		struct ext4_run *run = &node->runs[mid];
+
+		if ((uint64_t)run->lblk + run->len <= blk)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return &node->runs[lo];
+}
+
+/*
+ * Read from a file whose extent tree has been decoded by
+ * ext4fs_map_extents(). Each run is read with one device read straight into
+ * the destination buffer; holes and unwritten extents are zeroed.
+ */
+static int ext4fs_read_runs(struct ext2fs_node *node, loff_t pos, loff_t len,
+			    char *buf)
+{
+	int log2blksz = get_fs()->dev_desc->log2blksz;
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data);
+	struct ext4_run *end = node->runs + node->nruns;
+	struct ext4_run *run;
+	loff_t last = pos + len;
+
+	run = ext4fs_find_run(node, pos >> log2_fs_blocksize);
+	while (pos < last) {
+		loff_t start, n;
+
+		while (run < end && ((loff_t)run->lblk + run->len) <<
+		       log2_fs_blocksize <= pos)
+			run++;
+		if (run == end) {
+			memset(buf, 0, last - pos);
+			break;
+		}
+
+		start = (loff_t)run->lblk << log2_fs_blocksize;
+		if (start > pos) {
+			/* hole */
+			n = min(start, last) - pos;
+			memset(buf, 0, n);
+		} else {
+			n = ((loff_t)run->lblk + run->len) << log2_fs_blocksize;
+			/* fs_devread() takes an int length */
+			n = min3(n, last, pos + SZ_1G) - pos;
+			if (!run->pblk) {
+				memset(buf, 0, n);
+			} else {
+				loff_t off = pos - start;
+				lbaint_t sector;
+
+				sector = (run->pblk << (log2_fs_blocksize -
+							log2blksz)) +
+					 (off >> log2blksz);
+				if (!ext4fs_devread(sector,
+						    off & ((1 << log2blksz) - 1),
+						    n, buf))
+					return -1;
+			}
+		}
+		pos += n;
+		buf += n;
+	}
+
+	return 0;
 }
 
 /*
@@ -80,6 +160,16 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		return -1;
 	}
 
+	/* regular files are read a whole extent at a time */
+	if ((le16_to_cpu(node->inode.mode) & FILETYPE_INO_MASK) ==
+	    FILETYPE_INO_REG && !ext4fs_map_extents(node)) {
+		ext_cache_fini(&cache);
+		if (ext4fs_read_runs(node, pos, len, buf))
+			return -1;
+		*actread = len;
+		return 0;
+	}
+
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
 	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
@@ -259,6 +349,74 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	return ext4fs_read(buf, offset, len, len_read);
 }
 
+int ext4fs_get_extents(const char *filename, loff_t *size,
+		       struct fs_extent **extp)
+{
+	struct ext_block_cache cache;
+	struct ext2fs_node *node;
+	int blocksize, count = 0;
+	lbaint_t i, blockcnt;
+	loff_t file_len;
+
+	*extp = NULL;
+	if (ext4fs_open(filename, &file_len) < 0)
+		return -ENOENT;
+
+	node = ext4fs_file;
+	blocksize = EXT2_BLOCK_SIZE(node->data);
+	blockcnt = lldiv(file_len + blocksize - 1, blocksize);
+
+	if (!ext4fs_map_extents(node)) {
+		for (i = 0; i < node->nruns && count >= 0; i++) {
+			struct ext4_run *run = &node->runs[i];
+			loff_t offset = (loff_t)run->lblk * blocksize;
+
+			if (offset >= file_len)
+				break;
+			/* unwritten extents read as zeroes, like holes */
+			if (!run->pblk)
+				continue;
+			count = fs_add_extent(extp, count, offset,
+					      min((loff_t)run->len * blocksize,
+						  file_len - offset),
+					      run->pblk * blocksize);
+		}
+		goto done;
+	}
+
+	ext_cache_init(&cache);
+	for (i = 0; i < blockcnt; i++) {
+		loff_t offset = (loff_t)i * blocksize;
+		long int blknr;
+
+		blknr = read_allocated_block(&node->inode, i, &cache);
+		if (blknr < 0) {
+			count = -EIO;
+			break;
+		}
+		/* block 0 means a hole */
+		if (!blknr)
+			continue;
+
+		count = fs_add_extent(extp, count, offset,
+				      min((loff_t)blocksize, file_len - offset),
+				      (u64)blknr * blocksize);
+		if (count < 0)
+			break;
+	}
+	ext_cache_fini(&cache);
+
+done:
+	if (count < 0) {
+		free(*extp);
+		*extp = NULL;
+		return count;
+	}
+	*size = file_len;
+
+	return count;
+}
+
 int ext4fs_uuid(char *uuid_str)
 {
 	if (ext4fs_root == NULL)
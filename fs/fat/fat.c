@@ -14,6 +14,7 @@
 #include <exports.h>
 #include <fat.h>
 #include <fs.h>
+#include <fs_internal.h>
 #include <log.h>
 #include <asm/byteorder.h>
 #include <part.h>
@@ -22,6 +23,7 @@
 #include <asm/cache.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
+#include <linux/math64.h>
 
 /*
  * Convert a string to lowercase.  Converts at most 'len' characters,
@@ -39,6 +41,9 @@ static void downcase(char *str, size_t len)
 static struct blk_desc *cur_dev;
 static struct disk_partition cur_part_info;
 
+static void free_cluster_map_drop(void);
+static void fat_runs_drop(void);
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
@@ -62,6 +67,8 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, struct disk_partition *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	free_cluster_map_drop();
+	fat_runs_drop();
 	cur_dev = dev_desc;
 	cur_part_info = *info;
 
@@ -147,6 +154,7 @@ static void get_name(dir_entry *dirent, char *s_name)
 }
 
 static int flush_dirty_fat_buffer(fsdata *mydata);
+static int flush_fat_window(fsdata *mydata, int slot);
 
 #if !CONFIG_IS_ENABLED(FAT_WRITE)
 /* Stub for read only operation */
@@ -155,8 +163,87 @@ int flush_dirty_fat_buffer(fsdata *mydata)
 	(void)(mydata);
 	return 0;
 }
+
+static int flush_fat_window(fsdata *mydata, int slot)
+{
+	return 0;
+}
+
+static void free_cluster_map_drop(void)
+{
+}
 #endif
 
+/*
+ * Allocate an empty FAT cache for 'mydata'.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_alloc(fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE * FAT_CACHE_WINDOWS);
+	if (!mydata->fatbuf)
+		return -1;
+
+	for (i = 0; i < FAT_CACHE_WINDOWS; i++) {
+		mydata->fatbufnum[i] = -1;
+		mydata->fatbufused[i] = 0;
+		mydata->fat_dirty[i] = 0;
+	}
+	mydata->fatbufclock = 0;
+
+	return 0;
+}
+
+/*
+ * Get window 'bufnum' of the FAT (FATBUFBLOCKS sectors) from the cache,
+ * reading it into the least recently used slot if it is not there. Set
+ * 'dirty' if the caller is going to modify it.
+ * Return a pointer to the window, NULL on error.
+ */
+static __u8 *get_fat_window(fsdata *mydata, __u32 bufnum, bool dirty)
+{
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i, slot = 0;
+
+	for (i = 0; i < FAT_CACHE_WINDOWS; i++) {
+		if (mydata->fatbufnum[i] == (int)bufnum) {
+			slot = i;
+			goto found;
+		}
+		if (mydata->fatbufused[i] < mydata->fatbufused[slot])
+			slot = i;
+	}
+
+	/* Write back the window being evicted */
+	if (flush_fat_window(mydata, slot) < 0)
+		return NULL;
+
+	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	if (disk_read(startblock, getsize,
+		      mydata->fatbuf + slot * FATBUFSIZE) < 0) {
+		debug("Error reading FAT blocks\n");
+		mydata->fatbufnum[slot] = -1;
+		mydata->fatbufused[slot] = 0;
+		return NULL;
+	}
+	mydata->fatbufnum[slot] = bufnum;
+
+found:
+	mydata->fatbufused[slot] = ++mydata->fatbufclock;
+	if (dirty)
+		mydata->fat_dirty[slot] = 1;
+
+	return mydata->fatbuf + slot * FATBUFSIZE;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -166,6 +253,7 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 bufnum;
 	__u32 offset, off8;
 	__u32 ret = 0x00;
+	__u8 *fatbuf;
 
 	if (CHECK_CLUST(entry, mydata->fatsize)) {
 		printf("Error: Invalid FAT entry: 0x%08x\n", entry);
@@ -194,42 +282,22 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	fatbuf = get_fat_window(mydata, bufnum, false);
+	if (!fatbuf)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *)fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *)fatbuf)[offset]);
 		break;
 	case 12:
 		off8 = (offset * 3) / 2;
 		/* fatbut + off8 may be unaligned, read in byte granularity */
-		ret = mydata->fatbuf[off8] + (mydata->fatbuf[off8 + 1] << 8);
+		ret = fatbuf[off8] + (fatbuf[off8 + 1] << 8);
 
 		if (offset & 0x1)
 			ret >>= 4;
@@ -307,6 +375,107 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Cluster runs of the files read last. Reading a file again, or at another
+ * offset, then takes a walk over its runs rather than over its cluster
+ * chain in the FAT. The runs are dropped whenever the FAT is modified, and
+ * when the filesystem is closed or another device is selected.
+ */
+#define FAT_RUNS_FILES	4
+
+struct fat_run {
+	__u32	clust;		/* First cluster of the run */
+	__u32	count;		/* Number of consecutive clusters */
+};
+
+static struct {
+	__u32	start;		/* First cluster of the file */
+	__u32	size;		/* Size of the file in bytes */
+	__u32	nruns;		/* Number of runs */
+	__u32	used;		/* When last used, 0 if the slot is free */
+	struct fat_run *runs;
+} fat_runs[FAT_RUNS_FILES];
+
+static __u32 fat_runs_clock;
+
+static void fat_runs_drop(void)
+{
+	int i;
+
+	for (i = 0; i < FAT_RUNS_FILES; i++) {
+		free(fat_runs[i].runs);
+		fat_runs[i].runs = NULL;
+		fat_runs[i].used = 0;
+	}
+}
+
+/*
+ * Get the cluster runs of a file of 'size' bytes (not 0) whose chain starts
+ * at cluster 'start', following the chain in the FAT if they are not known.
+ * Return the runs, with their number in 'nrunsp', or NULL on error.
+ */
+static struct fat_run *get_file_runs(fsdata *mydata, __u32 start, __u32 size,
+				     __u32 *nrunsp)
+{
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	__u32 clusters = size / bytesperclust + !!(size % bytesperclust);
+	__u32 clust = start, n, nruns = 0, max = 0;
+	struct fat_run *runs = NULL, *tmp;
+	int i, slot = 0;
+
+	for (i = 0; i < FAT_RUNS_FILES; i++) {
+		if (fat_runs[i].used && fat_runs[i].start == start &&
+		    fat_runs[i].size == size) {
+			slot = i;
+			goto found;
+		}
+		if (fat_runs[i].used < fat_runs[slot].used)
+			slot = i;
+	}
+
+	for (n = 0; n < clusters; n++) {
+		if (n)
+			clust = get_fatent(mydata, clust);
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			goto err;
+		}
+
+		if (nruns && runs[nruns - 1].clust + runs[nruns - 1].count ==
+			     clust) {
+			runs[nruns - 1].count++;
+			continue;
+		}
+		if (nruns == max) {
+			max = max ? max * 2 : 16;
+			tmp = realloc(runs, max * sizeof(*runs));
+			if (!tmp) {
+				debug("Error: allocating cluster runs\n");
+				goto err;
+			}
+			runs = tmp;
+		}
+		runs[nruns].clust = clust;
+		runs[nruns].count = 1;
+		nruns++;
+	}
+
+	free(fat_runs[slot].runs);
+	fat_runs[slot].start = start;
+	fat_runs[slot].size = size;
+	fat_runs[slot].nruns = nruns;
+	fat_runs[slot].runs = runs;
+found:
+	fat_runs[slot].used = ++fat_runs_clock;
+	*nrunsp = fat_runs[slot].nruns;
+
+	return fat_runs[slot].runs;
+err:
+	free(runs);
+	return NULL;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -327,9 +496,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	loff_t off = 0, len, actsize;
+	struct fat_run *runs;
+	__u32 nruns, i = 0;
+	__u32 clust, cpos;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -344,101 +514,58 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
+	runs = get_file_runs(mydata, START(dentptr), FAT2CPU32(dentptr->size),
+			     &nruns);
+	if (!runs)
+		return -1;
 
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
+	/* the runs cover the whole file, so pos is always in one of them */
+	while (pos < filesize) {
+		/* go to the run at pos */
+		len = (loff_t)runs[i].count * bytesperclust;
+		if (pos >= off + len) {
+			off += len;
+			i++;
+			continue;
 		}
-		actsize += bytesperclust;
-	}
-
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
-
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		__u8 *tmp_buffer;
 
-		actsize = min(filesize, (loff_t)bytesperclust);
-		tmp_buffer = malloc_cache_aligned(actsize);
-		if (!tmp_buffer) {
-			debug("Error: allocating buffer\n");
-			return -1;
-		}
+		clust = runs[i].clust + div_u64_rem(pos - off, bytesperclust,
+						    &cpos);
+		if (cpos) {
+			/* read up to the beginning of the next cluster */
+			__u8 *tmp_buffer;
+
+			actsize = min(filesize - pos + cpos,
+				      (loff_t)bytesperclust);
+			tmp_buffer = malloc_cache_aligned(actsize);
+			if (!tmp_buffer) {
+				debug("Error: allocating buffer\n");
+				return -1;
+			}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
-			printf("Error reading cluster\n");
+			if (get_cluster(mydata, clust, tmp_buffer,
+					actsize) != 0) {
+				printf("Error reading cluster\n");
+				free(tmp_buffer);
+				return -1;
+			}
+			actsize -= cpos;
+			memcpy(buffer, tmp_buffer + cpos, actsize);
 			free(tmp_buffer);
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
-		free(tmp_buffer);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
+		} else {
+			/* read up to the end of the run */
+			actsize = min(filesize, off + len) - pos;
+			if (get_cluster(mydata, clust, buffer, actsize) != 0) {
+				printf("Error reading cluster\n");
 				return -1;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
 		buffer += actsize;
+		pos += actsize;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -609,6 +736,11 @@ static int get_fs_info(fsdata *mydata)
 		mydata->data_begin = mydata->rootdir_sect -
 					(mydata->clust_size * 2);
 		mydata->root_cluster = bs.root_cluster;
+		/* 0 and 0xffff both mean there is no FSInfo sector */
+		if (bs.info_sector != 0xffff)
+			mydata->fsinfo_sect = bs.info_sector;
+		else
+			mydata->fsinfo_sect = 0;
 	} else {
 		mydata->rootdir_size = ((bs.dir_entries[1]  * (int)256 +
 					 bs.dir_entries[0]) *
@@ -624,12 +756,10 @@ static int get_fs_info(fsdata *mydata)
 		 * fat_next_cluster().
 		 */
 		mydata->root_cluster = 0;
+		mydata->fsinfo_sect = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	if (fat_cache_alloc(mydata)) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -1302,6 +1432,64 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	return ret;
 }
 
+int fat_get_extents(const char *filename, loff_t *size,
+		    struct fs_extent **extp)
+{
+	unsigned int bytesperclust;
+	loff_t filesize, offset, len;
+	int count = 0, ret;
+	fsdata fsdata, *mydata = &fsdata;
+	struct fat_run *runs = NULL;
+	__u32 nruns, i;
+	fat_itr *itr;
+
+	*extp = NULL;
+	itr = malloc_cache_aligned(sizeof(fat_itr));
+	if (!itr)
+		return -ENOMEM;
+	ret = fat_itr_root(itr, &fsdata);
+	if (ret)
+		goto out_free_itr;
+
+	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	if (ret)
+		goto out_free_both;
+
+	bytesperclust = mydata->clust_size * mydata->sect_size;
+	filesize = FAT2CPU32(itr->dent->size);
+	if (filesize) {
+		runs = get_file_runs(mydata, START(itr->dent), filesize,
+				     &nruns);
+		if (!runs)
+			count = -EIO;
+	}
+
+	/* one extent per run of consecutive clusters */
+	for (i = 0, offset = 0; count >= 0 && offset < filesize; i++) {
+		len = min((loff_t)runs[i].count * bytesperclust,
+			  filesize - offset);
+		count = fs_add_extent(extp, count, offset, len,
+				      (u64)clust_to_sect(mydata,
+							 runs[i].clust) *
+				      mydata->sect_size);
+		offset += len;
+	}
+
+	if (count < 0) {
+		free(*extp);
+		*extp = NULL;
+	} else {
+		*size = filesize;
+	}
+	ret = count;
+
+out_free_both:
+	free(fsdata.fatbuf);
+out_free_itr:
+	free(itr);
+	return ret;
+}
+
 typedef struct {
 	struct fs_dir_stream parent;
 	struct fs_dirent dirent;
@@ -1377,6 +1565,8 @@ void fat_closedir(struct fs_dir_stream *dirs)
 
 void fat_close(void)
 {
+	free_cluster_map_drop();
+	fat_runs_drop();
 }
 
 int fat_uuid(char *uuid_str)
@@ -16,6 +16,7 @@
 #include <rand.h>
 #include <asm/byteorder.h>
 #include <asm/cache.h>
+#include <linux/bitmap.h>
 #include <linux/ctype.h>
 #include <linux/math64.h>
 #include "fat.c"
@@ -208,19 +209,19 @@ static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 }
 
 /*
- * Write fat buffer into block device
+ * Write a FAT cache window back into block device if it has been modified
  */
-static int flush_dirty_fat_buffer(fsdata *mydata)
+static int flush_fat_window(fsdata *mydata, int slot)
 {
 	int getsize = FATBUFBLOCKS;
 	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u8 *bufptr = mydata->fatbuf + slot * FATBUFSIZE;
+	__u32 startblock = mydata->fatbufnum[slot] * FATBUFBLOCKS;
 
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
+	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum[slot],
+	      (int)mydata->fat_dirty[slot]);
 
-	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
+	if ((!mydata->fat_dirty[slot]) || (mydata->fatbufnum[slot] == -1))
 		return 0;
 
 	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
@@ -243,7 +244,21 @@ static int flush_dirty_fat_buffer(fsdata *mydata)
 			return -1;
 		}
 	}
-	mydata->fat_dirty = 0;
+	mydata->fat_dirty[slot] = 0;
+
+	return 0;
+}
+
+/*
+ * Write all modified FAT cache windows into block device
+ */
+static int flush_dirty_fat_buffer(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FAT_CACHE_WINDOWS; i++)
+		if (flush_fat_window(mydata, i) < 0)
+			return -1;
 
 	return 0;
 }
@@ -430,6 +445,217 @@ fill_dir_slot(fat_itr *itr, const char *l_name, const char *shortname)
 	return 0;
 }
 
+/*
+ * Free-cluster map of the mounted filesystem.
+ *
+ * Rather than reading the FAT one entry at a time from the start on every
+ * allocation, the free clusters are kept in a bitmap which is filled in a
+ * batch of FAT sectors at a time, as the allocator gets to them. The search
+ * starts at the FAT32 FSInfo next-free hint, so on a mostly full filesystem
+ * usually only the tail of the FAT is read. The map is kept across write
+ * operations and dropped when the filesystem is closed or another device is
+ * selected. If there is not enough memory for it, the FAT is searched one
+ * entry at a time as before.
+ */
+#define FAT_SCAN_BLOCKS		(FATBUFBLOCKS * 8)
+
+#define FSINFO_LEAD_SIG		0x41615252
+#define FSINFO_STRUCT_SIG	0x61417272
+#define FSINFO_TRAIL_SIG	0xaa550000
+#define FSINFO_UNKNOWN		0xffffffff
+
+struct fsinfo_sector {
+	__le32	lead_sig;
+	__u8	reserved1[480];
+	__le32	struct_sig;
+	__le32	free_count;	/* free clusters, FSINFO_UNKNOWN if unknown */
+	__le32	next_free;	/* where to start looking for free clusters */
+	__u8	reserved2[12];
+	__le32	trail_sig;
+};
+
+static struct {
+	unsigned long *free;	/* bit set for each free cluster */
+	u8 *scanned;		/* set for each batch of FAT sectors read */
+	u8 *buf;		/* FAT_SCAN_BLOCKS sectors of the FAT */
+	u32 clusters;		/* FAT entries, including the reserved two */
+	u32 per_batch;		/* FAT entries in FAT_SCAN_BLOCKS sectors */
+	u32 next;		/* where to start looking for free clusters */
+	u32 nfree;		/* free clusters, FSINFO_UNKNOWN if unknown */
+	bool nomem;		/* no memory for the map, search the FAT */
+	bool fsinfo_dirty;	/* FSInfo needs updating */
+} fcm = { .nfree = FSINFO_UNKNOWN };
+
+static void free_cluster_map_drop(void)
+{
+	free(fcm.free);
+	free(fcm.scanned);
+	free(fcm.buf);
+	memset(&fcm, 0, sizeof(fcm));
+	fcm.nfree = FSINFO_UNKNOWN;
+}
+
+/*
+ * Read the FSInfo sector of a FAT32 filesystem into @buf.
+ * Return 0 if it is valid, -1 otherwise.
+ */
+static int read_fsinfo(fsdata *mydata, struct fsinfo_sector *buf)
+{
+	if (!mydata->fsinfo_sect)
+		return -1;
+	if (disk_read(mydata->fsinfo_sect, 1, buf) < 0)
+		return -1;
+	if (le32_to_cpu(buf->lead_sig) != FSINFO_LEAD_SIG ||
+	    le32_to_cpu(buf->struct_sig) != FSINFO_STRUCT_SIG ||
+	    le32_to_cpu(buf->trail_sig) != FSINFO_TRAIL_SIG)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Set up the free-cluster map, using the FSInfo hints if they are valid
+ */
+static void free_cluster_map_init(fsdata *mydata)
+{
+	u32 nbatches, nfree, next;
+	struct fsinfo_sector *fsinfo;
+
+	fcm.clusters = (mydata->total_sect - clust_to_sect(mydata, 2)) /
+		       mydata->clust_size + 2;
+	fcm.per_batch = FAT_SCAN_BLOCKS * mydata->sect_size * 8 /
+			mydata->fatsize;
+	fcm.clusters = min_t(u32, fcm.clusters, (u64)mydata->fatlength *
+			     mydata->sect_size * 8 / mydata->fatsize);
+	fcm.next = 2;
+	fcm.nfree = FSINFO_UNKNOWN;
+
+	fsinfo = malloc_cache_aligned(mydata->sect_size);
+	if (fsinfo && !read_fsinfo(mydata, fsinfo)) {
+		nfree = le32_to_cpu(fsinfo->free_count);
+		next = le32_to_cpu(fsinfo->next_free);
+		if (nfree <= fcm.clusters - 2)
+			fcm.nfree = nfree;
+		if (next >= 2 && next < fcm.clusters)
+			fcm.next = next;
+	}
+	free(fsinfo);
+
+	nbatches = DIV_ROUND_UP(fcm.clusters, fcm.per_batch);
+	fcm.free = calloc(BITS_TO_LONGS(fcm.clusters), sizeof(long));
+	fcm.scanned = calloc(nbatches, 1);
+	fcm.buf = malloc_cache_aligned(FAT_SCAN_BLOCKS * mydata->sect_size);
+	if (!fcm.free || !fcm.scanned || !fcm.buf) {
+		debug("FAT: no memory for free-cluster map\n");
+		free(fcm.free);
+		free(fcm.scanned);
+		free(fcm.buf);
+		fcm.free = NULL;
+		fcm.scanned = NULL;
+		fcm.buf = NULL;
+		fcm.nomem = true;
+	}
+}
+
+/*
+ * Read one batch of FAT sectors and note its free clusters in the map
+ */
+static int free_cluster_map_scan(fsdata *mydata, u32 batch)
+{
+	u32 sect = batch * FAT_SCAN_BLOCKS;
+	u32 nsect = min_t(u32, FAT_SCAN_BLOCKS, mydata->fatlength - sect);
+	u32 first = batch * fcm.per_batch;
+	u32 n = min(fcm.per_batch, fcm.clusters - first);
+	u32 i, val, off8;
+
+	/* the FAT buffer may hold newer entries than the media */
+	if (flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+	if (disk_read(mydata->fat_sect + sect, nsect, fcm.buf) < 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		switch (mydata->fatsize) {
+		case 32:
+			val = FAT2CPU32(((__u32 *)fcm.buf)[i]) & 0x0fffffff;
+			break;
+		case 16:
+			val = FAT2CPU16(((__u16 *)fcm.buf)[i]);
+			break;
+		default:
+			off8 = (i * 3) / 2;
+			val = fcm.buf[off8] + (fcm.buf[off8 + 1] << 8);
+			if (i & 0x1)
+				val >>= 4;
+			val &= 0xfff;
+			break;
+		}
+		if (!val && first + i >= 2)
+			__set_bit(first + i, fcm.free);
+	}
+	fcm.scanned[batch] = 1;
+
+	if (fcm.nfree == FSINFO_UNKNOWN &&
+	    !memchr(fcm.scanned, 0, DIV_ROUND_UP(fcm.clusters, fcm.per_batch)))
+		fcm.nfree = bitmap_weight(fcm.free, fcm.clusters);
+
+	return 0;
+}
+
+/*
+ * Note a change of a FAT entry in the free-cluster map. The map is set up
+ * first, so that the FSInfo count it starts from is the one on the media.
+ */
+static void free_cluster_map_set(fsdata *mydata, __u32 entry,
+				 __u32 entry_value)
+{
+	if (!fcm.clusters)
+		free_cluster_map_init(mydata);
+	if (!entry_value)
+		fcm.fsinfo_dirty = true;
+	if (!entry_value && fcm.nfree != FSINFO_UNKNOWN)
+		fcm.nfree++;
+	if (!fcm.free || entry >= fcm.clusters ||
+	    !fcm.scanned[entry / fcm.per_batch])
+		return;
+
+	if (entry_value)
+		__clear_bit(entry, fcm.free);
+	else
+		__set_bit(entry, fcm.free);
+}
+
+/*
+ * Write the free cluster count and next-free hint back to FSInfo
+ */
+static int flush_fsinfo(fsdata *mydata)
+{
+	struct fsinfo_sector *fsinfo;
+	int ret = 0;
+
+	/* nothing changed since the map was set up from FSInfo */
+	if (!fcm.clusters || !fcm.fsinfo_dirty || !mydata->fsinfo_sect)
+		return 0;
+
+	fsinfo = malloc_cache_aligned(mydata->sect_size);
+	if (!fsinfo)
+		return -1;
+
+	/* leave a broken FSInfo sector alone */
+	if (!read_fsinfo(mydata, fsinfo)) {
+		fsinfo->free_count = cpu_to_le32(fcm.nfree);
+		fsinfo->next_free = cpu_to_le32(fcm.next);
+		if (disk_write(mydata->fsinfo_sect, 1, fsinfo) < 0) {
+			debug("error: writing FSInfo sector\n");
+			ret = -1;
+		}
+	}
+	fcm.fsinfo_dirty = false;
+	free(fsinfo);
+
+	return ret;
+}
+
 /*
  * Set the entry at index 'entry' in a FAT (12/16/32) table.
  */
@@ -437,6 +663,7 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
 	__u32 bufnum, offset, off16;
 	__u16 val1, val2;
+	__u8 *fatbuf;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -456,39 +683,19 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		return -1;
 	}
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
-
-	/* Mark as dirty */
-	mydata->fat_dirty = 1;
+	fatbuf = get_fat_window(mydata, bufnum, true);
+	if (!fatbuf)
+		return -1;
+	free_cluster_map_set(mydata, entry, entry_value);
+	fat_runs_drop();
 
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
 	case 32:
-		((__u32 *) mydata->fatbuf)[offset] = cpu_to_le32(entry_value);
+		((__u32 *) fatbuf)[offset] = cpu_to_le32(entry_value);
 		break;
 	case 16:
-		((__u16 *) mydata->fatbuf)[offset] = cpu_to_le16(entry_value);
+		((__u16 *) fatbuf)[offset] = cpu_to_le16(entry_value);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
@@ -496,33 +703,33 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		switch (offset & 0x3) {
 		case 0:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff;
-			((__u16 *)mydata->fatbuf)[off16] |= val1;
+			((__u16 *)fatbuf)[off16] &= ~0xfff;
+			((__u16 *)fatbuf)[off16] |= val1;
 			break;
 		case 1:
 			val1 = cpu_to_le16(entry_value) & 0xf;
 			val2 = (cpu_to_le16(entry_value) >> 4) & 0xff;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xf000;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 12);
+			((__u16 *)fatbuf)[off16] &= ~0xf000;
+			((__u16 *)fatbuf)[off16] |= (val1 << 12);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xff;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xff;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
 			break;
 		case 2:
 			val1 = cpu_to_le16(entry_value) & 0xff;
 			val2 = (cpu_to_le16(entry_value) >> 8) & 0xf;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xff00;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 8);
+			((__u16 *)fatbuf)[off16] &= ~0xff00;
+			((__u16 *)fatbuf)[off16] |= (val1 << 8);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xf;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xf;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
 			break;
 		case 3:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff0;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 4);
+			((__u16 *)fatbuf)[off16] &= ~0xfff0;
+			((__u16 *)fatbuf)[off16] |= (val1 << 4);
 			break;
 		default:
 			break;
@@ -537,26 +744,103 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 }
 
 /*
- * Determine the next free cluster after 'entry' in a FAT (12/16/32) table
- * and link it to 'entry'. EOC marker is not set on returned entry.
+ * End-of-chain marker for the FAT type
  */
-static __u32 determine_fatent(fsdata *mydata, __u32 entry)
+static __u32 fat_eoc(fsdata *mydata)
 {
-	__u32 next_fat, next_entry = entry + 1;
+	if (mydata->fatsize == 12)
+		return 0xfff;
+	if (mydata->fatsize == 16)
+		return 0xffff;
 
-	while (1) {
-		next_fat = get_fatent(mydata, next_entry);
-		if (next_fat == 0) {
-			/* found free entry, link to entry */
-			set_fatent_value(mydata, entry, next_entry);
-			break;
+	return 0xfffffff;
+}
+
+/*
+ * Find a run of up to @want free clusters, starting at @hint if that is
+ * free, and take them out of the free-cluster map. The FAT entries of the
+ * run are left for the caller to set.
+ * Return the first cluster of the run, with its length in @countp, or 0 if
+ * the filesystem is full.
+ */
+static __u32 alloc_clusters(fsdata *mydata, __u32 hint, __u32 want,
+			    __u32 *countp)
+{
+	__u32 clust, start, end, lim, batch, n;
+	int pass;
+
+	if (!fcm.clusters)
+		free_cluster_map_init(mydata);
+	if (hint < 2 || hint >= fcm.clusters)
+		hint = fcm.next;
+
+	/* search from the hint to the end, then wrap around */
+	for (pass = 0; pass < 2; pass++) {
+		start = pass ? 2 : hint;
+		end = pass ? hint : fcm.clusters;
+
+		for (clust = start; clust < end; clust = lim) {
+			if (fcm.nomem) {
+				lim = clust + 1;
+				if (!get_fatent(mydata, clust))
+					goto found;
+				continue;
+			}
+
+			batch = clust / fcm.per_batch;
+			if (!fcm.scanned[batch] &&
+			    free_cluster_map_scan(mydata, batch))
+				return 0;
+			lim = min(end, (batch + 1) * fcm.per_batch);
+			clust = find_next_bit(fcm.free, lim, clust);
+			if (clust < lim)
+				goto found;
 		}
-		next_entry++;
 	}
-	debug("FAT%d: entry: %08x, entry_value: %04x\n",
-	       mydata->fatsize, entry, next_entry);
 
-	return next_entry;
+	return 0;
+
+found:
+	/* take the following free clusters too, up to @want */
+	for (n = 1; n < want && clust + n < fcm.clusters; n++) {
+		if (fcm.nomem)
+			break;
+		batch = (clust + n) / fcm.per_batch;
+		if (!fcm.scanned[batch] &&
+		    free_cluster_map_scan(mydata, batch))
+			break;
+		if (!test_bit(clust + n, fcm.free))
+			break;
+	}
+	if (!fcm.nomem)
+		bitmap_clear(fcm.free, clust, n);
+
+	if (fcm.nfree != FSINFO_UNKNOWN)
+		fcm.nfree -= min(fcm.nfree, n);
+	fcm.next = clust + n < fcm.clusters ? clust + n : 2;
+	fcm.fsinfo_dirty = true;
+	*countp = n;
+
+	debug("FAT%d: allocated %u clusters at 0x%08x\n", mydata->fatsize, n,
+	      clust);
+
+	return clust;
+}
+
+/*
+ * Chain the @count clusters from @clust together, and link the last one to
+ * @next (which may be an end-of-chain marker)
+ */
+static int set_fatent_run(fsdata *mydata, __u32 clust, __u32 count,
+			  __u32 next)
+{
+	__u32 i;
+
+	for (i = 1; i < count; i++)
+		if (set_fatent_value(mydata, clust + i - 1, clust + i))
+			return -1;
+
+	return set_fatent_value(mydata, clust + count - 1, next);
 }
 
 /**
@@ -794,23 +1078,6 @@ get_set_cluster(fsdata *mydata, __u32 clustnum, loff_t pos, __u8 *buffer,
 	return 0;
 }
 
-/*
- * Find the first empty cluster
- */
-static int find_empty_cluster(fsdata *mydata)
-{
-	__u32 fat_val, entry = 3;
-
-	while (1) {
-		fat_val = get_fatent(mydata, entry);
-		if (fat_val == 0)
-			break;
-		entry++;
-	}
-
-	return entry;
-}
-
 /**
  * new_dir_table() - allocate a cluster for additional directory entries
  *
@@ -823,9 +1090,15 @@ static int new_dir_table(fat_itr *itr)
 	int dir_newclust = 0;
 	int dir_oldclust = itr->clust;
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	__u32 count;
 
 	if (mydata->fatsize == 32) {
-		dir_newclust = find_empty_cluster(mydata);
+		dir_newclust = alloc_clusters(mydata, dir_oldclust + 1, 1,
+					      &count);
+		if (!dir_newclust) {
+			printf("error: no space left for directory entry\n");
+			return -1;
+		}
 	} else {
 		dir_newclust = itr->clust + 1;
 		if (dir_newclust > 1) {
@@ -895,30 +1168,6 @@ static void set_start_cluster(const fsdata *mydata, dir_entry *dentptr,
 	dentptr->start = cpu_to_le16(start_cluster & 0xffff);
 }
 
-/*
- * Check whether adding a file makes the file system to
- * exceed the size of the block device
- * Return -1 when overflow occurs, otherwise return 0
- */
-static int check_overflow(fsdata *mydata, __u32 clustnum, loff_t size)
-{
-	__u32 startsect, sect_num, offset;
-
-	if (clustnum > 0)
-		startsect = clust_to_sect(mydata, clustnum);
-	else
-		startsect = mydata->rootdir_sect;
-
-	sect_num = div_u64_rem(size, mydata->sect_size, &offset);
-
-	if (offset != 0)
-		sect_num++;
-
-	if (startsect + sect_num > total_sector)
-		return -1;
-	return 0;
-}
-
 /*
  * Write at most 'maxsize' bytes from 'buffer' into
  * the file associated with 'dentptr'
@@ -932,6 +1181,7 @@ set_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos, __u8 *buffer,
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
 	__u32 endclust = 0, newclust = 0;
+	__u32 want, count;
 	u64 cur_pos, filesize;
 	loff_t offset, actsize, wsize;
 
@@ -1049,13 +1299,7 @@ set_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos, __u8 *buffer,
 			clear_fatent(mydata, newclust);
 
 			/* Mark end of file in FAT */
-			if (mydata->fatsize == 12)
-				newclust = 0xfff;
-			else if (mydata->fatsize == 16)
-				newclust = 0xffff;
-			else if (mydata->fatsize == 32)
-				newclust = 0xfffffff;
-			set_fatent_value(mydata, endclust, newclust);
+			set_fatent_value(mydata, endclust, fat_eoc(mydata));
 		}
 
 		return 0;
@@ -1070,83 +1314,39 @@ set_clusters:
 	assert(!pos);
 
 	/* Assure that curclust is valid */
-	if (!curclust) {
-		curclust = find_empty_cluster(mydata);
-		set_start_cluster(mydata, dentptr, curclust);
-	} else {
+	if (curclust) {
 		newclust = get_fatent(mydata, curclust);
-
-		if (IS_LAST_CLUST(newclust, mydata->fatsize)) {
-			newclust = determine_fatent(mydata, curclust);
-			set_fatent_value(mydata, curclust, newclust);
-			curclust = newclust;
-		} else {
+		if (!IS_LAST_CLUST(newclust, mydata->fatsize)) {
 			debug("error: something wrong\n");
 			return -1;
 		}
 	}
 
-	/* TODO: already partially written */
-	if (check_overflow(mydata, curclust, filesize)) {
-		printf("Error: no space left: %llu\n", filesize);
-		return -1;
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = determine_fatent(mydata, endclust);
-
-			if ((newclust - 1) != endclust)
-				/* write to <curclust..endclust> */
-				goto getit;
-
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("newclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return 0;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-
-		/* set remaining bytes */
-		actsize = filesize;
-		if (set_cluster(mydata, curclust, buffer, (u32)actsize) != 0) {
-			debug("error: writing cluster\n");
+	/* take runs of free clusters, preferably right after curclust */
+	while (filesize) {
+		want = div_u64(filesize + bytesperclust - 1, bytesperclust);
+		newclust = alloc_clusters(mydata, curclust + 1, want, &count);
+		if (!newclust) {
+			printf("Error: no space left: %llu\n", filesize);
 			return -1;
 		}
-		*gotsize += actsize;
-
-		/* Mark end of file in FAT */
-		if (mydata->fatsize == 12)
-			newclust = 0xfff;
-		else if (mydata->fatsize == 16)
-			newclust = 0xffff;
-		else if (mydata->fatsize == 32)
-			newclust = 0xfffffff;
-		set_fatent_value(mydata, endclust, newclust);
+		if (set_fatent_run(mydata, newclust, count, fat_eoc(mydata)))
+			return -1;
+		if (curclust)
+			set_fatent_value(mydata, curclust, newclust);
+		else
+			set_start_cluster(mydata, dentptr, newclust);
 
-		return 0;
-getit:
-		if (set_cluster(mydata, curclust, buffer, (u32)actsize) != 0) {
+		actsize = min_t(u64, filesize, (u64)count * bytesperclust);
+		if (set_cluster(mydata, newclust, buffer, (u32)actsize) != 0) {
 			debug("error: writing cluster\n");
 			return -1;
 		}
 		*gotsize += actsize;
 		filesize -= actsize;
 		buffer += actsize;
-
-		if (CHECK_CLUST(newclust, mydata->fatsize)) {
-			debug("newclust: 0x%x\n", newclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize = bytesperclust;
-		curclust = endclust = newclust;
-	} while (1);
+		curclust = newclust + count - 1;
+	}
 
 	return 0;
 }
@@ -1428,6 +1628,8 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 
 	/* Write directory table to device */
 	ret = flush_dir(itr);
+	if (!ret && flush_fsinfo(mydata))
+		printf("Warning: cannot update FSInfo\n");
 
 exit:
 	free(filename_copy);
@@ -1445,8 +1647,7 @@ int file_fat_write(const char *filename, void *buffer, loff_t offset,
 static int fat_dir_entries(fat_itr *itr)
 {
 	fat_itr *dirs;
-	fsdata fsdata = { .fatbuf = NULL, }, *mydata = &fsdata;
-						/* for FATBUFSIZE */
+	fsdata fsdata = { .fatbuf = NULL, };
 	int count;
 
 	dirs = malloc_cache_aligned(sizeof(fat_itr));
@@ -1461,13 +1662,11 @@ static int fat_dir_entries(fat_itr *itr)
 	fsdata = *dirs->fsdata;
 
 	/* allocate local fat buffer */
-	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (!fsdata.fatbuf) {
+	if (fat_cache_alloc(&fsdata)) {
 		debug("Error: allocating memory\n");
 		count = -ENOMEM;
 		goto exit;
 	}
-	fsdata.fatbufnum = -1;
 	dirs->fsdata = &fsdata;
 
 	for (count = 0; fat_itr_next(dirs); count++)
@@ -1531,6 +1730,7 @@ static int delete_dentry_long(fat_itr *itr)
 {
 	fsdata *mydata = itr->fsdata;
 	dir_entry *dent = itr->dent;
+	int ret;
 
 	/* free cluster blocks */
 	clear_fatent(mydata, START(dent));
@@ -1540,8 +1740,6 @@ static int delete_dentry_long(fat_itr *itr)
 	}
 	/* Position to first directory entry for long name */
 	if (itr->clust != itr->dent_clust) {
-		int ret;
-
 		ret = fat_move_to_cluster(itr, itr->dent_clust);
 		if (ret)
 			return ret;
@@ -1552,15 +1750,17 @@ static int delete_dentry_long(fat_itr *itr)
 	/* Delete long name */
 	if ((dent->attr & ATTR_VFAT) == ATTR_VFAT &&
 	    (dent->nameext.name[0] & LAST_LONG_ENTRY_MASK)) {
-		int ret;
-
 		ret = delete_long_name(itr);
 		if (ret)
 			return ret;
 	}
 	/* Delete short name */
 	delete_single_dentry(itr);
-	return flush_dir(itr);
+	ret = flush_dir(itr);
+	if (!ret && flush_fsinfo(mydata))
+		printf("Warning: cannot update FSInfo\n");
+
+	return ret;
 }
 
 int fat_unlink(const char *filename)
@@ -1768,6 +1968,8 @@ int fat_mkdir(const char *dirname)
 
 	/* Write directory table to device */
 	ret = flush_dir(itr);
+	if (!ret && flush_fsinfo(mydata))
+		printf("Warning: cannot update FSInfo\n");
 
 exit:
 	free(dirname_copy);
@@ -12,11 +12,16 @@
 #include <env.h>
 #include <lmb.h>
 #include <log.h>
+#include <malloc.h>
 #include <mapmem.h>
+#include <memalign.h>
 #include <part.h>
+#include <stream.h>
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <fs_internal.h>
+#include <image.h>
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
@@ -24,6 +29,7 @@
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
+#include <linux/sizes.h>
 #include <efi_loader.h>
 #include <squashfs.h>
 
@@ -34,6 +40,20 @@ static int fs_dev_part;
 static struct disk_partition fs_partition;
 static int fs_type = FS_TYPE_ANY;
 
+/*
+ * Filesystem left mounted by fs_close(), so that the next fs_set_blk_dev()
+ * on the same partition can skip probing it again. The filesystem drivers
+ * keep their state in globals, so only one filesystem can be kept mounted.
+ */
+static struct fs_mount {
+	struct blk_desc *desc;
+	int hwpart;
+	lbaint_t start;
+	lbaint_t size;
+	int fstype;
+	bool stale;
+} fs_mounted;
+
 static inline int fs_probe_unsupported(struct blk_desc *fs_dev_desc,
 				      struct disk_partition *fs_partition)
 {
@@ -172,6 +192,9 @@ struct fstype_info {
 	int (*unlink)(const char *filename);
 	int (*mkdir)(const char *dirname);
 	int (*ln)(const char *filename, const char *target);
+	/* optional, see fs_get_extents() */
+	int (*get_extents)(const char *filename, loff_t *size,
+			   struct fs_extent **extp);
 };
 
 static struct fstype_info fstypes[] = {
@@ -200,6 +223,7 @@ static struct fstype_info fstypes[] = {
 		.readdir = fat_readdir,
 		.closedir = fat_closedir,
 		.ln = fs_ln_unsupported,
+		.get_extents = fat_get_extents,
 	},
 #endif
 
@@ -225,6 +249,7 @@ static struct fstype_info fstypes[] = {
 		.opendir = fs_opendir_unsupported,
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
+		.get_extents = ext4fs_get_extents,
 	},
 #endif
 #ifdef CONFIG_SANDBOX
@@ -282,6 +307,7 @@ static struct fstype_info fstypes[] = {
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
 		.ln = fs_ln_unsupported,
+		.get_extents = btrfs_get_extents,
 	},
 #endif
 #if IS_ENABLED(CONFIG_FS_SQUASHFS)
@@ -303,6 +329,7 @@ static struct fstype_info fstypes[] = {
 		.ln = fs_ln_unsupported,
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
+		.get_extents = sqfs_get_extents,
 	},
 #endif
 	{
@@ -364,12 +391,88 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
-int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
+static bool fs_mount_reusable(int fstype)
+{
+	if (!CONFIG_IS_ENABLED(FS_KEEP_MOUNTED) || !fs_mounted.desc ||
+	    fs_mounted.stale)
+		return false;
+
+	if (fs_mounted.desc != fs_dev_desc ||
+	    fs_mounted.hwpart != fs_dev_desc->hwpart ||
+	    fs_mounted.start != fs_partition.start ||
+	    fs_mounted.size != fs_partition.size)
+		return false;
+
+	return fstype == FS_TYPE_ANY || fstype == fs_mounted.fstype;
+}
+
+#if CONFIG_IS_ENABLED(FS_KEEP_MOUNTED)
+void fs_unmount(void)
 {
 	struct fstype_info *info;
-	int part, i;
+
+	if (!fs_mounted.desc)
+		return;
+
+	info = fs_get_info(fs_mounted.fstype);
+	fs_mounted.desc = NULL;
+	info->close();
+}
+
+void fs_invalidate_dev(struct blk_desc *desc)
+{
+	/* this may be called from within the filesystem, so just mark it */
+	if (fs_mounted.desc == desc)
+		fs_mounted.stale = true;
+}
+#endif
+
+/* probe the filesystem on fs_dev_desc / fs_partition */
+static int fs_mount(int part, int fstype)
+{
+	struct fstype_info *info;
+	int i;
+
+	if (fs_mount_reusable(fstype)) {
+		fs_type = fs_mounted.fstype;
+		fs_dev_part = part;
+		return 0;
+	}
+	fs_unmount();
+
+	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
+		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
+				fstype != info->fstype)
+			continue;
+
+		if (!fs_dev_desc && !info->null_dev_desc_ok)
+			continue;
+
+		if (!info->probe(fs_dev_desc, &fs_partition)) {
+			fs_type = info->fstype;
+			fs_dev_part = part;
+			if (CONFIG_IS_ENABLED(FS_KEEP_MOUNTED) && fs_dev_desc) {
+				fs_mounted.desc = fs_dev_desc;
+				fs_mounted.hwpart = fs_dev_desc->hwpart;
+				fs_mounted.start = fs_partition.start;
+				fs_mounted.size = fs_partition.size;
+				fs_mounted.fstype = fs_type;
+				fs_mounted.stale = false;
+			}
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
+{
+	int part;
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
+	struct fstype_info *info;
 	static int relocated;
+	int i;
 
 	if (!relocated) {
 		for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes);
@@ -390,29 +493,13 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
-	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
-		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
-				fstype != info->fstype)
-			continue;
-
-		if (!fs_dev_desc && !info->null_dev_desc_ok)
-			continue;
-
-		if (!info->probe(fs_dev_desc, &fs_partition)) {
-			fs_type = info->fstype;
-			fs_dev_part = part;
-			return 0;
-		}
-	}
-
-	return -1;
+	return fs_mount(part, fstype);
 }
 
 /* set current blk device w/ blk_desc + partition # */
 int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 {
-	struct fstype_info *info;
-	int ret, i;
+	int ret;
 
 	if (part >= 1)
 		ret = part_get_info(desc, part, &fs_partition);
@@ -422,22 +509,18 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
-	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
-		if (!info->probe(fs_dev_desc, &fs_partition)) {
-			fs_type = info->fstype;
-			fs_dev_part = part;
-			return 0;
-		}
-	}
-
-	return -1;
+	return fs_mount(part, FS_TYPE_ANY);
 }
 
 void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
-	info->close();
+	/* a kept filesystem stays mounted until the device is written */
+	if (!fs_mounted.desc)
+		info->close();
+	else if (fs_mounted.stale)
+		fs_unmount();
 
 	fs_type = FS_TYPE_ANY;
 }
@@ -523,6 +606,85 @@ static int fs_read_lmb_check(const char *filename, ulong addr, loff_t offset,
 }
 #endif
 
+int fs_get_extents(const char *filename, loff_t *size,
+		   struct fs_extent **extp)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	int ret = -ENOSYS;
+
+	*extp = NULL;
+	if (info->get_extents)
+		ret = info->get_extents(filename, size, extp);
+
+	fs_close();
+
+	return ret;
+}
+
+/*
+ * Read a file by looking up its extents and reading each of them straight
+ * into the buffer with as few large block reads as possible, rather than
+ * letting the filesystem driver read it block by block.
+ */
+static int fs_read_extents(struct fstype_info *info, const char *filename,
+			   char *buf, loff_t offset, loff_t len,
+			   loff_t *actread)
+{
+	struct fs_extent *ext = NULL;
+	loff_t size, end, done;
+	int count, i, ret = 0;
+
+	if (!info->get_extents || !fs_dev_desc)
+		return -ENOSYS;
+
+	count = info->get_extents(filename, &size, &ext);
+	if (count < 0)
+		return count;
+
+	/* let the driver report reads past the end of the file */
+	if (offset > size) {
+		ret = -ENOSYS;
+		goto out;
+	}
+	end = (len && offset + len < size) ? offset + len : size;
+
+	done = offset;
+	for (i = 0; i < count && done < end; i++) {
+		loff_t from = max(ext[i].offset, done);
+		loff_t to = min(ext[i].offset + ext[i].len, end);
+
+		if (from >= to)
+			continue;
+
+		/* hole before this extent */
+		if (from > done)
+			memset(buf + done - offset, 0, from - done);
+
+		while (from < to) {
+			u64 pos = ext[i].pos + from - ext[i].offset;
+			loff_t chunk = min(to - from, (loff_t)SZ_1G);
+
+			if (!fs_devread(fs_dev_desc, &fs_partition,
+					pos >> fs_dev_desc->log2blksz,
+					pos & (fs_dev_desc->blksz - 1), chunk,
+					buf + from - offset)) {
+				ret = -EIO;
+				goto out;
+			}
+			from += chunk;
+		}
+		done = to;
+	}
+	if (done < end)
+		memset(buf + done - offset, 0, end - done);
+
+	*actread = end - offset;
+out:
+	free(ext);
+
+	return ret;
+}
+
 static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 		    int do_lmb_check, loff_t *actread)
 {
@@ -543,7 +705,9 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	 * means read the whole file.
 	 */
 	buf = map_sysmem(addr, len);
-	ret = info->read(filename, buf, offset, len, actread);
+	ret = fs_read_extents(info, filename, buf, offset, len, actread);
+	if (ret && ret != -EIO)
+		ret = info->read(filename, buf, offset, len, actread);
 	unmap_sysmem(buf);
 
 	/* If we requested a specific number of bytes, check we got it */
@@ -560,6 +724,208 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return _fs_read(filename, addr, offset, len, 0, actread);
 }
 
+/* largest amount of data passed to a stream consumer at once */
+#define FS_STREAM_CHUNK		SZ_1M
+
+#if CONFIG_IS_ENABLED(BLK)
+/*
+ * Consumer which passes on the part of a stream of whole blocks that is
+ * covered by an extent, dropping the rest of the first and last block.
+ */
+struct fs_stream_trim {
+	struct stream_sink sink;
+	struct stream_sink *next;
+	ulong skip;
+	loff_t left;
+};
+
+static int fs_stream_trim_write(struct stream_sink *sink, const void *buf,
+				ulong len)
+{
+	struct fs_stream_trim *trim = container_of(sink, struct fs_stream_trim,
+						   sink);
+	ulong n;
+
+	n = min(trim->skip, len);
+	trim->skip -= n;
+	buf += n;
+	len -= n;
+
+	n = min_t(loff_t, trim->left, len);
+	if (!n)
+		return 0;
+	trim->left -= n;
+
+	return stream_write(trim->next, buf, n);
+}
+
+static int fs_stream_zeroes(loff_t len, struct stream_sink *sink)
+{
+	ulong chunk = min_t(loff_t, len, FS_STREAM_CHUNK);
+	void *zero;
+	int ret = 0;
+
+	zero = calloc(1, chunk);
+	if (!zero)
+		return -ENOMEM;
+
+	while (len && !ret) {
+		ulong n = min_t(loff_t, len, chunk);
+
+		ret = stream_write(sink, zero, n);
+		len -= n;
+	}
+	free(zero);
+
+	return ret;
+}
+
+/*
+ * Stream a file straight from the block device using its extents.
+ * Returns -ENOSYS, before passing anything to @sink, if the file cannot be
+ * streamed this way.
+ */
+static int fs_stream_extents(struct fstype_info *info, const char *filename,
+			     loff_t offset, loff_t len,
+			     struct stream_sink *sink, loff_t *actread)
+{
+	int log2blksz, count, i, ret = 0;
+	struct fs_extent *ext = NULL;
+	struct fs_stream_trim trim;
+	loff_t size, end, done;
+	ulong blksz;
+
+	if (!info->get_extents || !fs_dev_desc)
+		return -ENOSYS;
+
+	count = info->get_extents(filename, &size, &ext);
+	if (count < 0)
+		return -ENOSYS;
+
+	/* let the driver report reads past the end of the file */
+	if (offset > size) {
+		ret = -ENOSYS;
+		goto out;
+	}
+	end = (len && offset + len < size) ? offset + len : size;
+
+	blksz = fs_dev_desc->blksz;
+	log2blksz = fs_dev_desc->log2blksz;
+	trim.sink.write = fs_stream_trim_write;
+	trim.next = sink;
+
+	done = offset;
+	for (i = 0; i < count && done < end; i++) {
+		loff_t from = max(ext[i].offset, done);
+		loff_t to = min(ext[i].offset + ext[i].len, end);
+		lbaint_t start, blkcnt;
+		u64 pos;
+		long nread;
+
+		if (from >= to)
+			continue;
+
+		/* hole before this extent */
+		if (from > done) {
+			ret = fs_stream_zeroes(from - done, sink);
+			if (ret)
+				goto out;
+		}
+
+		pos = ext[i].pos + from - ext[i].offset;
+		start = pos >> log2blksz;
+		blkcnt = DIV_ROUND_UP((pos & (blksz - 1)) + to - from, blksz);
+		if (start + blkcnt > fs_partition.size) {
+			ret = -EIO;
+			goto out;
+		}
+
+		trim.skip = pos & (blksz - 1);
+		trim.left = to - from;
+		nread = blk_dread_stream(fs_dev_desc, fs_partition.start + start,
+					 blkcnt, FS_STREAM_CHUNK / blksz,
+					 &trim.sink);
+		if (nread != blkcnt) {
+			ret = nread < 0 ? nread : -EIO;
+			goto out;
+		}
+		done = to;
+	}
+	if (done < end) {
+		ret = fs_stream_zeroes(end - done, sink);
+		if (ret)
+			goto out;
+	}
+
+	*actread = end - offset;
+out:
+	free(ext);
+
+	return ret;
+}
+#else
+static int fs_stream_extents(struct fstype_info *info, const char *filename,
+			     loff_t offset, loff_t len,
+			     struct stream_sink *sink, loff_t *actread)
+{
+	return -ENOSYS;
+}
+#endif
+
+/* Stream a file by reading it through the driver a chunk at a time */
+static int fs_stream_read(struct fstype_info *info, const char *filename,
+			  loff_t offset, loff_t len, struct stream_sink *sink,
+			  loff_t *actread)
+{
+	loff_t size, end, pos, nread;
+	void *buf;
+	int ret;
+
+	ret = info->size(filename, &size);
+	if (ret)
+		return ret;
+	if (offset > size)
+		return -EINVAL;
+	end = (len && offset + len < size) ? offset + len : size;
+
+	buf = malloc_cache_aligned(FS_STREAM_CHUNK);
+	if (!buf)
+		return -ENOMEM;
+
+	for (pos = offset; pos < end; pos += nread) {
+		loff_t n = min_t(loff_t, end - pos, FS_STREAM_CHUNK);
+
+		ret = info->read(filename, buf, pos, n, &nread);
+		if (!ret && nread != n)
+			ret = -EIO;
+		if (!ret)
+			ret = stream_write(sink, buf, nread);
+		if (ret)
+			break;
+	}
+	free(buf);
+	if (!ret)
+		*actread = end - offset;
+
+	return ret;
+}
+
+int fs_read_stream(const char *filename, loff_t offset, loff_t len,
+		   struct stream_sink *sink, loff_t *actread)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	int ret;
+
+	*actread = 0;
+	ret = fs_stream_extents(info, filename, offset, len, sink, actread);
+	if (ret == -ENOSYS)
+		ret = fs_stream_read(info, filename, offset, len, sink,
+				     actread);
+	fs_close();
+
+	return ret;
+}
+
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
 {
@@ -772,6 +1138,87 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	return 0;
 }
 
+#ifdef CONFIG_CMD_ZLOAD
+int do_zload(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
+	     int fstype)
+{
+	struct image_decomp_stream ids;
+	struct lmb lmb;
+	const char *filename;
+	ulong addr, max, size, time;
+	loff_t len_read;
+	int comp, ret, ret2;
+
+	if (argc < 2 || argc > 5)
+		return CMD_RET_USAGE;
+
+	if (argc >= 4)
+		addr = hextoul(argv[3], NULL);
+	else
+		addr = env_get_hex("loadaddr", CONFIG_SYS_LOAD_ADDR);
+	filename = argc >= 5 ? argv[4] : env_get("bootfile");
+	if (!filename) {
+		puts("** No boot file defined **\n");
+		return 1;
+	}
+
+	/*
+	 * The output may use all the free memory at the load address. This
+	 * only bounds the output: the decompressors size their buffers from
+	 * the data itself.
+	 */
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+	max = lmb_get_free_size(&lmb, addr);
+	if (!max) {
+		log_err("** Load address is in reserved memory **\n");
+		return 1;
+	}
+
+	/* the first bytes tell us the compression type */
+	if (fs_set_blk_dev(argv[1], (argc >= 3) ? argv[2] : NULL, fstype)) {
+		log_err("Can't set block device\n");
+		return 1;
+	}
+	ret = fs_read(filename, addr, 0, 2, &len_read);
+	if (ret < 0 || len_read < 2) {
+		log_err("Failed to load '%s'\n", filename);
+		return 1;
+	}
+	comp = image_decomp_type(map_sysmem(addr, 2), 2);
+
+	ret = image_decomp_stream_init(&ids, comp, map_sysmem(addr, max), max);
+	if (ret) {
+		log_err("Can't decompress '%s' (%s): %d\n", filename,
+			genimg_get_comp_name(comp), ret);
+		return 1;
+	}
+
+	time = get_timer(0);
+	ret = fs_set_blk_dev(argv[1], (argc >= 3) ? argv[2] : NULL, fstype);
+	if (!ret)
+		ret = fs_read_stream(filename, 0, 0, ids.sink, &len_read);
+	ret2 = image_decomp_stream_finish(&ids, &size);
+	time = get_timer(time);
+	if (!ret)
+		ret = ret2;
+	if (ret == -ENOSPC) {
+		log_err("** Uncompressed file would overwrite reserved memory **\n");
+		return 1;
+	} else if (ret) {
+		log_err("Failed to load '%s': %d\n", filename, ret);
+		return 1;
+	}
+
+	printf("%llu bytes read, %lu bytes uncompressed in %lu ms\n",
+	       len_read, size, time);
+
+	env_set_hex("fileaddr", addr);
+	env_set_hex("filesize", size);
+
+	return 0;
+}
+#endif
+
 int do_ls(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	  int fstype)
 {
@@ -10,10 +10,49 @@
 #include <common.h>
 #include <blk.h>
 #include <compiler.h>
+#include <fs.h>
+#include <fs_internal.h>
 #include <log.h>
+#include <malloc.h>
 #include <part.h>
 #include <memalign.h>
 
+#if CONFIG_IS_ENABLED(BLK)
+/*
+ * Read @byte_len bytes from @byte_offset within sector @start into @buf,
+ * with a single vectored read. @sec_buf is a sector-sized scratch buffer.
+ */
+static int fs_devread_segs(struct blk_desc *blk, lbaint_t start,
+			   int byte_offset, int byte_len, char *buf,
+			   char *sec_buf)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(char, tail_buf, blk->blksz);
+	lbaint_t cnt = DIV_ROUND_UP(byte_offset + byte_len, blk->blksz);
+	struct blk_seg segs[3];
+	int nsegs = 0;
+	ulong tail;
+
+	tail = cnt * blk->blksz - byte_offset - byte_len;
+	if (byte_offset) {
+		segs[nsegs].buffer = sec_buf;
+		segs[nsegs++].len = byte_offset;
+	}
+	segs[nsegs].buffer = buf;
+	segs[nsegs++].len = byte_len;
+	if (tail) {
+		segs[nsegs].buffer = tail_buf;
+		segs[nsegs++].len = tail;
+	}
+
+	if (blk_dreadv(blk, start, cnt, segs, nsegs) != cnt) {
+		log_err(" ** %s read error **\n", __func__);
+		return 0;
+	}
+
+	return 1;
+}
+#endif
+
 int fs_devread(struct blk_desc *blk, struct disk_partition *partition,
 	       lbaint_t sector, int byte_offset, int byte_len, char *buf)
 {
@@ -40,6 +79,19 @@ int fs_devread(struct blk_desc *blk, struct disk_partition *partition,
 
 	log_debug(" <" LBAFU ", %d, %d>\n", sector, byte_offset, byte_len);
 
+#if CONFIG_IS_ENABLED(BLK)
+	/*
+	 * Read a partial first or last sector in the same command as the
+	 * whole sectors in between, discarding the bytes around the wanted
+	 * ones. Reads within a sector or two, e.g. of metadata, are left to
+	 * blk_dread(), which can serve them from the block cache.
+	 */
+	if ((byte_offset || byte_len & (blk->blksz - 1)) &&
+	    (byte_offset + byte_len) / blk->blksz > !!byte_offset)
+		return fs_devread_segs(blk, partition->start + sector,
+				       byte_offset, byte_len, buf, sec_buf);
+#endif
+
 	if (byte_offset != 0) {
 		int readlen;
 		/* read first part which isn't aligned with start of sector */
@@ -94,3 +146,33 @@ int fs_devread(struct blk_desc *blk, struct disk_partition *partition,
 	}
 	return 1;
 }
+
+int fs_add_extent(struct fs_extent **extp, int count, loff_t offset,
+		  loff_t len, u64 pos)
+{
+	struct fs_extent *ext = *extp;
+
+	if (count) {
+		struct fs_extent *last = &ext[count - 1];
+
+		if (last->offset + last->len == offset &&
+		    last->pos + last->len == pos) {
+			last->len += len;
+			return count;
+		}
+	}
+
+	/* grow the list in powers of two, starting with 8 entries */
+	if (count >= 8 ? !(count & (count - 1)) : !count) {
+		ext = realloc(ext, max(count * 2, 8) * sizeof(*ext));
+		if (!ext)
+			return -ENOMEM;
+		*extp = ext;
+	}
+
+	ext[count].offset = offset;
+	ext[count].len = len;
+	ext[count].pos = pos;
+
+	return count + 1;
+}
@@ -495,6 +495,45 @@ static inline void put_fl_mem(void *buf, void *ext_buf)
 	}
 }
 
+/*
+ * Check whether the flash may have changed since the last call, dropping
+ * any cached flash data if so.
+ *
+ * NAND and OneNAND are only ever written through the MTD layer, so
+ * comparing mtd_write_count() is enough there. Anything else counts as
+ * possibly changed.
+ */
+static int flash_written(struct b_lists *pL)
+{
+	struct mtdids *id = current_part->dev->id;
+
+	switch (id->type) {
+#if defined(CONFIG_JFFS2_NAND) && defined(CONFIG_CMD_NAND)
+	case MTD_DEV_TYPE_NAND: {
+		unsigned long writes = mtd_write_count();
+
+		if (writes == pL->mtd_writes)
+			return 0;
+		pL->mtd_writes = writes;
+		nand_cache_off = (u32)-1;
+		return 1;
+	}
+#endif
+#if defined(CONFIG_CMD_ONENAND)
+	case MTD_DEV_TYPE_ONENAND: {
+		unsigned long writes = mtd_write_count();
+
+		if (writes == pL->mtd_writes)
+			return 0;
+		pL->mtd_writes = writes;
+		onenand_cache_off = (u32)-1;
+		return 1;
+	}
+#endif
+	}
+	return 1;
+}
+
 /* Compression names */
 static char *compr_names[] = {
 	"NONE",
@@ -745,6 +784,16 @@ jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 #endif
 
 			if(dest) {
+				/*
+				 * Ignore data behind latest known EOF and
+				 * nodes already known to be bad, without
+				 * reading their data from flash.
+				 */
+				if (jNode->offset > totalSize ||
+				    b->datacrc == CRC_BAD) {
+					put_fl_mem(jNode, pL->readbuf);
+					continue;
+				}
 				/*
 				 * Now that the inode has been checked,
 				 * read the entire inode, including data.
@@ -754,11 +803,6 @@ jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 					get_node_mem(b->offset, pL->readbuf);
 				src = ((uchar *)jNode) +
 					sizeof(struct jffs2_raw_inode);
-				/* ignore data behind latest known EOF */
-				if (jNode->offset > totalSize) {
-					put_fl_mem(jNode, pL->readbuf);
-					continue;
-				}
 				if (b->datacrc == CRC_UNKNOWN)
 					b->datacrc = data_crc(jNode) ?
 						CRC_OK : CRC_BAD;
@@ -1219,6 +1263,10 @@ jffs2_1pass_rescan_needed(struct part_info *part)
 		return 1;
 	}
 
+	/* nothing can have changed if the flash has not been written */
+	if (!flash_written(pL))
+		return 0;
+
 	/* but suppose someone reflashed a partition at the same offset... */
 	b = pL->dir.listHead;
 	while (b) {
@@ -1501,6 +1549,7 @@ jffs2_1pass_build_lists(struct part_info * part)
 	/* if we are building a list we need to refresh the cache. */
 	jffs_init_1pass_list(part);
 	pL = (struct b_lists *)part->jffs2_priv;
+	flash_written(pL);
 	buf = malloc(DEFAULT_EMPTY_SCAN_SIZE);
 	puts ("Scanning JFFS2 FS:   ");
 
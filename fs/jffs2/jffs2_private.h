@@ -31,6 +31,7 @@ struct b_lists {
 	struct b_list dir;
 	struct b_list frag;
 	void *readbuf;
+	unsigned long mtd_writes;	/* mtd_write_count() at last check */
 };
 
 struct b_compr_info {
@@ -10,9 +10,11 @@
 #include <asm/unaligned.h>
 #include <errno.h>
 #include <fs.h>
+#include <fs_internal.h>
 #include <linux/types.h>
 #include <linux/byteorder/little_endian.h>
 #include <linux/byteorder/generic.h>
+#include <linux/sizes.h>
 #include <memalign.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,6 +25,9 @@
 #include "sqfs_filesystem.h"
 #include "sqfs_utils.h"
 
+/* Data blocks are read from the disk in chunks of up to this many bytes */
+#define SQFS_READ_CHUNK		SZ_1M
+
 static struct squashfs_ctxt ctxt;
 
 static int sqfs_disk_read(__u32 block, __u32 nr_blocks, void *buf)
@@ -92,62 +97,78 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 	return DIV_ROUND_UP(table_size + *offset, ctxt.cur_dev->blksz);
 }
 
-/*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
- */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+/* Reads the fragment index table, which points to the fragment entry blocks */
+static int sqfs_read_frag_index(void)
 {
-	u64 start, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
-
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
-
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	u64 start, n_blks, table_offset, end;
+	unsigned char *table;
+	u32 count;
+	int i;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  sblk->export_table_start,
+	count = DIV_ROUND_UP(get_unaligned_le32(&sblk->fragments),
+			     SQFS_MAX_ENTRIES);
+	start = get_unaligned_le64(&sblk->fragment_table_start);
+	end = start + count * sizeof(u64);
+	n_blks = sqfs_calc_n_blks(cpu_to_le64(start), cpu_to_le64(end),
 				  &table_offset);
+	start /= ctxt.cur_dev->blksz;
 
-	/* Allocate a proper sized buffer to store the fragment index table */
 	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!table)
+		return -ENOMEM;
 
 	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
+		free(table);
+		return -EINVAL;
 	}
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+	ctxt.frag_index = malloc(count * sizeof(u64));
+	ctxt.frag_entries = calloc(count, sizeof(*ctxt.frag_entries));
+	if (!ctxt.frag_index || !ctxt.frag_entries) {
+		free(ctxt.frag_index);
+		free(ctxt.frag_entries);
+		ctxt.frag_index = NULL;
+		ctxt.frag_entries = NULL;
+		free(table);
+		return -ENOMEM;
+	}
 
-	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
-	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+	for (i = 0; i < count; i++)
+		ctxt.frag_index[i] = get_unaligned_le64(table + table_offset +
+							i * sizeof(u64));
+	free(table);
+
+	return 0;
+}
+
+/* Reads and decompresses the metadata block holding fragment entries @block */
+static int sqfs_read_frag_entries(int block)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start, n_blks, table_offset, start_block, end;
+	struct squashfs_fragment_block_entry *entries;
+	unsigned char *metadata_buffer;
+	unsigned long dest_len;
+	u32 src_len;
+	bool comp;
+	int ret;
+
+	/* A metadata block never extends past the fragment index table */
+	start_block = ctxt.frag_index[block];
+	end = min_t(u64, start_block + SQFS_HEADER_SIZE +
+		    SQFS_METADATA_BLOCK_SIZE,
+		    get_unaligned_le64(&sblk->fragment_table_start));
+	if (start_block >= end)
+		return -EINVAL;
 
 	start = start_block / ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
-				  sblk->fragment_table_start, &table_offset);
+	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block), cpu_to_le64(end),
+				  &table_offset);
 
 	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
+	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
+	if (!metadata_buffer || !entries) {
 		ret = -ENOMEM;
 		goto out;
 	}
@@ -158,40 +179,159 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	}
 
 	/* Every metadata block starts with a 16-bit header */
-	header = get_unaligned_le16(metadata_buffer + table_offset);
-	metadata = metadata_buffer + table_offset + SQFS_HEADER_SIZE;
-
-	if (!metadata || !header) {
-		ret = -ENOMEM;
-		goto out;
-	}
-
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
-		ret = -ENOMEM;
+	ret = sqfs_read_metablock(metadata_buffer, table_offset, &comp,
+				  &src_len);
+	if (ret || src_len > end - start_block - SQFS_HEADER_SIZE) {
+		ret = -EINVAL;
 		goto out;
 	}
 
-	if (SQFS_COMPRESSED_METADATA(header)) {
-		src_len = SQFS_METADATA_SIZE(header);
+	if (comp) {
 		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
-				      src_len);
+		ret = sqfs_decompress(&ctxt, entries, &dest_len,
+				      metadata_buffer + table_offset +
+				      SQFS_HEADER_SIZE, src_len);
 		if (ret) {
 			ret = -EINVAL;
 			goto out;
 		}
 	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
+		memcpy(entries, metadata_buffer + table_offset +
+		       SQFS_HEADER_SIZE, src_len);
 	}
 
-	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
+	ctxt.frag_entries[block] = entries;
+	entries = NULL;
 
 out:
 	free(entries);
 	free(metadata_buffer);
-	free(table);
+
+	return ret;
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed. The fragment table is read on first use and kept until the
+ * filesystem is closed.
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	int block, offset, ret;
+
+	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+		return -EINVAL;
+
+	if (!ctxt.frag_index) {
+		ret = sqfs_read_frag_index();
+		if (ret)
+			return ret;
+	}
+
+	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+
+	if (!ctxt.frag_entries[block]) {
+		ret = sqfs_read_frag_entries(block);
+		if (ret)
+			return ret;
+	}
+
+	*e = ctxt.frag_entries[block][offset];
+
+	return SQFS_COMPRESSED_BLOCK(e->size);
+}
+
+/*
+ * Reads the @len bytes found at byte @start of the filesystem into a newly
+ * allocated buffer @bufp, which the caller must free. @datap points to the
+ * data within it.
+ */
+static int sqfs_read_span(u64 start, u64 len, unsigned char **bufp,
+			  unsigned char **datap)
+{
+	u64 blk, n_blks, offset;
+
+	blk = start / ctxt.cur_dev->blksz;
+	offset = start - blk * ctxt.cur_dev->blksz;
+	n_blks = DIV_ROUND_UP(len + offset, ctxt.cur_dev->blksz);
+
+	*bufp = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!*bufp)
+		return -ENOMEM;
+
+	if (sqfs_disk_read(blk, n_blks, *bufp) < 0) {
+		free(*bufp);
+		*bufp = NULL;
+		return -EIO;
+	}
+	*datap = *bufp + offset;
+
+	return 0;
+}
+
+/*
+ * Returns the decompressed data or fragment block stored at @start on disk,
+ * whose on-disk size (including the "uncompressed" flag) is @size. Blocks are
+ * kept in a small cache, the least recently used one being replaced; the
+ * returned data is only valid until the next call.
+ */
+static int sqfs_cache_get(u64 start, u32 size, unsigned char **data,
+			  unsigned long *len)
+{
+	u32 block_size = get_unaligned_le32(&ctxt.sblk->block_size);
+	struct squashfs_cache_entry *e, *victim = NULL;
+	u32 src_len = SQFS_BLOCK_SIZE(size);
+	unsigned char *buf, *src;
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(ctxt.cache); i++) {
+		e = &ctxt.cache[i];
+		if (e->len && e->start == start) {
+			e->stamp = ++ctxt.cache_stamp;
+			*data = e->data;
+			*len = e->len;
+			return 0;
+		}
+		if (!victim || (victim->len && (!e->len ||
+						e->stamp < victim->stamp)))
+			victim = e;
+	}
+
+	if (!src_len || src_len > block_size)
+		return -EINVAL;
+
+	if (!victim->data) {
+		victim->data = malloc(block_size);
+		if (!victim->data)
+			return -ENOMEM;
+	}
+	victim->len = 0;
+
+	ret = sqfs_read_span(start, src_len, &buf, &src);
+	if (ret)
+		return ret;
+
+	if (SQFS_COMPRESSED_BLOCK(size)) {
+		*len = block_size;
+		ret = sqfs_decompress(&ctxt, victim->data, len, src, src_len);
+		if (ret)
+			goto out;
+	} else {
+		memcpy(victim->data, src, src_len);
+		*len = src_len;
+	}
+
+	victim->start = start;
+	victim->len = *len;
+	victim->stamp = ++ctxt.cache_stamp;
+	*data = victim->data;
+	ret = 0;
+
+out:
+	free(buf);
 
 	return ret;
 }
@@ -868,13 +1008,57 @@ out:
 	return metablks_count;
 }
 
+/* Drops a reference to the decompressed tables, freeing them with the last */
+static void sqfs_put_tables(struct squashfs_tables *tables)
+{
+	if (!tables || --tables->refcount)
+		return;
+
+	free(tables->inode_table);
+	free(tables->dir_table);
+	free(tables->dir_pos);
+	free(tables);
+}
+
+/*
+ * Returns a reference to the decompressed inode and directory tables, reading
+ * them on first use after the filesystem was probed.
+ */
+static struct squashfs_tables *sqfs_get_tables(void)
+{
+	struct squashfs_tables *tables = ctxt.tables;
+
+	if (!tables) {
+		tables = calloc(1, sizeof(*tables));
+		if (!tables)
+			return NULL;
+		tables->refcount = 1;
+
+		if (sqfs_read_inode_table(&tables->inode_table)) {
+			sqfs_put_tables(tables);
+			return NULL;
+		}
+
+		tables->dir_metablks =
+			sqfs_read_directory_table(&tables->dir_table,
+						  &tables->dir_pos);
+		if (tables->dir_metablks < 1) {
+			sqfs_put_tables(tables);
+			return NULL;
+		}
+		ctxt.tables = tables;
+	}
+	tables->refcount++;
+
+	return tables;
+}
+
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
-	int j, token_count = 0, ret = 0, metablks_count;
+	int j, token_count = 0, ret = 0;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
+	struct squashfs_tables *tables;
 
 	dirs = calloc(1, sizeof(*dirs));
 	if (!dirs)
@@ -887,17 +1071,12 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
+	tables = sqfs_get_tables();
+	if (!tables) {
 		ret = -EINVAL;
 		goto out;
 	}
+	dirs->tables = tables;
 
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
@@ -926,10 +1105,10 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	 * ldir's (extended directory) size is greater than dir, so it works as
 	 * a general solution for the malloc size, since 'i' is a union.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
-			      metablks_count);
+	dirs->inode_table = tables->inode_table;
+	dirs->dir_table = tables->dir_table;
+	ret = sqfs_search_dir(dirs, token_list, token_count, tables->dir_pos,
+			      tables->dir_metablks);
 	if (ret)
 		goto out;
 
@@ -953,10 +1132,9 @@ out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
 	free(path);
 	if (ret) {
-		free(inode_table);
+		sqfs_put_tables(dirs->tables);
 		free(dirs);
 	}
 
@@ -1076,11 +1254,41 @@ int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 	return 0;
 }
 
+/* Drops everything read since the filesystem was probed */
+static void sqfs_cache_free(void)
+{
+	int i, count;
+
+	if (ctxt.frag_entries) {
+		count = DIV_ROUND_UP(get_unaligned_le32(&ctxt.sblk->fragments),
+				     SQFS_MAX_ENTRIES);
+		for (i = 0; i < count; i++)
+			free(ctxt.frag_entries[i]);
+	}
+	free(ctxt.frag_entries);
+	free(ctxt.frag_index);
+	ctxt.frag_entries = NULL;
+	ctxt.frag_index = NULL;
+
+	for (i = 0; i < ARRAY_SIZE(ctxt.cache); i++) {
+		free(ctxt.cache[i].data);
+		ctxt.cache[i].data = NULL;
+		ctxt.cache[i].len = 0;
+	}
+
+	sqfs_put_tables(ctxt.tables);
+	ctxt.tables = NULL;
+}
+
 int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition)
 {
 	struct squashfs_super_block *sblk;
 	int ret;
 
+	/* anything cached belongs to the previous filesystem */
+	if (ctxt.sblk)
+		sqfs_cache_free();
+
 	ctxt.cur_dev = fs_dev_desc;
 	ctxt.cur_part_info = *fs_partition;
 
@@ -1305,36 +1513,27 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 	return datablk_count;
 }
 
-int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
-	      loff_t *actread)
+/*
+ * Look up a regular file, following symbolic links, and fill in @finfo and
+ * @frag_entry. Returns the number of data blocks of the file, in which case
+ * finfo->blk_sizes must be freed by the caller, or a negative error code.
+ */
+static int sqfs_get_file_info(const char *filename,
+			      struct squashfs_file_info *finfo,
+			      struct squashfs_fragment_block_entry *frag_entry)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL, *data_buffer = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
-	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
-	int ret, j, i_number, datablk_count = 0;
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	struct squashfs_fragment_block_entry frag_entry;
-	struct squashfs_file_info finfo = {0};
 	struct squashfs_symlink_inode *symlink;
 	struct fs_dir_stream *dirsp = NULL;
 	struct squashfs_dir_stream *dirs;
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_base_inode *base;
 	struct squashfs_reg_inode *reg;
-	unsigned long dest_len;
+	char *dir = NULL, *file = NULL, *resolved;
+	int ret, i_number, datablk_count;
 	struct fs_dirent *dent;
 	unsigned char *ipos;
 
-	*actread = 0;
-
-	if (offset) {
-		/*
-		 * TODO: implement reading at an offset in file
-		 */
-		printf("Error: reading at a specific offset in a squashfs file is not supported yet.\n");
-		return -EINVAL;
-	}
-
 	/*
 	 * sqfs_opendir will uncompress inode and directory tables, and will
 	 * return a pointer to the directory that contains the requested file.
@@ -1358,8 +1557,6 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	}
 
 	if (ret) {
-		printf("File not found.\n");
-		*actread = 0;
 		ret = -ENOENT;
 		goto out;
 	}
@@ -1372,36 +1569,38 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	switch (get_unaligned_le16(&base->inode_type)) {
 	case SQFS_REG_TYPE:
 		reg = (struct squashfs_reg_inode *)ipos;
-		datablk_count = sqfs_get_regfile_info(reg, &finfo, &frag_entry,
+		datablk_count = sqfs_get_regfile_info(reg, finfo, frag_entry,
 						      sblk->block_size);
 		if (datablk_count < 0) {
 			ret = -EINVAL;
 			goto out;
 		}
 
-		memcpy(finfo.blk_sizes, ipos + sizeof(*reg),
+		memcpy(finfo->blk_sizes, ipos + sizeof(*reg),
 		       datablk_count * sizeof(u32));
+		ret = datablk_count;
 		break;
 	case SQFS_LREG_TYPE:
 		lreg = (struct squashfs_lreg_inode *)ipos;
-		datablk_count = sqfs_get_lregfile_info(lreg, &finfo,
-						       &frag_entry,
+		datablk_count = sqfs_get_lregfile_info(lreg, finfo,
+						       frag_entry,
 						       sblk->block_size);
 		if (datablk_count < 0) {
 			ret = -EINVAL;
 			goto out;
 		}
 
-		memcpy(finfo.blk_sizes, ipos + sizeof(*lreg),
+		memcpy(finfo->blk_sizes, ipos + sizeof(*lreg),
 		       datablk_count * sizeof(u32));
+		ret = datablk_count;
 		break;
 	case SQFS_SYMLINK_TYPE:
 	case SQFS_LSYMLINK_TYPE:
 		symlink = (struct squashfs_symlink_inode *)ipos;
 		resolved = sqfs_resolve_symlink(symlink, filename);
-		ret = sqfs_read(resolved, buf, offset, len, actread);
+		ret = sqfs_get_file_info(resolved, finfo, frag_entry);
 		free(resolved);
-		goto out;
+		break;
 	case SQFS_BLKDEV_TYPE:
 	case SQFS_CHRDEV_TYPE:
 	case SQFS_LBLKDEV_TYPE:
@@ -1413,162 +1612,256 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	default:
 		printf("Unsupported entry type\n");
 		ret = -EINVAL;
-		goto out;
+		break;
 	}
 
-	/* If the user specifies a length, check its sanity */
-	if (len) {
-		if (len > finfo.size) {
-			ret = -EINVAL;
-			goto out;
-		}
+out:
+	free(file);
+	free(dir);
+	sqfs_closedir(dirsp);
 
-		finfo.size = len;
-	} else {
-		len = finfo.size;
-	}
+	return ret;
+}
 
-	if (datablk_count) {
-		data_offset = finfo.start;
-		datablock = malloc(get_unaligned_le32(&sblk->block_size));
-		if (!datablock) {
-			ret = -ENOMEM;
-			goto out;
-		}
+/*
+ * Returns where on disk the data of the blocks from @first onwards ends,
+ * taking as many blocks as fit in SQFS_READ_CHUNK bytes and are needed for
+ * the file data up to byte @len. @start is where block @first starts.
+ */
+static u64 sqfs_chunk_end(struct squashfs_file_info *finfo, int first,
+			  int count, u64 start, u64 len)
+{
+	u32 block_size = get_unaligned_le32(&ctxt.sblk->block_size);
+	u64 end = start, size;
+	int k;
+
+	for (k = first; k < count; k++) {
+		size = SQFS_BLOCK_SIZE(finfo->blk_sizes[k]);
+		if (k > first && (end + size - start > SQFS_READ_CHUNK ||
+				  (u64)k * block_size >= len))
+			break;
+		end += size;
 	}
 
-	for (j = 0; j < datablk_count; j++) {
-		start = data_offset / ctxt.cur_dev->blksz;
-		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
-		table_offset = data_offset - (start * ctxt.cur_dev->blksz);
-		n_blks = DIV_ROUND_UP(table_size + table_offset,
-				      ctxt.cur_dev->blksz);
+	return end;
+}
 
-		/* Don't load any data for sparse blocks */
-		if (finfo.blk_sizes[j] == 0) {
-			n_blks = 0;
-			table_offset = 0;
-			data_buffer = NULL;
-			data = NULL;
-		} else {
-			data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	      loff_t *actread)
+{
+	u64 table_size, data_offset, out_len, file_size, pos, from, to;
+	u64 chunk_start = 0, chunk_end = 0, end;
+	int ret, j, datablk_count = 0;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u32 block_size = get_unaligned_le32(&sblk->block_size);
+	struct squashfs_fragment_block_entry frag_entry;
+	struct squashfs_file_info finfo = {0};
+	unsigned char *data, *chunk = NULL, *chunk_data = NULL;
+	unsigned long dest_len;
 
-			if (!data_buffer) {
-				ret = -ENOMEM;
-				goto out;
-			}
+	*actread = 0;
 
-			ret = sqfs_disk_read(start, n_blks, data_buffer);
-			if (ret < 0) {
-				/*
-				 * Possible causes: too many data blocks or too large
-				 * SquashFS block size. Tip: re-compile the SquashFS
-				 * image with mksquashfs's -b <block_size> option.
-				 */
-				printf("Error: too many data blocks to be read.\n");
-				goto out;
-			}
+	ret = sqfs_get_file_info(filename, &finfo, &frag_entry);
+	if (ret < 0) {
+		if (ret == -ENOENT)
+			printf("File not found.\n");
+		goto out;
+	}
+	datablk_count = ret;
+	file_size = finfo.size;
 
-			data = data_buffer + table_offset;
+	/* If the user specifies an offset or a length, check their sanity */
+	if (offset > file_size || len > file_size - offset) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (!len)
+		len = file_size - offset;
+	end = offset + len;
+
+	data_offset = finfo.start;
+	for (j = 0; j < datablk_count; j++) {
+		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
+		if (table_size > block_size) {
+			ret = -EINVAL;
+			goto out;
 		}
+		pos = (u64)j * block_size;
+		if (pos >= end)
+			break;
+
+		/* Size of the block once decompressed */
+		out_len = min_t(u64, block_size, file_size - pos);
+		if (pos + out_len <= offset) {
+			/* The block ends before the requested data */
+			data_offset += table_size;
+			continue;
+		}
+
+		/* Part of the block which is wanted */
+		from = max_t(u64, pos, offset);
+		to = min_t(u64, pos + out_len, end);
 
 		/* Load the data */
 		if (finfo.blk_sizes[j] == 0) {
 			/* This is a sparse block */
-			sparse_size = get_unaligned_le32(&sblk->block_size);
-			if ((*actread + sparse_size) > len)
-				sparse_size = len - *actread;
-			memset(buf + *actread, 0, sparse_size);
-			*actread += sparse_size;
-		} else if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
-			dest_len = get_unaligned_le32(&sblk->block_size);
-			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
-					      data, table_size);
+			memset(buf + from - offset, 0, to - from);
+		} else if (from != pos || to != pos + out_len) {
+			/* Only part of the first or the last block is wanted */
+			ret = sqfs_cache_get(data_offset, finfo.blk_sizes[j],
+					     &data, &dest_len);
 			if (ret)
 				goto out;
 
-			if ((*actread + dest_len) > len)
-				dest_len = len - *actread;
-			memcpy(buf + *actread, datablock, dest_len);
-			*actread += dest_len;
+			if (dest_len != out_len) {
+				ret = -EINVAL;
+				goto out;
+			}
+			memcpy(buf + from - offset, data + from - pos,
+			       to - from);
 		} else {
-			if ((*actread + table_size) > len)
-				table_size = len - *actread;
-			memcpy(buf + *actread, data, table_size);
-			*actread += table_size;
+			/*
+			 * Whole blocks go straight to the destination. Their
+			 * on-disk data is contiguous, so read as many of them
+			 * as fit in one chunk at once.
+			 */
+			if (data_offset + table_size > chunk_end) {
+				chunk_end = sqfs_chunk_end(&finfo, j,
+							   datablk_count,
+							   data_offset, end);
+				free(chunk);
+				ret = sqfs_read_span(data_offset,
+						     chunk_end - data_offset,
+						     &chunk, &chunk_data);
+				if (ret)
+					goto out;
+				chunk_start = data_offset;
+			}
+
+			data = chunk_data + (data_offset - chunk_start);
+			if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
+				dest_len = out_len;
+				ret = sqfs_decompress(&ctxt,
+						      buf + pos - offset,
+						      &dest_len, data,
+						      table_size);
+				if (ret)
+					goto out;
+			} else {
+				if (table_size != out_len) {
+					ret = -EINVAL;
+					goto out;
+				}
+				dest_len = table_size;
+				memcpy(buf + pos - offset, data, table_size);
+			}
+
+			if (dest_len != out_len) {
+				ret = -EINVAL;
+				goto out;
+			}
 		}
 
+		*actread = to - offset;
 		data_offset += table_size;
-		if (data_buffer)
-			free(data_buffer);
-		data_buffer = NULL;
-		if (*actread >= len)
-			break;
 	}
 
 	/*
-	 * There is no need to continue if the file is not fragmented.
+	 * There is no need to continue if the file is not fragmented, or if
+	 * the requested data ends before its fragment.
 	 */
-	if (!finfo.frag) {
+	pos = (u64)datablk_count * block_size;
+	if (!finfo.frag || pos >= end) {
 		ret = 0;
 		goto out;
 	}
 
-	start = frag_entry.start / ctxt.cur_dev->blksz;
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	/*
+	 * Files sharing a fragment block are usually read one after the
+	 * other, so it is likely to be in the cache already.
+	 */
+	ret = sqfs_cache_get(frag_entry.start, frag_entry.size, &data,
+			     &dest_len);
+	if (ret)
+		goto out;
 
-	if (!fragment) {
-		ret = -ENOMEM;
+	if (finfo.offset > dest_len ||
+	    file_size - pos > dest_len - finfo.offset) {
+		ret = -EINVAL;
 		goto out;
 	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
-		goto out;
+	from = max_t(u64, pos, offset);
+	memcpy(buf + from - offset, data + finfo.offset + from - pos,
+	       end - from);
+	*actread = len;
 
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
+out:
+	free(chunk);
+	free(finfo.blk_sizes);
 
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
+	return ret;
+}
+
+int sqfs_get_extents(const char *filename, loff_t *size,
+		     struct fs_extent **extp)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u32 block_size = get_unaligned_le32(&sblk->block_size);
+	struct squashfs_fragment_block_entry frag_entry;
+	struct squashfs_file_info finfo = {0};
+	int ret, j, datablk_count, count = 0;
+	u64 data_offset;
+	loff_t offset;
 
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
+	*extp = NULL;
+	ret = sqfs_get_file_info(filename, &finfo, &frag_entry);
+	if (ret < 0)
+		return ret;
+	datablk_count = ret;
 
-		free(fragment_block);
+	/* only uncompressed data can be read straight from the disk */
+	ret = -ENOSYS;
+	if (finfo.frag && finfo.comp)
+		goto out;
+	for (j = 0; j < datablk_count; j++)
+		if (finfo.blk_sizes[j] &&
+		    SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j]))
+			goto out;
 
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
+	data_offset = finfo.start;
+	for (j = 0, offset = 0; j < datablk_count; j++) {
+		u32 table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
+
+		/* sparse blocks are holes */
+		if (finfo.blk_sizes[j]) {
+			count = fs_add_extent(extp, count, offset,
+					      min_t(u64, table_size,
+						    finfo.size - offset),
+					      data_offset);
+			if (count < 0)
+				goto err;
+		}
+		data_offset += table_size;
+		offset += block_size;
+	}
 
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
+	if (finfo.frag) {
+		count = fs_add_extent(extp, count, offset, finfo.size - offset,
+				      frag_entry.start + finfo.offset);
+		if (count < 0)
+			goto err;
 	}
 
+	*size = finfo.size;
+	ret = count;
+	goto out;
+err:
+	free(*extp);
+	*extp = NULL;
+	ret = count;
 out:
-	free(fragment);
-	if (datablk_count) {
-		free(data_buffer);
-		free(datablock);
-	}
-	free(file);
-	free(dir);
 	free(finfo.blk_sizes);
-	sqfs_closedir(dirsp);
 
 	return ret;
 }
@@ -1702,6 +1995,7 @@ free_strings:
 
 void sqfs_close(void)
 {
+	sqfs_cache_free();
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
@@ -1716,8 +2010,7 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
+	sqfs_put_tables(sqfs_dirs->tables);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
@@ -93,17 +93,21 @@ static void zlib_decompression_status(int ret)
 
 #if IS_ENABLED(CONFIG_ZSTD)
 static int sqfs_zstd_decompress(struct squashfs_ctxt *ctxt, void *dest,
-				unsigned long dest_len, void *source, u32 src_len)
+				unsigned long *dest_len, void *source, u32 src_len)
 {
 	ZSTD_DCtx *ctx;
-	size_t wsize;
-	int ret;
+	size_t wsize, ret;
 
 	wsize = ZSTD_DCtxWorkspaceBound();
 	ctx = ZSTD_initDCtx(ctxt->zstd_workspace, wsize);
-	ret = ZSTD_decompressDCtx(ctx, dest, dest_len, source, src_len);
+	ret = ZSTD_decompressDCtx(ctx, dest, *dest_len, source, src_len);
+	if (ZSTD_isError(ret)) {
+		printf("ZSTD Error code: %d\n", ZSTD_getErrorCode(ret));
+		return -EINVAL;
+	}
+	*dest_len = ret;
 
-	return ZSTD_isError(ret);
+	return 0;
 }
 #endif /* CONFIG_ZSTD */
 
@@ -122,6 +126,7 @@ int sqfs_decompress(struct squashfs_ctxt *ctxt, void *dest,
 			printf("LZO decompression failed. Error code: %d\n", ret);
 			return -EINVAL;
 		}
+		*dest_len = lzo_dest_len;
 
 		break;
 	}
@@ -138,11 +143,9 @@ int sqfs_decompress(struct squashfs_ctxt *ctxt, void *dest,
 #endif
 #if IS_ENABLED(CONFIG_ZSTD)
 	case SQFS_COMP_ZSTD:
-		ret = sqfs_zstd_decompress(ctxt, dest, *dest_len, source, src_len);
-		if (ret) {
-			printf("ZSTD Error code: %d\n", ZSTD_getErrorCode(ret));
-			return -EINVAL;
-		}
+		ret = sqfs_zstd_decompress(ctxt, dest, dest_len, source, src_len);
+		if (ret)
+			return ret;
 
 		break;
 #endif
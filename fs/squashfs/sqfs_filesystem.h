@@ -73,6 +73,32 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+/*
+ * The decompressed inode and directory tables. They are read once per mount
+ * and shared by every directory stream opened on it; the last user to let go
+ * of them frees them.
+ */
+struct squashfs_tables {
+	int refcount;
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	/* positions of the directory table's metadata blocks */
+	u32 *dir_pos;
+	int dir_metablks;
+};
+
+/*
+ * A decompressed data or fragment block, identified by its position on disk.
+ * 'len' is zero if the entry is unused, and 'stamp' tells which entry was
+ * used least recently.
+ */
+struct squashfs_cache_entry {
+	u64 start;
+	unsigned long len;
+	u32 stamp;
+	unsigned char *data;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
@@ -80,6 +106,12 @@ struct squashfs_ctxt {
 #if IS_ENABLED(CONFIG_ZSTD)
 	void *zstd_workspace;
 #endif
+	struct squashfs_tables *tables;
+	/* Fragment index table and the fragment entry blocks read so far */
+	u64 *frag_index;
+	struct squashfs_fragment_block_entry **frag_entries;
+	struct squashfs_cache_entry cache[CONFIG_SQUASHFS_CACHE_BLOCKS];
+	u32 cache_stamp;
 };
 
 struct squashfs_directory_index {
@@ -274,8 +306,9 @@ struct squashfs_dir_stream {
 	struct squashfs_ldir_inode i_ldir;
 	/*
 	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * sqfs_opendir() and released in sqfs_closedir().
 	 */
+	struct squashfs_tables *tables;
 	unsigned char *inode_table;
 	unsigned char *dir_table;
 };
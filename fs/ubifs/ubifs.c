@@ -672,25 +672,17 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+/*
+ * Decompress data node @dn holding block @block into @addr, zeroing the rest
+ * of the block.
+ */
+static int decompress_block(struct ubifs_info *c, struct inode *inode,
+			    void *addr, unsigned int block,
+			    struct ubifs_data_node *dn)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
-	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
-
 	len = le32_to_cpu(dn->size);
 	if (len <= 0 || len > UBIFS_BLOCK_SIZE)
 		goto dump;
@@ -719,6 +711,72 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
+
+	return decompress_block(c, inode, addr, block, dn);
+}
+
+/*
+ * Read up to @max whole blocks starting at @block with as few UBI reads as
+ * possible. A single walk of the TNC finds the data nodes which follow each
+ * other in the same LEB, they are read in one go and each is decompressed
+ * straight into @addr; holes in between are zeroed. Returns the number of
+ * blocks read, 0 if there was nothing to bulk-read, or a negative error code.
+ */
+static int do_bulk_read(struct ubifs_info *c, struct inode *inode,
+			void *addr, unsigned int block, int max)
+{
+	struct bu_info *bu = &c->bu;
+	struct ubifs_data_node *dn;
+	int err, i, nn = 0, cnt;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+	if (!bu->cnt)
+		return 0;
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		return err;
+
+	cnt = min(bu->blk_cnt, max);
+	for (i = 0; i < cnt; i++, addr += UBIFS_BLOCK_SIZE) {
+		if (nn >= bu->cnt ||
+		    key_block(c, &bu->zbranch[nn].key) != block + i) {
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+			continue;
+		}
+
+		dn = bu->buf + bu->zbranch[nn].offs - bu->zbranch[0].offs;
+		err = decompress_block(c, inode, addr, block + i, dn);
+		if (err)
+			return err;
+		nn++;
+	}
+
+	return cnt;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -839,8 +897,9 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	struct page page;
 	int err = 0;
 	int i;
-	int count;
+	int count, n;
 	int last_block_size = 0;
+	bool bulk_read = c->bulk_read;
 
 	*actread = 0;
 
@@ -895,6 +954,27 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 		if (((i + 1) == count) && (size < inode->i_size))
 			last_block_size = size - (i * PAGE_SIZE);
 
+		/*
+		 * Pages are the size of a block here. All but the last one
+		 * are filled completely, so they can be read in bulk.
+		 */
+		if (bulk_read && i + 1 < count) {
+			n = do_bulk_read(c, inode, page.addr, page.index,
+					 count - 1 - i);
+			if (n < 0) {
+				/* read the rest one block at a time */
+				dbg_gen("bulk-read failed (%d), falling back", n);
+				bulk_read = false;
+				n = 0;
+			}
+			if (n) {
+				page.addr += n * PAGE_SIZE;
+				page.index += n;
+				i += n - 1;
+				continue;
+			}
+		}
+
 		err = do_readpage(c, inode, &page, last_block_size);
 		if (err)
 			break;
@@ -111,6 +111,19 @@ struct blk_desc {
 #endif
 };
 
+/**
+ * struct blk_seg - one destination segment of a vectored read
+ *
+ * @buffer:	Where this part of the data goes
+ * @len:	Length of the segment in bytes. This need not be a multiple
+ *		of the block size, but the segments of a read must add up
+ *		to whole blocks
+ */
+struct blk_seg {
+	void *buffer;
+	ulong len;
+};
+
 #define BLOCK_CNT(size, blk_desc) (PAD_COUNT(size, blk_desc->blksz))
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
@@ -154,6 +167,27 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_fetch_range() - work out which blocks to read on a cache miss
+ *
+ * Small requests are widened to whole cache lines and, when the device is
+ * being read sequentially, extended by the configured readahead so that
+ * the following requests are served from the cache.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number of the request
+ * @param blkcnt - number of blocks requested
+ * @param blksz - size in bytes of each block
+ * @param fetch_start - returns the first block to read
+ *
+ * @return - number of blocks to read from @fetch_start, or 0 if the
+ * request should be read directly into the caller's buffer
+ */
+lbaint_t blkcache_fetch_range(int iftype, int dev,
+			      lbaint_t start, lbaint_t blkcnt,
+			      unsigned long blksz, lbaint_t *fetch_start);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -166,10 +200,24 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * @param blocks - blocks per cache line
+ * @param max_bytes - memory budget of the cache in bytes
+ * @param readahead - blocks to prefetch on sequential access
+ */
+void blkcache_configure(unsigned blocks, unsigned long max_bytes,
+			unsigned readahead);
+
+/**
+ * blkcache_get_config() - get the configuration of the block cache
+ *
+ * Unlike blkcache_stats(), this leaves the statistics alone.
+ *
+ * @param blocks - returns blocks per cache line
+ * @param max_bytes - returns memory budget of the cache in bytes
+ * @param readahead - returns blocks to prefetch on sequential access
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_get_config(unsigned *blocks, unsigned long *max_bytes,
+			 unsigned *readahead);
 
 /*
  * statistics of the block cache
@@ -177,9 +225,23 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned readahead; /* blocks prefetched */
 	unsigned entries; /* current entry count */
+	unsigned long bytes; /* memory used by the entries */
 	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned long max_bytes;
+	unsigned readahead_blocks;
+};
+
+/*
+ * per-device statistics of the block cache
+ */
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned readahead; /* blocks prefetched */
 };
 
 /**
@@ -189,6 +251,16 @@ struct block_cache_stats {
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics of one device and reset them
+ *
+ * @param index - index of the device in the order it was first accessed
+ * @param stats - statistics are copied here
+ *
+ * @return - 0 if OK, -ENOENT if there is no device at @index
+ */
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats);
+
 #else
 
 static inline int blkcache_read(int iftype, int dev,
@@ -202,12 +274,55 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline lbaint_t blkcache_fetch_range(int iftype, int dev,
+					    lbaint_t start, lbaint_t blkcnt,
+					    unsigned long blksz,
+					    lbaint_t *fetch_start)
+{
+	return 0;
+}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
 
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
+struct blk_req;
+struct stream_sink;
+
+/**
+ * typedef blk_req_done_t - completion callback of an asynchronous read
+ *
+ * Called from blk_poll() (or from blk_dread_async() if the read completed
+ * synchronously) once @req->result is valid.
+ *
+ * @req:	Request that has completed
+ */
+typedef void (*blk_req_done_t)(struct blk_req *req);
+
+/**
+ * struct blk_req - an asynchronous block read, see blk_dread_async()
+ *
+ * @desc:	Block device the request was submitted to
+ * @start:	Start block number to read
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Destination buffer for data read
+ * @done:	Completion callback, or NULL. Set by the caller
+ * @priv:	Private data for the caller, e.g. for @done
+ * @result:	Number of blocks read, or -ve error number, once complete
+ * @complete:	true once the request has completed
+ */
+struct blk_req {
+	struct blk_desc *desc;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	blk_req_done_t done;
+	void *priv;
+	long result;
+	bool complete;
+};
 
 /* Operations on block devices */
 struct blk_ops {
@@ -267,6 +382,57 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * readv() - read from a block device into a list of segments
+	 *
+	 * The data is transferred straight into each segment, with no
+	 * intermediate buffer, e.g. by building a DMA descriptor chain.
+	 * Devices which DMA into the segments must not invalidate a cache
+	 * line that a segment shares with other data, so they transfer any
+	 * partial cache line at either end of a segment through a bounce
+	 * buffer.
+	 *
+	 * @dev:	Device to read from
+	 * @start:	Start block number to read (0=first)
+	 * @blkcnt:	Number of blocks to read
+	 * @segs:	Destination segments, adding up to @blkcnt blocks
+	 * @nsegs:	Number of segments
+	 * @return number of blocks read, or -ve error number (see the
+	 * IS_ERR_VALUE() macro). -ENOSYS means the segments cannot be
+	 * handled by the device, in which case the uclass falls back to
+	 * read()
+	 */
+	unsigned long (*readv)(struct udevice *dev, lbaint_t start,
+			       lbaint_t blkcnt, const struct blk_seg *segs,
+			       int nsegs);
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	/**
+	 * read_submit() - start an asynchronous read from a block device
+	 *
+	 * The driver starts the transfer described by @req and returns
+	 * without waiting for it to complete. Only one request can be in
+	 * progress on a device at a time.
+	 *
+	 * @dev:	Device to read from
+	 * @req:	Request to start
+	 * @return 0 if the transfer was started, -ENOSYS if this request
+	 * cannot be handled asynchronously (the uclass then falls back to
+	 * read()), other -ve on error
+	 */
+	int (*read_submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * read_poll() - check progress of an asynchronous read
+	 *
+	 * @dev:	Device the request was submitted to
+	 * @req:	Request to check
+	 * @return number of blocks read if the request has completed,
+	 * -EBUSY if it is still in progress, other -ve on error
+	 */
+	long (*read_poll)(struct udevice *dev, struct blk_req *req);
+#endif
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -284,6 +450,96 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_dreadv() - read from a block device into a list of segments
+ *
+ * This reads a contiguous range of blocks and scatters it over several
+ * buffers, e.g. the fragments of a file or the unaligned head and tail of
+ * a load. Devices which support it transfer the data straight into the
+ * segments in one command. Otherwise the blocks which lie within a segment
+ * are read straight into it and only those which straddle two segments go
+ * through a temporary buffer.
+ *
+ * @block_dev:	Block device to read from
+ * @start:	Start block number to read (0=first)
+ * @blkcnt:	Number of blocks to read
+ * @segs:	Destination segments, adding up to @blkcnt blocks
+ * @nsegs:	Number of segments
+ * @return number of blocks read, or -ve error number (see the
+ * IS_ERR_VALUE() macro)
+ */
+unsigned long blk_dreadv(struct blk_desc *block_dev, lbaint_t start,
+			 lbaint_t blkcnt, const struct blk_seg *segs,
+			 int nsegs);
+
+/**
+ * blk_dread_async() - start reading from a block device
+ *
+ * Starts reading @blkcnt blocks into @buffer and returns without waiting
+ * for the transfer, so that the caller can do other work meanwhile. The
+ * caller must set @req->done and @req->priv beforehand, keep @req valid
+ * until it completes and call blk_poll() or blk_wait() to complete it.
+ * No other access to the device is allowed until then.
+ *
+ * Devices without asynchronous support, or which cannot handle this
+ * particular request asynchronously, fall back to blk_dread(), so the
+ * request completes before this function returns. Asynchronous transfers
+ * bypass the block cache lookup.
+ *
+ * @block_dev:	Block device to read from
+ * @start:	Start block number to read (0=first)
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Destination buffer for data read, should be cache-aligned
+ *		for the transfer to be done asynchronously
+ * @req:	Request to fill in
+ * @return 0 if the request was submitted (or has completed), -ve on error
+ */
+int blk_dread_async(struct blk_desc *block_dev, lbaint_t start,
+		    lbaint_t blkcnt, void *buffer, struct blk_req *req);
+
+/**
+ * blk_poll() - check for completion of an asynchronous read
+ *
+ * If the request has just completed, @req->result is updated and the
+ * completion callback is called.
+ *
+ * @req:	Request started by blk_dread_async()
+ * @return 0 if the request has completed, -EBUSY if still in progress
+ */
+int blk_poll(struct blk_req *req);
+
+/**
+ * blk_wait() - wait for an asynchronous read to complete
+ *
+ * @req:	Request started by blk_dread_async()
+ * @return number of blocks read, or -ve error number (see the
+ * IS_ERR_VALUE() macro)
+ */
+long blk_wait(struct blk_req *req);
+
+/**
+ * blk_dread_stream() - read from a block device, passing each chunk on
+ *
+ * Reads @blkcnt blocks in chunks of up to @chunk blocks and passes each
+ * chunk to @sink as it arrives, so that the data can be hashed or
+ * decompressed without first reading it all into memory. Two chunk
+ * buffers are used, so that on devices with asynchronous support the next
+ * chunk is read while @sink is busy with the current one. @sink must not
+ * access the block device.
+ *
+ * @block_dev:	Block device to read from
+ * @start:	Start block number to read (0=first)
+ * @blkcnt:	Number of blocks to read
+ * @chunk:	Maximum number of blocks to pass to @sink at once
+ * @sink:	Consumer of the data
+ * @return number of blocks read, or -ve error number: the error from
+ * @sink if it stopped the stream, -ENOMEM if no chunk buffers could be
+ * allocated, or the error from the read (see the IS_ERR_VALUE() macro)
+ */
+long blk_dread_stream(struct blk_desc *block_dev, lbaint_t start,
+		      lbaint_t blkcnt, lbaint_t chunk,
+		      struct stream_sink *sink);
+
 /**
  * blk_find_device() - Find a block device
  *
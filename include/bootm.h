@@ -60,6 +60,18 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 		    char *const argv[], int states, bootm_headers_t *images,
 		    int boot_progress);
 
+/**
+ * bootm_load_os() - decompress or copy the OS image to its load address
+ *
+ * This is the BOOTM_STATE_LOADOS step, without the reset which
+ * do_bootm_states() does on failure.
+ *
+ * @images: Images being booted, set up by the earlier bootm states
+ * @boot_progress: true to show boot progress
+ * @return 0 if OK, BOOTM_ERR_... on failure
+ */
+int bootm_load_os(bootm_headers_t *images, int boot_progress);
+
 void arch_preboot_os(void);
 
 /*
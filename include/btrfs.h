@@ -10,6 +10,7 @@
 
 struct blk_desc;
 struct disk_partition;
+struct fs_extent;
 
 int btrfs_probe(struct blk_desc *fs_dev_desc,
 		struct disk_partition *fs_partition);
@@ -17,6 +18,7 @@ int btrfs_ls(const char *);
 int btrfs_exists(const char *);
 int btrfs_size(const char *, loff_t *);
 int btrfs_read(const char *, void *, loff_t, loff_t, loff_t *);
+int btrfs_get_extents(const char *, loff_t *, struct fs_extent **);
 void btrfs_close(void);
 int btrfs_uuid(char *);
 void btrfs_list_subvols(void);
@@ -29,10 +29,15 @@
 #include <ext_common.h>
 
 struct disk_partition;
+struct fs_extent;
 
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
+#define EXT4_CASEFOLD_FL	0x40000000 /* Casefolded directory */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_EXT_MAX_DEPTH		5
+#define EXT4_EXT_INIT_MAX_LEN		(1 << 15)
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_RO_COMPAT_METADATA_CSUM 0x0400
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
@@ -113,6 +118,9 @@ struct ext_filesystem {
 	int curr_inode_no;
 	uint16_t first_pass_ibmap;
 
+	/* Groups whose bitmaps or descriptor need writing back */
+	unsigned long *dirty_grps;
+
 	/* Journal Related */
 
 	/* Block Device Descriptor */
@@ -161,6 +169,8 @@ int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 struct disk_partition *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		   loff_t *actread);
+int ext4fs_get_extents(const char *filename, loff_t *size,
+		       struct fs_extent **extp);
 int ext4_read_superblock(char *buffer);
 int ext4fs_uuid(char *uuid_str);
 void ext_cache_init(struct ext_block_cache *cache);
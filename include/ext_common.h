@@ -198,11 +198,20 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* A run of blocks from an inode's extent tree, see ext4fs_map_extents() */
+struct ext4_run {
+	uint32_t lblk;		/* first logical block */
+	uint32_t len;		/* number of blocks */
+	uint64_t pblk;		/* first physical block, 0 if unwritten */
+};
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext4_run *runs;	/* decoded extent tree, sorted by lblk */
+	int nruns;
 };
 
 /* Information about a "mounted" ext2 filesystem. */
@@ -14,6 +14,7 @@
 #include <asm/cache.h>
 
 struct disk_partition;
+struct fs_extent;
 
 /* Maximum Long File Name length supported here is 128 UTF-16 code units */
 #define VFAT_MAXLEN_BYTES	256 /* Maximum LFN buffer in bytes */
@@ -22,6 +23,13 @@ struct disk_partition;
 
 #define MAX_CLUSTSIZE	CONFIG_FS_FAT_MAX_CLUSTSIZE
 
+/* SPL keeps to a single window of the FAT, to save memory */
+#if defined(CONFIG_FS_FAT_CACHE_WINDOWS) && !defined(CONFIG_SPL_BUILD)
+#define FAT_CACHE_WINDOWS	CONFIG_FS_FAT_CACHE_WINDOWS
+#else
+#define FAT_CACHE_WINDOWS	1
+#endif
+
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
@@ -168,20 +176,23 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* FAT cache, FAT_CACHE_WINDOWS windows */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
+	__u8	fat_dirty[FAT_CACHE_WINDOWS];	/* Set if window modified */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	fatbufnum[FAT_CACHE_WINDOWS];	/* FAT window cached, or -1 */
+	__u32	fatbufused[FAT_CACHE_WINDOWS];	/* When window last used */
+	__u32	fatbufclock;	/* Counter for fatbufused */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	__u16	fsinfo_sect;	/* FSInfo sector for FAT32, 0 if none */
 } fsdata;
 
 struct fat_itr;
@@ -210,6 +221,8 @@ int file_fat_write(const char *filename, void *buf, loff_t offset, loff_t len,
 		   loff_t *actwrite);
 int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		  loff_t *actread);
+int fat_get_extents(const char *filename, loff_t *size,
+		    struct fs_extent **extp);
 int fat_opendir(const char *filename, struct fs_dir_stream **dirsp);
 int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
 void fat_closedir(struct fs_dir_stream *dirs);
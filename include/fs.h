@@ -19,6 +19,7 @@ struct cmd_tbl;
 #define FS_TYPE_SQUASHFS 6
 
 struct blk_desc;
+struct stream_sink;
 
 int do_fat_size(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[]);
 
@@ -81,6 +82,29 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part);
  */
 void fs_close(void);
 
+#if CONFIG_IS_ENABLED(FS_KEEP_MOUNTED)
+/**
+ * fs_unmount() - Unmount the filesystem kept mounted by fs_close()
+ *
+ * This must be called before using a filesystem driver directly rather than
+ * through this API, since the drivers only support one mounted filesystem.
+ */
+void fs_unmount(void);
+
+/**
+ * fs_invalidate_dev() - Note that the contents of a block device changed
+ *
+ * Any filesystem kept mounted on @desc is unmounted on the next call to
+ * fs_close() or fs_set_blk_dev().
+ *
+ * @desc: Block device which was written to or re-initialised
+ */
+void fs_invalidate_dev(struct blk_desc *desc);
+#else
+static inline void fs_unmount(void) {}
+static inline void fs_invalidate_dev(struct blk_desc *desc) {}
+#endif
+
 /**
  * fs_get_type() - Get type of current filesystem
  *
@@ -141,6 +165,27 @@ int fs_size(const char *filename, loff_t *size);
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread);
 
+/**
+ * fs_read_stream() - read a file, passing each chunk to a consumer
+ *
+ * This reads the file from the partition previously set by
+ * fs_set_blk_dev() and passes the data to @sink as it arrives, so that it
+ * can be hashed, decompressed or copied in a single pass. Where the driver
+ * can describe the file with fs_get_extents() the blocks are streamed
+ * straight from the device, otherwise the file is read through the
+ * driver a chunk at a time.
+ *
+ * @filename:	full path of the file to read from
+ * @offset:	offset in the file from where to start reading
+ * @len:	the number of bytes to read. Use 0 to read entire file.
+ * @sink:	consumer of the data, see include/stream.h
+ * @actread:	returns the number of bytes passed to @sink
+ * Return:	0 if OK with valid *actread, -ve on error, which is the error
+ *		returned by @sink if it stopped the stream
+ */
+int fs_read_stream(const char *filename, loff_t offset, loff_t len,
+		   struct stream_sink *sink, loff_t *actread);
+
 /**
  * fs_write() - write file to the partition previously set by fs_set_blk_dev()
  *
@@ -156,6 +201,35 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite);
 
+/**
+ * struct fs_extent - run of file data stored contiguously on disk
+ *
+ * @offset:	offset of the run in the file, in bytes
+ * @len:	length of the run in bytes
+ * @pos:	byte offset of the run on disk, from the start of the partition
+ */
+struct fs_extent {
+	loff_t offset;
+	loff_t len;
+	u64 pos;
+};
+
+/**
+ * fs_get_extents() - get the on-disk layout of a file
+ *
+ * The extents are sorted by file offset and do not overlap. Parts of the
+ * file which are not covered by an extent (holes) read as zeroes. This is
+ * only supported for files whose data is stored uncompressed.
+ *
+ * @filename:	full path of the file
+ * @size:	returns the size of the file
+ * @extp:	returns the extents, which the caller must free()
+ * Return:	number of extents, -ENOSYS if the layout of the file cannot be
+ *		described this way, other -ve value on error
+ */
+int fs_get_extents(const char *filename, loff_t *size,
+		   struct fs_extent **extp);
+
 /*
  * Directory entry types, matches the subset of DT_x in posix readdir()
  * which apply to u-boot.
@@ -251,6 +325,8 @@ int do_size(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	    int fstype);
 int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	    int fstype);
+int do_zload(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
+	     int fstype);
 int do_ls(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	  int fstype);
 int file_exists(const char *dev_type, const char *dev_part, const char *file,
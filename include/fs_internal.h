@@ -13,4 +13,22 @@
 int fs_devread(struct blk_desc *, struct disk_partition *, lbaint_t, int, int,
 	       char *);
 
+struct fs_extent;
+
+/**
+ * fs_add_extent() - append a run to an extent list
+ *
+ * The run is merged with the last extent if it follows it both in the file
+ * and on disk. The list is grown as needed.
+ *
+ * @extp:	extent list, reallocated as needed
+ * @count:	number of extents in the list
+ * @offset:	offset of the run in the file
+ * @len:	length of the run
+ * @pos:	byte offset of the run on the partition
+ * Return:	new number of extents, or -ENOMEM
+ */
+int fs_add_extent(struct fs_extent **extp, int count, loff_t offset,
+		  loff_t len, u64 pos);
+
 #endif /* __U_BOOT_FS_INTERNAL_H__ */
@@ -7,7 +7,10 @@
 #ifndef __GZIP_H
 #define __GZIP_H
 
+#include <stream.h>
+
 struct blk_desc;
+struct z_stream_s;
 
 /**
  * gzip_parse_header() - Parse a header from a gzip file
@@ -76,6 +79,49 @@ void gzwrite_progress_finish(int retcode, u64 totalwritten, u64 totalsize,
 int gzwrite(unsigned char *src, int len, struct blk_desc *dev, ulong szwritebuf,
 	    u64 startoffs, u64 szexpected);
 
+/**
+ * struct gunzip_stream - consumer which decompresses gzipped data to memory
+ *
+ * @sink:	Stream consumer
+ * @zs:		zlib state
+ * @dst:	Destination buffer
+ * @size:	Number of bytes decompressed so far
+ * @max:	Size of the destination buffer
+ * @done:	true once the end of the gzip stream has been seen
+ */
+struct gunzip_stream {
+	struct stream_sink sink;
+	struct z_stream_s *zs;
+	void *dst;
+	ulong size;
+	ulong max;
+	bool done;
+};
+
+/**
+ * gunzip_stream_init() - set up a consumer which decompresses gzipped data
+ *
+ * This allows an image to be decompressed while it is being read, e.g.
+ * with fs_read_stream(), so the compressed data never needs to be held in
+ * memory. The gzip header may be split over any number of chunks.
+ *
+ * @gs:		Consumer to set up
+ * @dst:	Destination buffer for the decompressed data
+ * @max:	Size of the destination buffer
+ * @return 0 if OK, -ve on error
+ */
+int gunzip_stream_init(struct gunzip_stream *gs, void *dst, ulong max);
+
+/**
+ * gunzip_stream_finish() - finish decompressing and free the consumer
+ *
+ * @gs:		Consumer set up by gunzip_stream_init()
+ * @sizep:	Returns the number of bytes decompressed
+ * @return 0 if OK, -ENOSPC if the output did not fit, -EINVAL if the data
+ * was truncated
+ */
+int gunzip_stream_finish(struct gunzip_stream *gs, ulong *sizep);
+
 /**
  * gzip()- Compress data into a buffer using the gzip algorithm
  *
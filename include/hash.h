@@ -6,6 +6,10 @@
 #ifndef _HASH_H
 #define _HASH_H
 
+#ifndef USE_HOSTCC
+#include <stream.h>
+#endif
+
 struct cmd_tbl;
 
 /*
@@ -94,6 +98,17 @@ struct hash_algo {
 int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 		 int flag, int argc, char *const argv[]);
 
+/**
+ * hash_bench() - Measure the speed of each hash algorithm
+ *
+ * This prints the throughput of each algorithm when hashing a buffer of
+ * the given size, e.g. to check whether CPU-specific code is in use.
+ *
+ * @size:	Size of the buffer to hash in bytes
+ * @return 0 if OK, -ENOMEM if the buffer could not be allocated
+ */
+int hash_bench(ulong size);
+
 /**
  * hash_block() - Hash a block according to the requested algorithm
  *
@@ -116,6 +131,46 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 int hash_block(const char *algo_name, const void *data, unsigned int len,
 	       uint8_t *output, int *output_size);
 
+/**
+ * struct hash_stream - consumer which hashes streamed data
+ *
+ * @sink:	Stream consumer
+ * @algo:	Hash algorithm
+ * @ctx:	Progressive hashing context, NULL once finished
+ */
+struct hash_stream {
+	struct stream_sink sink;
+	struct hash_algo *algo;
+	void *ctx;
+};
+
+/**
+ * hash_stream_init() - set up a consumer which hashes streamed data
+ *
+ * This allows an image to be hashed while it is being read, e.g. with
+ * fs_read_stream(), instead of in a second pass over memory.
+ *
+ * @hs:		Consumer to set up
+ * @algo_name:	Hash algorithm to use, which must support progressive hashing
+ * @return 0 if ok, -EPROTONOSUPPORT for an unknown algorithm, other -ve
+ * value on error
+ */
+int hash_stream_init(struct hash_stream *hs, const char *algo_name);
+
+/**
+ * hash_stream_finish() - get the hash of the streamed data
+ *
+ * This also frees the hashing context, so must be called even if the
+ * stream failed.
+ *
+ * @hs:		Consumer set up by hash_stream_init()
+ * @output:	Place to put hash value
+ * @size:	Number of bytes available in @output
+ * @return 0 if ok, -ENOSPC if @output is too small, other -ve value on
+ * error
+ */
+int hash_stream_finish(struct hash_stream *hs, void *output, int size);
+
 #endif /* !USE_HOSTCC */
 
 /**
@@ -22,6 +22,7 @@
 /* Define this to avoid #ifdefs later on */
 struct lmb;
 struct fdt_region;
+struct stream_sink;
 
 #ifdef USE_HOSTCC
 #include <sys/types.h>
@@ -877,7 +878,7 @@ static inline int image_check_target_arch(const image_header_t *hdr)
  * @return	compression type or IH_COMP_NONE if not compressed.
  *
  * Note: Only following compression types are supported now.
- * lzo, lzma, gzip, bzip2
+ * lzo, lzma, gzip, bzip2, lz4, zstd
  */
 int image_decomp_type(const unsigned char *buf, ulong len);
 
@@ -898,6 +899,44 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * struct image_decomp_stream - consumer which decompresses an image to memory
+ *
+ * @sink:	Stream consumer to pass the compressed data to
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @priv:	Decompressor state
+ */
+struct image_decomp_stream {
+	struct stream_sink *sink;
+	int comp;
+	void *priv;
+};
+
+/**
+ * image_decomp_stream_init() - set up streaming decompression of an image
+ *
+ * Unlike image_decomp(), this does not need the whole compressed image in
+ * memory. Chunks passed to @ids->sink, e.g. by fs_read_stream(), are
+ * decompressed straight to @dst as they arrive. Uncompressed data is copied.
+ *
+ * @ids:	Consumer to set up
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @dst:	Place to decompress to
+ * @max:	Available space for decompression
+ * @return 0 if OK, -ENOSYS if @comp cannot be streamed, other -ve on error
+ */
+int image_decomp_stream_init(struct image_decomp_stream *ids, int comp,
+			     void *dst, ulong max);
+
+/**
+ * image_decomp_stream_finish() - finish decompressing and free the consumer
+ *
+ * @ids:	Consumer set up by image_decomp_stream_init()
+ * @sizep:	Returns the number of bytes decompressed
+ * @return 0 if OK, -ve if the compressed data was incomplete
+ */
+int image_decomp_stream_finish(struct image_decomp_stream *ids, ulong *sizep);
+
 /**
  * Set up properties in the FDT
  *
@@ -443,6 +443,18 @@ int mtd_block_isreserved(struct mtd_info *mtd, loff_t ofs);
 int mtd_block_isbad(struct mtd_info *mtd, loff_t ofs);
 int mtd_block_markbad(struct mtd_info *mtd, loff_t ofs);
 
+/**
+ * mtd_write_count() - get the number of changes made to MTD devices
+ *
+ * This goes up by one for each call to mtd_erase(), mtd_write(),
+ * mtd_write_oob() or mtd_block_markbad() on any device. Users caching what
+ * is on the flash can compare it with their own count of changes to tell
+ * whether someone else may have modified it.
+ *
+ * Return: number of changes since boot
+ */
+unsigned long mtd_write_count(void);
+
 #ifndef __UBOOT__
 static inline int mtd_suspend(struct mtd_info *mtd)
 {
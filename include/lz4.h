@@ -6,6 +6,8 @@
 #ifndef __LZ4_H
 #define __LZ4_H
 
+#include <stream.h>
+
 /**
  * ulz4fn() - Decompress LZ4 data
  *
@@ -21,4 +23,62 @@
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * struct lz4_stream - consumer which decompresses an LZ4 frame to memory
+ *
+ * @sink:	Stream consumer
+ * @dst:	Destination buffer
+ * @size:	Number of bytes decompressed so far
+ * @max:	Size of the destination buffer
+ * @state:	Next part of the frame which is expected
+ * @need:	Number of bytes in the next part of the frame
+ * @have:	Number of bytes of the next part collected so far
+ * @hdr:	Holds a header which is split across chunks
+ * @buf:	Holds a block which is split across chunks
+ * @buf_size:	Size of @buf, the maximum block size of the frame
+ * @block_header: Header of the current block
+ * @block_checksum: true if each block is followed by a checksum
+ */
+struct lz4_stream {
+	struct stream_sink sink;
+	void *dst;
+	ulong size;
+	ulong max;
+	int state;
+	u32 need;
+	u32 have;
+	u8 hdr[16];
+	void *buf;
+	void *tail;
+	u32 buf_size;
+	u32 block_header;
+	bool block_checksum;
+};
+
+/**
+ * lz4_stream_init() - set up a consumer which decompresses LZ4 data
+ *
+ * This handles the same frames as ulz4fn(), but the frame can arrive in
+ * chunks of any size, e.g. from fs_read_stream(). Blocks which are split
+ * across chunks are collected in a buffer of the frame's maximum block size.
+ * Once less than a block of space is left before @max, blocks are
+ * decompressed into a second such buffer and copied from there.
+ * The stream fails with -ENOSPC if more than @max bytes are output, or
+ * -EPROTO if a block is corrupt.
+ *
+ * @ls:		Consumer to set up
+ * @dst:	Destination buffer for the decompressed data
+ * @max:	Size of the destination buffer
+ */
+void lz4_stream_init(struct lz4_stream *ls, void *dst, ulong max);
+
+/**
+ * lz4_stream_finish() - finish decompressing and free the consumer
+ *
+ * @ls:		Consumer set up by lz4_stream_init()
+ * @sizep:	Returns the number of bytes decompressed
+ * @return 0 if OK, -EINVAL if the frame was truncated
+ */
+int lz4_stream_finish(struct lz4_stream *ls, ulong *sizep);
+
 #endif
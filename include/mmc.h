@@ -16,6 +16,8 @@
 #include <linux/dma-direction.h>
 #include <part.h>
 
+struct blk_req;
+
 struct bd_info;
 
 #if CONFIG_IS_ENABLED(MMC_HS200_SUPPORT)
@@ -74,6 +76,7 @@ struct bd_info;
 #define MMC_CAP_NONREMOVABLE	BIT(14)
 #define MMC_CAP_NEEDS_POLL	BIT(15)
 #define MMC_CAP_CD_ACTIVE_HIGH  BIT(16)
+#define MMC_CAP_SG		BIT(17)	/* host handles MMC_DATA_SG */
 
 #define MMC_MODE_8BIT		BIT(30)
 #define MMC_MODE_4BIT		BIT(29)
@@ -88,6 +91,7 @@ struct bd_info;
 
 #define MMC_DATA_READ		1
 #define MMC_DATA_WRITE		2
+#define MMC_DATA_SG		4	/* transfer to/from data->segs */
 
 #define MMC_CMD_GO_IDLE_STATE		0
 #define MMC_CMD_SEND_OP_COND		1
@@ -422,6 +426,9 @@ struct mmc_data {
 	uint flags;
 	uint blocks;
 	uint blocksize;
+	/* only valid with MMC_DATA_SG, which replaces dest/src */
+	const struct blk_seg *segs;
+	uint nsegs;
 };
 
 /* forward decl. */
@@ -537,6 +544,33 @@ struct dm_mmc_ops {
 	 * @return 0 if success, -ve on error
 	 */
 	int (*hs400_prepare_ddr)(struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	/**
+	 * send_cmd_async() - Send a data command and start the transfer
+	 *		      without waiting for it to finish
+	 *
+	 * @dev:	Device to receive the command
+	 * @cmd:	Command to send
+	 * @data:	Data to receive, must stay valid until poll_data()
+	 *		reports completion
+	 * @return 0 if the transfer was started, -ENOSYS if it cannot be
+	 * done asynchronously, other -ve on error
+	 */
+	int (*send_cmd_async)(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data);
+
+	/**
+	 * poll_data() - Check whether a transfer started by
+	 *		 send_cmd_async() has finished
+	 *
+	 * @dev:	Device the command was sent to
+	 * @data:	Data passed to send_cmd_async()
+	 * @return 0 if finished, -EBUSY if still in progress, other -ve on
+	 * error
+	 */
+	int (*poll_data)(struct udevice *dev, struct mmc_data *data);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -553,6 +587,11 @@ int mmc_deferred_probe(struct mmc *mmc);
 int mmc_reinit(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
 int mmc_hs400_prepare_ddr(struct mmc *mmc);
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+int mmc_send_cmd_async(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data);
+int mmc_poll_data(struct mmc *mmc, struct mmc_data *data);
+#endif
 #else
 struct mmc_ops {
 	int (*send_cmd)(struct mmc *mmc,
@@ -730,6 +769,13 @@ struct mmc {
 	u8 hs400_tuning;
 
 	enum bus_mode user_speed_mode; /* input speed mode from user */
+#if CONFIG_IS_ENABLED(BLK_ASYNC) && CONFIG_IS_ENABLED(DM_MMC)
+	struct blk_req *async_req;	/* asynchronous read in progress */
+	struct mmc_data async_data;	/* data phase of the current chunk */
+	lbaint_t async_start;		/* first block of the current chunk */
+	lbaint_t async_todo;		/* blocks left, incl. current chunk */
+	uint async_b_max;		/* maximum blocks per chunk */
+#endif
 };
 
 #if CONFIG_IS_ENABLED(DM_MMC)
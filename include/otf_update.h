@@ -20,6 +20,7 @@
 #define OTF_FLAG_SPARSE		(1 << 2) /* target is a sparse image */
 #define OTF_FLAG_SPARSE_HDR 	(1 << 3) /* sparse header has been copied */
 #define OTF_FLAG_RAW_ONGOING 	(1 << 4) /* raw sparse chunk being flashed */
+#define OTF_FLAG_IDLE		(1 << 5) /* no new data, write in background */
 
 #ifdef CONFIG_FASTBOOT_FLASH
 typedef struct otf_sparse_data {
@@ -214,6 +214,19 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 int part_get_info_by_name(struct blk_desc *dev_desc,
 			      const char *name, struct disk_partition *info);
 
+/**
+ * part_get_info_by_uuid() - Search for a partition by UUID
+ *
+ * @param dev_desc - block device descriptor
+ * @param uuid - the partition UUID, as a string
+ * @param info - returns the disk partition info
+ *
+ * @return - the partition number on match (starting on 1), -ENOENT on no
+ * match, -ENOSYS if partition UUIDs are not supported, otherwise error
+ */
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  struct disk_partition *info);
+
 /**
  * Get partition info from dev number + part name, or dev number + part number.
  *
@@ -340,6 +353,30 @@ struct part_driver {
 	 *	   type, -ve if not
 	 */
 	int (*test)(struct blk_desc *dev_desc);
+
+	/**
+	 * get_info_by_name() - Find a partition by name (optional)
+	 *
+	 * @dev_desc:	Block device descriptor
+	 * @name:	Partition name to look for
+	 * @info:	Returns partition information
+	 * @return partition number (1 = first) if found, -ENOENT if there is
+	 *	   no such partition, other -ve value on error
+	 */
+	int (*get_info_by_name)(struct blk_desc *dev_desc, const char *name,
+				struct disk_partition *info);
+
+	/**
+	 * get_info_by_uuid() - Find a partition by UUID (optional)
+	 *
+	 * @dev_desc:	Block device descriptor
+	 * @uuid:	Partition UUID to look for, as a string
+	 * @info:	Returns partition information
+	 * @return partition number (1 = first) if found, -ENOENT if there is
+	 *	   no such partition, other -ve value on error
+	 */
+	int (*get_info_by_uuid)(struct blk_desc *dev_desc, const char *uuid,
+				struct disk_partition *info);
 };
 
 /* Declare a new U-Boot partition 'driver' */
@@ -488,6 +525,32 @@ int part_get_info_efi_by_name(struct blk_desc *dev_desc, const char *name,
 
 #endif
 
+#if CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+/**
+ * part_efi_cache_invalidate() - Drop the cached GPT of a device
+ *
+ * @param dev_desc - block device descriptor
+ */
+void part_efi_cache_invalidate(struct blk_desc *dev_desc);
+
+/**
+ * part_efi_cache_write() - Note a write to a device
+ *
+ * The cached GPT of the device is dropped if the write touches the primary
+ * or backup GPT, i.e. anything outside the usable LBA range.
+ *
+ * @param dev_desc - block device descriptor
+ * @param start - first block written
+ * @param blkcnt - number of blocks written
+ */
+void part_efi_cache_write(struct blk_desc *dev_desc, lbaint_t start,
+			  lbaint_t blkcnt);
+#else
+static inline void part_efi_cache_invalidate(struct blk_desc *dev_desc) {}
+static inline void part_efi_cache_write(struct blk_desc *dev_desc,
+					lbaint_t start, lbaint_t blkcnt) {}
+#endif
+
 #if CONFIG_IS_ENABLED(DOS_PARTITION)
 /**
  * is_valid_dos_buf() - Ensure that a DOS MBR image is valid
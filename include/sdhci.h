@@ -283,6 +283,11 @@ struct sdhci_ops {
 
 #define ADMA_TABLE_SZ (ADMA_TABLE_NO_ENTRIES * ADMA_DESC_LEN)
 
+/* Required alignment of scatter-gather segment addresses and lengths */
+#define ADMA_SG_ALIGN	4
+/* Bounce buffer for the partial cache lines at the ends of each segment */
+#define SDHCI_SG_BOUNCE_SIZE(nsegs)	((nsegs) * 2 * ARCH_DMA_MINALIGN)
+
 /* Decriptor table defines */
 #define ADMA_DESC_ATTR_VALID		BIT(0)
 #define ADMA_DESC_ATTR_END		BIT(1)
@@ -334,7 +339,10 @@ struct sdhci_host {
 	dma_addr_t adma_addr;
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 	struct sdhci_adma_desc *adma_desc_table;
+	void *sg_bounce;	/* partial cache lines of scatter-gather segments */
+	ulong sg_bounce_size;
 #endif
+	ulong async_start;	/* timer value when async transfer started */
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -508,5 +516,9 @@ extern const struct dm_mmc_ops sdhci_ops;
 struct sdhci_adma_desc *sdhci_adma_init(void);
 void sdhci_prepare_adma_table(struct sdhci_adma_desc *table,
 			      struct mmc_data *data, dma_addr_t addr);
+int sdhci_prepare_adma_table_sg(struct udevice *dev,
+				struct sdhci_adma_desc *table,
+				struct mmc_data *data, void *bounce);
+void sdhci_adma_sg_done(struct mmc_data *data, void *bounce);
 
 #endif /* __SDHCI_HW_H */
@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Streaming reads
+ *
+ * Rather than collecting data in one flat buffer and then making a second
+ * pass over it, a producer such as blk_dread_stream() or fs_read_stream()
+ * hands each chunk to a consumer (a "sink") as soon as it arrives. This
+ * allows loading, hashing and decompressing an image in a single pass.
+ */
+
+#ifndef __STREAM_H
+#define __STREAM_H
+
+#include <linux/types.h>
+#include <linux/zstd.h>
+
+/**
+ * struct stream_sink - consumer of streamed data
+ *
+ * Consumers embed this in their own state and use container_of() to get
+ * back to it. Producers are passed a pointer to the embedded member.
+ *
+ * @write:	Called for each chunk of data, in order. The data is only
+ *		valid until the function returns. Returns 0 to carry on, or
+ *		a -ve error number to stop the stream
+ */
+struct stream_sink {
+	int (*write)(struct stream_sink *sink, const void *buf, ulong len);
+};
+
+/**
+ * stream_write() - pass a chunk of data to a consumer
+ *
+ * @sink:	Consumer
+ * @buf:	Data
+ * @len:	Length of data in bytes
+ * @return 0 if OK, -ve error number if the consumer failed
+ */
+static inline int stream_write(struct stream_sink *sink, const void *buf,
+			       ulong len)
+{
+	return sink->write(sink, buf, len);
+}
+
+/**
+ * struct stream_copy - consumer which copies the data to memory
+ *
+ * @sink:	Stream consumer
+ * @dst:	Destination buffer
+ * @size:	Number of bytes copied so far
+ * @max:	Size of the destination buffer
+ */
+struct stream_copy {
+	struct stream_sink sink;
+	void *dst;
+	ulong size;
+	ulong max;
+};
+
+/**
+ * stream_copy_init() - set up a consumer which copies the data to memory
+ *
+ * The stream fails with -ENOSPC if more than @max bytes arrive.
+ *
+ * @sc:		Consumer to set up
+ * @dst:	Destination buffer
+ * @max:	Size of the destination buffer
+ */
+void stream_copy_init(struct stream_copy *sc, void *dst, ulong max);
+
+/**
+ * struct stream_zstd - consumer which decompresses zstd data to memory
+ *
+ * @sink:	Stream consumer
+ * @dstream:	Decompression context, or NULL until the frame header has
+ *		arrived
+ * @workspace:	Memory used by @dstream, sized for the window of the frame
+ * @hdr:	Start of the data, collected until the frame header is complete
+ * @hdr_len:	Number of bytes in @hdr
+ * @dst:	Destination buffer
+ * @size:	Number of bytes decompressed so far
+ * @max:	Size of the destination buffer
+ * @done:	true once the end of the frame has been seen
+ */
+struct stream_zstd {
+	struct stream_sink sink;
+	void *dstream;
+	void *workspace;
+	u8 hdr[ZSTD_FRAMEHEADERSIZE_MAX];
+	uint hdr_len;
+	void *dst;
+	ulong size;
+	ulong max;
+	bool done;
+};
+
+/**
+ * stream_zstd_init() - set up a consumer which decompresses zstd data
+ *
+ * The memory needed depends on the window size of the frame, so it is not
+ * allocated until the frame header arrives. The stream fails with -ENOMEM
+ * if it cannot be allocated, or -ENOSPC if more than @max bytes are output.
+ *
+ * @sz:		Consumer to set up
+ * @dst:	Destination buffer for the decompressed data
+ * @max:	Size of the destination buffer
+ * @return 0 if OK
+ */
+int stream_zstd_init(struct stream_zstd *sz, void *dst, ulong max);
+
+/**
+ * stream_zstd_finish() - finish decompressing and free the consumer
+ *
+ * @sz:		Consumer set up by stream_zstd_init()
+ * @sizep:	Returns the number of bytes decompressed
+ * @return 0 if OK, -ENOSPC if the output did not fit, -EINVAL if the frame
+ * was truncated
+ */
+int stream_zstd_finish(struct stream_zstd *sz, ulong *sizep);
+
+#endif
@@ -93,6 +93,29 @@ uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 void crc32_wd_buf(const uint8_t *input, uint ilen, uint8_t *output,
 		  uint chunk_sz);
 
+/* arch/arm/lib/crc32-arm64.c */
+
+/**
+ * crc32_arm64_present() - Check for the ARMv8 CRC32 instructions
+ *
+ * @return true if the CPU has them
+ */
+bool crc32_arm64_present(void);
+
+/**
+ * crc32_arm64() - Calculate the CRC32 with the ARMv8 CRC32 instructions
+ *
+ * This gives the same result as crc32_no_comp(). Only call it if
+ * crc32_arm64_present() returns true.
+ *
+ * @crc: Input crc to chain from a previous calculution (use 0 to start a new
+ *	calculation)
+ * @buf: Bytes to checksum
+ * @len: Number of bytes to checksum
+ * @return checksum value
+ */
+uint32_t crc32_arm64(uint32_t crc, const unsigned char *buf, uint len);
+
 /* lib/crc32c.c */
 
 /**
@@ -60,6 +60,21 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
  */
 void sha1_finish( sha1_context *ctx, unsigned char output[20] );
 
+/**
+ * sha1_arch_process() - Hash blocks using CPU-specific instructions
+ *
+ * Architectures with SHA-1 instructions override this weak function.
+ * It must check at run time that the CPU has them.
+ *
+ * @state:	Hash state, updated with the result
+ * @data:	Data to hash
+ * @blocks:	Number of 64-byte blocks in @data
+ * Return:	0 if OK, -ENOSYS if the CPU cannot do it, in which case
+ *		@state is unchanged
+ */
+int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+		      unsigned int blocks);
+
 /**
  * \brief	   Output = SHA-1( input buffer )
  *
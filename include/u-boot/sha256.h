@@ -19,6 +19,21 @@ void sha256_starts(sha256_context * ctx);
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length);
 void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 
+/**
+ * sha256_arch_process() - Hash blocks using CPU-specific instructions
+ *
+ * Architectures with SHA-256 instructions override this weak function.
+ * It must check at run time that the CPU has them.
+ *
+ * @state:	Hash state, updated with the result
+ * @data:	Data to hash
+ * @blocks:	Number of 64-byte blocks in @data
+ * Return:	0 if OK, -ENOSYS if the CPU cannot do it, in which case
+ *		@state is unchanged
+ */
+int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			unsigned int blocks);
+
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
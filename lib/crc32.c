@@ -170,6 +170,37 @@ const uint32_t * ZEXPORT get_crc_table()
 }
 #endif
 
+#ifndef USE_HOSTCC
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8) && __BYTE_ORDER == __LITTLE_ENDIAN
+#define CRC_SLICE_BY_8
+#endif
+#endif
+
+#ifdef CRC_SLICE_BY_8
+/*
+ * crc_slice[k][n] is the CRC of byte n followed by k + 1 zero bytes. This
+ * allows eight bytes to be processed at a time with independent lookups
+ * ("slice-by-8"), instead of one byte after the other.
+ */
+static int __efi_runtime_data crc_slice_empty = 1;
+static uint32_t __efi_runtime_data crc_slice[7][256];
+
+static void __efi_runtime make_crc_slice(void)
+{
+	uint32_t c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = crc_table[n];
+		for (k = 0; k < 7; k++) {
+			c = crc_table[c & 255] ^ (c >> 8);
+			crc_slice[k][n] = c;
+		}
+	}
+	crc_slice_empty = 0;
+}
+#endif
+
 /* ========================================================================= */
 # if __BYTE_ORDER == __LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[(crc ^ (x)) & 255] ^ (crc >> 8)
@@ -187,9 +218,17 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
     size_t rem_len;
+#if defined(CONFIG_CRC32_ARM64) && !defined(USE_HOSTCC)
+    if (crc32_arm64_present())
+      return crc32_arm64(crc, buf, len);
+#endif
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
     if (crc_table_empty)
       make_crc_table();
+#endif
+#ifdef CRC_SLICE_BY_8
+    if (crc_slice_empty)
+      make_crc_slice();
 #endif
     crc = cpu_to_le32(crc);
     /* Align it */
@@ -201,6 +240,18 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CRC_SLICE_BY_8
+    for (; len >= 8; len -= 8) {
+	 uint32_t lo = *b++ ^ crc;
+	 uint32_t hi = *b++;
+
+	 crc = crc_slice[6][lo & 255] ^ crc_slice[5][(lo >> 8) & 255] ^
+	       crc_slice[4][(lo >> 16) & 255] ^ crc_slice[3][lo >> 24] ^
+	       crc_slice[2][hi & 255] ^ crc_slice[1][(hi >> 8) & 255] ^
+	       crc_slice[0][(hi >> 16) & 255] ^ tab[hi >> 24];
+    }
+#endif
+
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -53,6 +53,10 @@ static char *basename(struct file_handle *fh)
 	return fh->path;
 }
 
+/*
+ * Select the file system of the handle. The file system stays mounted
+ * between calls (see CONFIG_FS_KEEP_MOUNTED), so this is cheap.
+ */
 static int set_blk_dev(struct file_handle *fh)
 {
 	return fs_set_blk_dev_with_part(fh->fs->desc, fh->fs->part);
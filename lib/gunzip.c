@@ -15,6 +15,7 @@
 #include <memalign.h>
 #include <u-boot/crc.h>
 #include <watchdog.h>
+#include <linux/errno.h>
 #include <u-boot/zlib.h>
 
 #define HEADER0			'\x1f'
@@ -82,6 +83,87 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 	return zunzip(dst, dstlen, src, lenp, 1, offset);
 }
 
+static int gunzip_stream_write(struct stream_sink *sink, const void *buf,
+			       ulong len)
+{
+	struct gunzip_stream *gs = container_of(sink, struct gunzip_stream,
+						sink);
+	z_stream *s = gs->zs;
+	int r;
+
+	/* anything after the end of the gzip stream is padding */
+	if (gs->done)
+		return 0;
+
+	s->next_in = (unsigned char *)buf;
+	s->avail_in = len;
+	do {
+		/* zlib counts in uInt, so hand over the space in pieces */
+		s->next_out = gs->dst + gs->size;
+		s->avail_out = min_t(ulong, gs->max - gs->size, UINT_MAX);
+		r = inflate(s, Z_NO_FLUSH);
+		gs->size = s->next_out - (unsigned char *)gs->dst;
+		if (r == Z_STREAM_END) {
+			gs->done = true;
+			break;
+		}
+		if (r == Z_BUF_ERROR) {
+			/* no progress is possible */
+			if (gs->size == gs->max)
+				return -ENOSPC;
+			break;
+		}
+		if (r != Z_OK) {
+			printf("Error: inflate() returned %d\n", r);
+			return -EINVAL;
+		}
+	} while (s->avail_in);
+
+	return 0;
+}
+
+int gunzip_stream_init(struct gunzip_stream *gs, void *dst, ulong max)
+{
+	int r;
+
+	gs->zs = calloc(1, sizeof(*gs->zs));
+	if (!gs->zs)
+		return -ENOMEM;
+	gs->zs->zalloc = gzalloc;
+	gs->zs->zfree = gzfree;
+
+	/* let zlib parse the gzip header, which may span several chunks */
+	r = inflateInit2(gs->zs, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(gs->zs);
+		gs->zs = NULL;
+		return -EINVAL;
+	}
+
+	gs->sink.write = gunzip_stream_write;
+	gs->dst = dst;
+	gs->size = 0;
+	gs->max = max;
+	gs->done = false;
+
+	return 0;
+}
+
+int gunzip_stream_finish(struct gunzip_stream *gs, ulong *sizep)
+{
+	*sizep = gs->size;
+	if (gs->zs) {
+		inflateEnd(gs->zs);
+		free(gs->zs);
+		gs->zs = NULL;
+	}
+	if (gs->done)
+		return 0;
+
+	return gs->size == gs->max ? -ENOSPC : -EINVAL;
+}
+
 #ifdef CONFIG_CMD_UNZIP
 __weak
 void gzwrite_progress_init(u64 expectedsize)
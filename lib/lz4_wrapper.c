@@ -7,6 +7,8 @@
 #include <compiler.h>
 #include <image.h>
 #include <lz4.h>
+#include <malloc.h>
+#include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <asm/unaligned.h>
@@ -111,7 +113,8 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		} else {
 			/* constant folding essential, do not touch params! */
 			ret = LZ4_decompress_generic(in, out, block_size,
-					end - out, endOnInputSize,
+					min_t(size_t, end - out, INT_MAX),
+					endOnInputSize,
 					full, 0, noDict, out, NULL, 0);
 			if (ret < 0) {
 				ret = -EPROTO;	/* decompression error */
@@ -128,3 +131,174 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	*dstn = out - dst;
 	return ret;
 }
+
+/* Parts of a frame, in the order they arrive */
+enum {
+	LZ4S_FRAME,		/* magic, flags and block descriptor */
+	LZ4S_FRAME_REST,	/* content size and header checksum */
+	LZ4S_BLOCK_HEADER,
+	LZ4S_BLOCK,
+	LZ4S_BLOCK_CHECKSUM,
+	LZ4S_DONE,
+};
+
+static int lz4_stream_frame(struct lz4_stream *ls, const u8 *in)
+{
+	u8 flags = in[4];
+	u8 block_desc = in[5];
+	u8 block_id = (block_desc >> 4) & 0x7;
+
+	if (get_unaligned_le32(in) != LZ4F_MAGIC || ((flags >> 6) & 0x3) != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if ((flags & 0x03) || (block_desc & 0x8f) || block_id < 4)
+		return -EINVAL;
+	if (!((flags >> 5) & 0x1))
+		return -EPROTONOSUPPORT;	/* dependent blocks */
+
+	ls->block_checksum = (flags >> 4) & 0x1;
+	ls->buf_size = 1U << (8 + 2 * block_id);
+	ls->buf = malloc(ls->buf_size);
+	if (!ls->buf)
+		return -ENOMEM;
+
+	/* the content size if present, then the header checksum */
+	ls->need = ((flags >> 3) & 0x1 ? sizeof(u64) : 0) + sizeof(u8);
+	ls->state = LZ4S_FRAME_REST;
+
+	return 0;
+}
+
+static int lz4_stream_block(struct lz4_stream *ls, const void *in)
+{
+	ulong room = ls->max - ls->size;
+	u32 block_size = ls->need;
+	void *out = ls->dst + ls->size;
+	int ret;
+
+	if (ls->block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
+		if (block_size > room)
+			return -ENOSPC;
+		memcpy(out, in, block_size);
+		ret = block_size;
+	} else {
+		/*
+		 * A block never decompresses to more than buf_size bytes, so
+		 * that is the output size. If there is less room than that,
+		 * decompress aside so that running out of room can be told
+		 * from a corrupt block.
+		 */
+		if (room < ls->buf_size) {
+			if (!ls->tail)
+				ls->tail = malloc(ls->buf_size);
+			if (!ls->tail)
+				return -ENOMEM;
+			out = ls->tail;
+		}
+		/* constant folding essential, do not touch params! */
+		ret = LZ4_decompress_generic(in, out, block_size,
+					     ls->buf_size, endOnInputSize,
+					     full, 0, noDict, out, NULL, 0);
+		if (ret < 0)
+			return -EPROTO;
+		if (ret > room)
+			return -ENOSPC;
+		if (out == ls->tail)
+			memcpy(ls->dst + ls->size, out, ret);
+	}
+	ls->size += ret;
+
+	ls->state = ls->block_checksum ? LZ4S_BLOCK_CHECKSUM :
+		    LZ4S_BLOCK_HEADER;
+	ls->need = sizeof(u32);
+
+	return 0;
+}
+
+static int lz4_stream_part(struct lz4_stream *ls, const void *in)
+{
+	u32 block_size;
+
+	switch (ls->state) {
+	case LZ4S_FRAME:
+		return lz4_stream_frame(ls, in);
+	case LZ4S_FRAME_REST:
+	case LZ4S_BLOCK_CHECKSUM:
+		/* checksums are not checked, as with ulz4fn() */
+		ls->state = LZ4S_BLOCK_HEADER;
+		ls->need = sizeof(u32);
+		return 0;
+	case LZ4S_BLOCK_HEADER:
+		ls->block_header = get_unaligned_le32(in);
+		block_size = ls->block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		if (!block_size) {
+			ls->state = LZ4S_DONE;
+			return 0;
+		}
+		if (block_size > ls->buf_size)
+			return -EINVAL;
+		ls->state = LZ4S_BLOCK;
+		ls->need = block_size;
+		return 0;
+	case LZ4S_BLOCK:
+		return lz4_stream_block(ls, in);
+	}
+
+	return -EINVAL;
+}
+
+static int lz4_stream_write(struct stream_sink *sink, const void *buf,
+			    ulong len)
+{
+	struct lz4_stream *ls = container_of(sink, struct lz4_stream, sink);
+	const void *in;
+	void *part;
+	ulong count;
+	int ret;
+
+	/* anything after the end mark, e.g. a content checksum, is ignored */
+	while (len && ls->state != LZ4S_DONE) {
+		if (!ls->have && len >= ls->need) {
+			/* all of the next part is here, so use it in place */
+			in = buf;
+			count = ls->need;
+		} else {
+			part = ls->need > sizeof(ls->hdr) ? ls->buf : ls->hdr;
+			count = min_t(ulong, ls->need - ls->have, len);
+			memcpy(part + ls->have, buf, count);
+			ls->have += count;
+			if (ls->have < ls->need)
+				return 0;
+			in = part;
+			ls->have = 0;
+		}
+		buf += count;
+		len -= count;
+
+		ret = lz4_stream_part(ls, in);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+void lz4_stream_init(struct lz4_stream *ls, void *dst, ulong max)
+{
+	memset(ls, '\0', sizeof(*ls));
+	ls->sink.write = lz4_stream_write;
+	ls->dst = dst;
+	ls->max = max;
+	ls->state = LZ4S_FRAME;
+	ls->need = sizeof(u32) + 2 * sizeof(u8);
+}
+
+int lz4_stream_finish(struct lz4_stream *ls, ulong *sizep)
+{
+	free(ls->buf);
+	free(ls->tail);
+	ls->buf = NULL;
+	ls->tail = NULL;
+	*sizep = ls->size;
+
+	return ls->state == LZ4S_DONE ? 0 : -EINVAL;
+}
@@ -18,6 +18,7 @@
 
 #ifndef USE_HOSTCC
 #include <common.h>
+#include <linux/errno.h>
 #include <linux/string.h>
 #else
 #include <string.h>
@@ -65,7 +66,7 @@ void sha1_starts (sha1_context * ctx)
 	ctx->state[4] = 0xC3D2E1F0;
 }
 
-static void sha1_process(sha1_context *ctx, const unsigned char data[64])
+static void sha1_process_one(sha1_context *ctx, const unsigned char data[64])
 {
 	unsigned long temp, W[16], A, B, C, D, E;
 
@@ -219,9 +220,39 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 	ctx->state[4] += E;
 }
 
+#ifndef USE_HOSTCC
+__weak int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+			     unsigned int blocks)
+{
+	return -ENOSYS;
+}
+#endif
+
 /*
  * SHA-1 process buffer
  */
+static void sha1_process(sha1_context *ctx, const unsigned char *data,
+			 unsigned int blocks)
+{
+#ifndef USE_HOSTCC
+	uint32_t state[5];
+	int i;
+
+	/* the context holds the state as unsigned long */
+	for (i = 0; i < 5; i++)
+		state[i] = ctx->state[i];
+	if (!sha1_arch_process(state, data, blocks)) {
+		for (i = 0; i < 5; i++)
+			ctx->state[i] = state[i];
+		return;
+	}
+#endif
+	while (blocks--) {
+		sha1_process_one(ctx, data);
+		data += 64;
+	}
+}
+
 void sha1_update(sha1_context *ctx, const unsigned char *input,
 		 unsigned int ilen)
 {
@@ -242,16 +273,16 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
 
 	if (left && ilen >= fill) {
 		memcpy ((void *) (ctx->buffer + left), (void *) input, fill);
-		sha1_process (ctx, ctx->buffer);
+		sha1_process(ctx, ctx->buffer, 1);
 		input += fill;
 		ilen -= fill;
 		left = 0;
 	}
 
-	while (ilen >= 64) {
-		sha1_process (ctx, input);
-		input += 64;
-		ilen -= 64;
+	if (ilen >= 64) {
+		sha1_process(ctx, input, ilen / 64);
+		input += ilen & ~0x3f;
+		ilen &= 0x3f;
 	}
 
 	if (ilen > 0) {
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Consumers for streaming reads, see include/stream.h
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <stream.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/zstd.h>
+
+static int stream_copy_write(struct stream_sink *sink, const void *buf,
+			     ulong len)
+{
+	struct stream_copy *sc = container_of(sink, struct stream_copy, sink);
+
+	if (len > sc->max - sc->size)
+		return -ENOSPC;
+	memcpy(sc->dst + sc->size, buf, len);
+	sc->size += len;
+
+	return 0;
+}
+
+void stream_copy_init(struct stream_copy *sc, void *dst, ulong max)
+{
+	sc->sink.write = stream_copy_write;
+	sc->dst = dst;
+	sc->size = 0;
+	sc->max = max;
+}
+
+#if CONFIG_IS_ENABLED(ZSTD)
+static int stream_zstd_decomp(struct stream_zstd *sz, const void *buf,
+			      ulong len)
+{
+	ZSTD_inBuffer in_buf;
+	ZSTD_outBuffer out_buf;
+	size_t ret, pos;
+
+	in_buf.src = buf;
+	in_buf.pos = 0;
+	in_buf.size = len;
+
+	/* the output goes straight into the destination buffer */
+	out_buf.dst = sz->dst;
+	out_buf.pos = sz->size;
+	out_buf.size = sz->max;
+
+	/* anything after the end of the frame is padding */
+	while (!sz->done && in_buf.pos < in_buf.size) {
+		pos = in_buf.pos;
+		ret = ZSTD_decompressStream(sz->dstream, &out_buf, &in_buf);
+		if (ZSTD_isError(ret)) {
+			log_debug("ZSTD_decompressStream error %d\n",
+				  ZSTD_getErrorCode(ret));
+			return -EINVAL;
+		}
+		if (!ret)
+			sz->done = true;
+		else if (in_buf.pos == pos && out_buf.pos == out_buf.size)
+			return -ENOSPC;
+	}
+	sz->size = out_buf.pos;
+
+	return 0;
+}
+
+/*
+ * Set up the decompression context once the frame header is complete, with
+ * a window as big as the frame asks for
+ */
+static int stream_zstd_start(struct stream_zstd *sz)
+{
+	ZSTD_frameParams params;
+	size_t ret, wsize;
+
+	ret = ZSTD_getFrameParams(&params, sz->hdr, sz->hdr_len);
+	if (ZSTD_isError(ret)) {
+		log_debug("ZSTD_getFrameParams error %d\n",
+			  ZSTD_getErrorCode(ret));
+		return -EINVAL;
+	}
+	if (ret)
+		return sz->hdr_len < sizeof(sz->hdr) ? 0 : -EINVAL;
+	if (!params.windowSize)
+		return -EINVAL;		/* skippable frame */
+
+	wsize = ZSTD_DStreamWorkspaceBound(params.windowSize);
+	sz->workspace = malloc(wsize);
+	if (!sz->workspace)
+		return -ENOMEM;
+	sz->dstream = ZSTD_initDStream(params.windowSize, sz->workspace,
+				       wsize);
+	if (!sz->dstream)
+		return -EINVAL;
+
+	return stream_zstd_decomp(sz, sz->hdr, sz->hdr_len);
+}
+
+static int stream_zstd_write(struct stream_sink *sink, const void *buf,
+			     ulong len)
+{
+	struct stream_zstd *sz = container_of(sink, struct stream_zstd, sink);
+	ulong count;
+	int ret;
+
+	/* collect the frame header, which may span several chunks */
+	if (!sz->dstream) {
+		count = min_t(ulong, len, sizeof(sz->hdr) - sz->hdr_len);
+		memcpy(sz->hdr + sz->hdr_len, buf, count);
+		sz->hdr_len += count;
+		buf += count;
+		len -= count;
+
+		ret = stream_zstd_start(sz);
+		if (ret || !sz->dstream)
+			return ret;
+	}
+
+	return stream_zstd_decomp(sz, buf, len);
+}
+
+int stream_zstd_init(struct stream_zstd *sz, void *dst, ulong max)
+{
+	sz->sink.write = stream_zstd_write;
+	sz->dstream = NULL;
+	sz->workspace = NULL;
+	sz->hdr_len = 0;
+	sz->dst = dst;
+	sz->size = 0;
+	sz->max = max;
+	sz->done = false;
+
+	return 0;
+}
+
+int stream_zstd_finish(struct stream_zstd *sz, ulong *sizep)
+{
+	free(sz->workspace);
+	sz->workspace = NULL;
+	*sizep = sz->size;
+	if (sz->done)
+		return 0;
+
+	/* a full buffer means the frame did not fit, not that it was cut off */
+	return sz->size == sz->max ? -ENOSPC : -EINVAL;
+}
+#endif
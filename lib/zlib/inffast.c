@@ -12,24 +12,65 @@
 
 #ifndef ASMINF
 
-/* Allow machine dependent optimization for post-increment or pre-increment.
-   Based on testing to date,
-   Pre-increment preferred for:
-   - PowerPC G3 (Adler)
-   - MIPS R5000 (Randers-Pehrson)
-   Post-increment preferred for:
-   - none
-   No measurable difference:
-   - Pentium III (Anderson)
-   - M68060 (Nikl)
+/* Number of bits in the bit buffer */
+#define HOLD_BITS       (8 * sizeof(unsigned long))
+
+/* Fill the bit buffer to at least HOLD_BITS - 7 bits. The input is read a
+   byte at a time, since U-Boot may run with alignment checking enabled, but
+   the buffer is filled in one go rather than two bytes per code. */
+#define REFILL() \
+    do { \
+        while (bits < HOLD_BITS - 7) { \
+            hold += (unsigned long)(*in++) << bits; \
+            bits += 8; \
+        } \
+    } while (0)
+
+/* Matches at least this long are copied with memcpy()/memset() */
+#define LONG_COPY       16
+
+/*
+   Copy a match of len bytes from dist bytes back in the output. The source
+   and destination overlap when dist < len, in which case the bytes repeat
+   with a period of dist. Long copies go through memset() for a run of one
+   byte, otherwise through memcpy() in chunks that double in size, so that
+   each chunk never overlaps what it copies from.
  */
-#ifdef POSTINC
-#  define OFF 0
-#  define PUP(a) *(a)++
-#else
-#  define OFF 1
-#  define PUP(a) *++(a)
-#endif
+local unsigned char FAR *copy_match(unsigned char FAR *out, unsigned dist,
+                                    unsigned len)
+{
+    unsigned char FAR *from = out - dist;
+    unsigned chunk;
+
+    if (len < LONG_COPY) {
+        while (len > 2) {
+            *out++ = *from++;
+            *out++ = *from++;
+            *out++ = *from++;
+            len -= 3;
+        }
+        if (len) {
+            *out++ = *from++;
+            if (len > 1)
+                *out++ = *from++;
+        }
+        return out;
+    }
+
+    if (dist == 1) {
+        zmemset(out, *from, len);
+        return out + len;
+    }
+
+    for (chunk = dist; len > chunk; chunk <<= 1) {
+        zmemcpy(out, out - chunk, chunk);
+        out += chunk;
+        len -= chunk;
+    }
+    zmemcpy(out, out - chunk, len);
+
+    return out + len;
+}
 
 /*
    Decode literal, length, and distance codes and write out the resulting
@@ -42,8 +83,8 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_HAVE
+        strm->avail_out >= INFLATE_FAST_MIN_LEFT
         start >= strm->avail_out
         state->bits < 8
 
@@ -58,13 +99,19 @@
     - The maximum input bits used by a length/distance pair is 15 bits for the
       length code, 5 bits for the length extra, 15 bits for the distance code,
       and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
-      Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+      The bit buffer is filled to a whole word at the start of each code, which
+      can read up to sizeof(long) bytes more. If strm->avail_in >=
+      INFLATE_FAST_MIN_HAVE, then there is enough input to avoid checking for
+      available input while decoding.
+
+    - With a 64-bit bit buffer, one fill holds a whole length/distance pair.
+      With a 32-bit one, the buffer is filled again before the distance code
+      and, if needed, before the distance extra bits.
 
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
-      output space.
+      output space. Matches are copied exactly, never past their end.
  */
 void inflate_fast(z_streamp strm, unsigned start)
 /* start: inflate()'s starting value for strm->avail_out */
@@ -72,6 +119,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     struct inflate_state FAR *state;
     unsigned char FAR *in;      /* local strm->next_in */
     unsigned char FAR *last;    /* while in < last, enough input available */
+    unsigned char FAR *in_end;  /* end of the input */
     unsigned char FAR *out;     /* local strm->next_out */
     unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
     unsigned char FAR *end;     /* while out < end, enough space available */
@@ -97,19 +145,20 @@ void inflate_fast(z_streamp strm, unsigned start)
 
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
-    in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
-    if (in > last && strm->avail_in > 5) {
+    in = strm->next_in;
+    in_end = in + strm->avail_in;
+    if (in_end < in) {
         /*
          * overflow detected, limit strm->avail_in to the
-         * max. possible size and recalculate last
+         * max. possible size
          */
-	strm->avail_in = 0xffffffff - (uintptr_t)in;
-        last = in + (strm->avail_in - 5);
+        strm->avail_in = 0xffffffff - (uintptr_t)in;
+        in_end = in + strm->avail_in;
     }
-    out = strm->next_out - OFF;
+    last = in_end - (INFLATE_FAST_MIN_HAVE - 1);
+    out = strm->next_out;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_LEFT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -127,12 +176,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        REFILL();
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -143,27 +187,19 @@ void inflate_fast(z_streamp strm, unsigned start)
             Tracevv((stderr, this.val >= 0x20 && this.val < 0x7f ?
                     "inflate:         literal '%c'\n" :
                     "inflate:         literal 0x%02x\n", this.val));
-            PUP(out) = (unsigned char)(this.val);
+            *out++ = (unsigned char)(this.val);
         }
         else if (op & 16) {                     /* length base */
             len = (unsigned)(this.val);
             op &= 15;                           /* number of extra bits */
             if (op) {
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                }
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
-            if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-            }
+            if (bits < 15)
+                REFILL();
             this = dcode[hold & dmask];
           dodist:
             op = (unsigned)(this.bits);
@@ -173,14 +209,8 @@ void inflate_fast(z_streamp strm, unsigned start)
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                    if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
-                        bits += 8;
-                    }
-                }
+                if (bits < op)
+                    REFILL();
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -200,100 +230,34 @@ void inflate_fast(z_streamp strm, unsigned start)
                         state->mode = BAD;
                         break;
                     }
-                    from = window - OFF;
+                    from = window;
                     if (write == 0) {           /* very common case */
                         from += wsize - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
                     }
                     else if (write < op) {      /* wrap around window */
                         from += wsize + write - op;
                         op -= write;
                         if (op < len) {         /* some from end of window */
+                            zmemcpy(out, from, op);
+                            out += op;
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = window - OFF;
-                            if (write < len) {  /* some from start of window */
-                                op = write;
-                                len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
-                                from = out - dist;      /* rest from output */
-                            }
+                            from = window;
+                            op = write;
                         }
                     }
                     else {                      /* contiguous in window */
                         from += write - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
-                    }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
                     }
+                    if (op > len)
+                        op = len;
+                    zmemcpy(out, from, op);     /* the rest of the window */
+                    out += op;
+                    len -= op;
+                    if (len)                    /* rest from output */
+                        out = copy_match(out, dist, len);
                 }
-                else {
-		    unsigned short *sout;
-		    unsigned long loops;
-
-                    from = out - dist;          /* copy direct from output */
-                    /* minimum length is three */
-		    /* Align out addr */
-		    if (!((long)(out - 1 + OFF) & 1)) {
-			PUP(out) = PUP(from);
-			len--;
-		    }
-		    sout = (unsigned short *)(out - OFF);
-		    if (dist > 2 ) {
-			unsigned short *sfrom;
-
-			sfrom = (unsigned short *)(from - OFF);
-			loops = len >> 1;
-			do
-			    PUP(sout) = get_unaligned(++sfrom);
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-			from = (unsigned char *)sfrom + OFF;
-		    } else { /* dist == 1 or dist == 2 */
-			unsigned short pat16;
-
-			pat16 = *(sout-2+2*OFF);
-			if (dist == 1)
-#if defined(__BIG_ENDIAN)
-			    pat16 = (pat16 & 0xff) | ((pat16 & 0xff ) << 8);
-#elif defined(__LITTLE_ENDIAN)
-			    pat16 = (pat16 & 0xff00) | ((pat16 & 0xff00 ) >> 8);
-#else
-#error __BIG_ENDIAN nor __LITTLE_ENDIAN is defined
-#endif
-			loops = len >> 1;
-			do
-			    PUP(sout) = pat16;
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-		    }
-		    if (len & 1)
-			PUP(out) = PUP(from);
+                else {                          /* copy direct from output */
+                    out = copy_match(out, dist, len);
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -322,18 +286,17 @@ void inflate_fast(z_streamp strm, unsigned start)
         }
     } while (in < last && out < end);
 
-    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
+    /* return unused bytes, which were read but not decoded */
     len = bits >> 3;
     in -= len;
     bits -= len << 3;
     hold &= (1U << bits) - 1;
 
     /* update state and return */
-    strm->next_in = in + OFF;
-    strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
-    strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in_end - in);
+    strm->avail_out = (unsigned)(end - out) + (INFLATE_FAST_MIN_LEFT - 1);
     state->hold = hold;
     state->bits = bits;
     return;
@@ -8,4 +8,9 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* Input and output inflate_fast() needs to decode a length/distance pair
+   without checking for the end of either buffer, see inffast.c */
+#define INFLATE_FAST_MIN_HAVE   (8 + sizeof(unsigned long))
+#define INFLATE_FAST_MIN_LEFT   258
+
 void inflate_fast OF((z_streamp strm, unsigned start));
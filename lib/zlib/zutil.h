@@ -91,6 +91,7 @@ extern const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
 #include <linux/string.h>
 #define zmemcpy memcpy
 #define zmemcmp memcmp
+#define zmemset memset
 #define zmemzero(dest, len) memset(dest, 0, len)
 
 /* Diagnostic functions */
@@ -263,6 +263,24 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	return 0;
 }
 
+/*
+ * OTF: let the hook get on with writing buffered data to the media while
+ * the server sends more.
+ */
+static int tftp_otf_idle(void)
+{
+	int ret;
+
+	otfd.len = 0;
+	otfd.flags |= OTF_FLAG_IDLE;
+	ret = otf_update_hook(&otfd);
+	otfd.flags &= ~OTF_FLAG_IDLE;
+	if (ret)
+		printf("Error writing on-the-fly. Aborting\n");
+
+	return ret;
+}
+
 #ifdef CONFIG_TFTP_UPDATE_ONTHEFLY
 static __inline__ void
 store_block_to_ram (ulong ramAddress, uchar * src, unsigned len)
@@ -924,6 +942,11 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (tftp_cur_block == tftp_next_ack) {
 			tftp_send();
 			tftp_next_ack += tftp_windowsize;
+			/* OTF: write to media while the next window arrives */
+			if (otf_update_hook != NULL && tftp_otf_idle()) {
+				eth_halt();
+				net_set_state(NETLOOP_FAIL);
+			}
 		}
 		break;
 
@@ -7,7 +7,13 @@
 
 #include <common.h>
 #include <bootm.h>
+#include <command.h>
+#include <gzip.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
 #include <asm/global_data.h>
+#include <linux/libfdt.h>
 #include <test/suites.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -238,6 +244,145 @@ static int bootm_test_subst_both(struct unit_test_state *uts)
 }
 BOOTM_TEST(bootm_test_subst_both, 0);
 
+#if IS_ENABLED(CONFIG_CMD_BOOTM) && CONFIG_IS_ENABLED(FIT) && \
+	IS_ENABLED(CONFIG_GZIP_COMPRESSED)
+enum {
+	FIT_ADDR	= 0x100000,
+	FIT_SIZE	= 0x10000,
+	PLAIN_SIZE	= 0x8000,
+};
+
+/**
+ * setup_fit() - write a FIT holding a gzip-compressed kernel at FIT_ADDR
+ *
+ * The kernel is set to load at the start of its compressed data, or at
+ * @load if non-zero
+ *
+ * @comp: Compressed kernel
+ * @comp_size: Size of compressed kernel
+ * @external: true to put the kernel data after the FIT structure
+ * @load: Load address, or 0 to use the address of the kernel data
+ * @return 0 if OK, non-zero on failure
+ */
+static int setup_fit(struct unit_test_state *uts, const void *comp,
+		     ulong comp_size, bool external, ulong load)
+{
+	void *fit = map_sysmem(FIT_ADDR, FIT_SIZE);
+	const void *data;
+	size_t size;
+	int noffset;
+
+	ut_assertok(fdt_create(fit, FIT_SIZE));
+	ut_assertok(fdt_finish_reservemap(fit));
+	ut_assertok(fdt_begin_node(fit, ""));
+	ut_assertok(fdt_property_string(fit, FIT_DESC_PROP, "test"));
+	ut_assertok(fdt_property_u32(fit, FIT_TIMESTAMP_PROP, 0));
+	ut_assertok(fdt_begin_node(fit, "images"));
+	ut_assertok(fdt_begin_node(fit, "kernel"));
+	ut_assertok(fdt_property_string(fit, FIT_TYPE_PROP, "kernel"));
+	ut_assertok(fdt_property_string(fit, FIT_ARCH_PROP, "sandbox"));
+	ut_assertok(fdt_property_string(fit, FIT_OS_PROP, "linux"));
+	ut_assertok(fdt_property_string(fit, FIT_COMP_PROP, "gzip"));
+	ut_assertok(fdt_property_u32(fit, FIT_LOAD_PROP, load));
+	ut_assertok(fdt_property_u32(fit, FIT_ENTRY_PROP, load));
+	if (external) {
+		ut_assertok(fdt_property_u32(fit, FIT_DATA_OFFSET_PROP, 0));
+		ut_assertok(fdt_property_u32(fit, FIT_DATA_SIZE_PROP,
+					     comp_size));
+	} else {
+		ut_assertok(fdt_property(fit, FIT_DATA_PROP, comp, comp_size));
+	}
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_begin_node(fit, "configurations"));
+	ut_assertok(fdt_property_string(fit, FIT_DEFAULT_PROP, "conf"));
+	ut_assertok(fdt_begin_node(fit, "conf"));
+	ut_assertok(fdt_property_string(fit, FIT_KERNEL_PROP, "kernel"));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_finish(fit));
+	if (external)
+		memcpy(fit + ALIGN(fdt_totalsize(fit), 4), comp, comp_size);
+
+	if (!load) {
+		noffset = fdt_path_offset(fit, "/images/kernel");
+		ut_assert(noffset >= 0);
+		ut_assertok(fit_image_get_data_and_size(fit, noffset, &data,
+							&size));
+		load = map_to_sysmem(data);
+		ut_assertok(fdt_setprop_inplace_u32(fit, noffset, FIT_LOAD_PROP,
+						    load));
+		ut_assertok(fdt_setprop_inplace_u32(fit, noffset,
+						    FIT_ENTRY_PROP, load));
+	}
+
+	return 0;
+}
+
+/* Test loading a FIT kernel over its own compressed data */
+static int bootm_test_load_overlap(struct unit_test_state *uts)
+{
+	void *fit = map_sysmem(FIT_ADDR, FIT_SIZE);
+	ulong comp_size = PLAIN_SIZE;
+	u8 *plain, *comp, *copy;
+	int i;
+
+	plain = malloc(PLAIN_SIZE);
+	comp = malloc(comp_size);
+	copy = malloc(FIT_SIZE);
+	ut_assertnonnull(plain);
+	ut_assertnonnull(comp);
+	ut_assertnonnull(copy);
+	for (i = 0; i < PLAIN_SIZE; i++)
+		plain[i] = i * 7 + i / 251;
+	ut_assertok(gzip(comp, &comp_size, plain, PLAIN_SIZE));
+
+	/*
+	 * External data is not needed once decompressed, so the kernel can
+	 * be loaded on top of it
+	 */
+	ut_assertok(setup_fit(uts, comp, comp_size, true, 0));
+	ut_assertok(run_command("bootm start 100000", 0));
+	ut_assertok(bootm_load_os(&images, 0));
+	ut_asserteq(PLAIN_SIZE, images.os.image_len);
+	ut_asserteq_mem(plain, map_sysmem(images.os.load, PLAIN_SIZE),
+			PLAIN_SIZE);
+
+	/* Embedded data is followed by the rest of the FIT, which must stay */
+	ut_assertok(setup_fit(uts, comp, comp_size, false, 0));
+	memcpy(copy, fit, FIT_SIZE);
+	ut_assertok(run_command("bootm start 100000", 0));
+	ut_asserteq(BOOTM_ERR_RESET, bootm_load_os(&images, 0));
+	ut_asserteq_mem(copy, fit, FIT_SIZE);
+
+	/* Likewise the start of the FIT, when loading just below it */
+	ut_assertok(setup_fit(uts, comp, comp_size, false,
+			      FIT_ADDR - PLAIN_SIZE / 2));
+	memcpy(copy, fit, FIT_SIZE);
+	ut_assertok(run_command("bootm start 100000", 0));
+	ut_asserteq(BOOTM_ERR_RESET, bootm_load_os(&images, 0));
+	ut_asserteq_mem(copy, fit, FIT_SIZE);
+
+	/* There is room for it lower down */
+	ut_assertok(setup_fit(uts, comp, comp_size, false,
+			      FIT_ADDR - PLAIN_SIZE));
+	memcpy(copy, fit, FIT_SIZE);
+	ut_assertok(run_command("bootm start 100000", 0));
+	ut_assertok(bootm_load_os(&images, 0));
+	ut_asserteq_mem(plain, map_sysmem(FIT_ADDR - PLAIN_SIZE, PLAIN_SIZE),
+			PLAIN_SIZE);
+	ut_asserteq_mem(copy, fit, FIT_SIZE);
+
+	free(copy);
+	free(comp);
+	free(plain);
+
+	return 0;
+}
+BOOTM_TEST(bootm_test_load_overlap, 0);
+#endif
+
 int do_ut_bootm(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	struct unit_test *tests = UNIT_TEST_SUITE_START(bootm_test);
@@ -6,12 +6,15 @@
 #include <common.h>
 #include <bootm.h>
 #include <command.h>
+#include <div64.h>
 #include <gzip.h>
 #include <image.h>
 #include <log.h>
 #include <lz4.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <stream.h>
+#include <time.h>
 #include <asm/io.h>
 
 #include <u-boot/zlib.h>
@@ -121,6 +124,89 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/*
+ * The benchmark corpus is plain[] repeated BENCH_COPIES times:
+ * for i in $(seq 64); do cat /tmp/plain.txt; done > /tmp/bench.txt
+ */
+#define BENCH_COPIES	64
+#define BENCH_SIZE	(BENCH_COPIES * (sizeof(plain) - 1))
+/* Number of times each compressed corpus is decompressed */
+#define BENCH_LOOPS	256
+
+/* lzma -z -c /tmp/bench.txt > /tmp/bench.lzma */
+static const char bench_lzma[] =
+	"\x5d\x00\x00\x80\x00\xff\xff\xff\xff\xff\xff\xff\xff\x00\x24\x88"
+	"\x08\x26\xd8\x41\xff\x99\xc8\xcf\x66\x3d\x80\xac\xba\x17\xf1\xc8"
+	"\xb9\xdf\x49\x37\xb1\x68\xa0\x2a\xdd\x63\xd1\xa7\xa3\x66\xf8\x15"
+	"\xef\xa6\x67\x8a\x14\x18\x80\xcb\xc7\xb1\xcb\x84\x6a\xb2\x51\x16"
+	"\xa1\x45\xa0\xd6\x3e\x55\x44\x8a\x5c\xa0\x7c\xe5\xa8\xbd\x04\x57"
+	"\x8f\x24\xfd\xb9\x34\x50\x83\x2f\xf3\x46\x3e\xb9\xb0\x00\x1a\xf5"
+	"\xd3\x86\x7e\x8f\x77\xd1\x5d\x0e\x7c\xe1\xac\xde\xf8\x65\x1f\x4d"
+	"\xce\x7f\xa7\x3d\xaa\xcf\x26\xa7\x58\x69\x1e\x4c\xea\x68\x8a\xe5"
+	"\x89\xd1\xdc\x4d\xc7\xe0\x07\x42\xbf\x0c\x9d\x06\xd7\x51\xa2\x0b"
+	"\x7c\x83\x35\xe1\x85\xdf\xee\xfb\xa3\xee\x2f\x47\x5f\x8b\x70\x2b"
+	"\xe1\x37\xf3\x16\xf6\x27\x54\x8a\x33\x72\x49\xea\x53\x7d\x60\x0b"
+	"\x21\x90\x66\xe7\x9e\x56\x61\x5d\xd8\xdc\x59\xf0\xac\x2f\xd6\x49"
+	"\x6b\x85\x40\x08\x1f\xdf\x26\x25\x3b\x72\x44\xb0\xb8\x21\x2f\xb3"
+	"\xd7\x9b\x24\x30\x78\x26\x44\x07\xc3\x33\xf8\x90\x14\x22\xe4\xb2"
+	"\x20\x5e\xdc\xc4\x66\x68\x03\xba\xb6\x3c\xb2\xfa\xa7\xb6\x66\x2a"
+	"\xf2\x54\x3f\x0e\x24\x89\xcc\x5e\x2b\x6c\xc6\x44\x65\xf7\xa6\x16"
+	"\xf1\xdb\xc0\xe0\x13\x3e\x0d\x16\x0e\xad\x61\xa9\xfb\x55\x5e\x39"
+	"\x1b\x1c\xbb\x10\xed\x19\xd4\x01\xbd\x6c\xea\x73\xfd\x75\x3b\xce";
+static const unsigned long bench_lzma_size = 288;
+
+/* lz4 -z /tmp/bench.txt > /tmp/bench.lz4 */
+static const char bench_lz4[] =
+	"\x04\x22\x4d\x18\x64\x40\xa7\x64\x01\x00\x00\xff\x19\x49\x20\x61"
+	"\x6d\x20\x61\x20\x68\x69\x67\x68\x6c\x79\x20\x63\x6f\x6d\x70\x72"
+	"\x65\x73\x73\x61\x62\x6c\x65\x20\x62\x69\x74\x20\x6f\x66\x20\x74"
+	"\x65\x78\x74\x2e\x0a\x28\x00\x3d\xf1\x25\x54\x68\x65\x72\x65\x20"
+	"\x61\x72\x65\x20\x6d\x61\x6e\x79\x20\x6c\x69\x6b\x65\x20\x6d\x65"
+	"\x2c\x20\x62\x75\x74\x20\x74\x68\x69\x73\x20\x6f\x6e\x65\x20\x69"
+	"\x73\x20\x6d\x69\x6e\x65\x2e\x0a\x49\x66\x20\x49\x20\x77\x32\x00"
+	"\xd1\x6e\x79\x20\x73\x68\x6f\x72\x74\x65\x72\x2c\x20\x74\x45\x00"
+	"\xf4\x0b\x77\x6f\x75\x6c\x64\x6e\x27\x74\x20\x62\x65\x20\x6d\x75"
+	"\x63\x68\x20\x73\x65\x6e\x73\x65\x20\x69\x6e\x0a\xcf\x00\x50\x69"
+	"\x6e\x67\x20\x6d\x12\x00\x00\x32\x00\xf0\x11\x20\x66\x69\x72\x73"
+	"\x74\x20\x70\x6c\x61\x63\x65\x2e\x20\x41\x74\x20\x6c\x65\x61\x73"
+	"\x74\x20\x77\x69\x74\x68\x20\x6c\x7a\x6f\x2c\x63\x00\xf5\x14\x77"
+	"\x61\x79\x2c\x0a\x77\x68\x69\x63\x68\x20\x61\x70\x70\x65\x61\x72"
+	"\x73\x20\x74\x6f\x20\x62\x65\x68\x61\x76\x65\x20\x70\x6f\x6f\x72"
+	"\x6c\x79\x4e\x00\x30\x61\x63\x65\x27\x01\x01\x95\x00\x01\x2d\x01"
+	"\x20\x0a\x6d\x42\x01\x3f\x67\x65\x73\x36\x01\x3f\x0f\x86\x01\x15"
+	"\x0f\x5e\x01\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xe7\x50\x67\x65\x73\x2e\x0a\x00"
+	"\x00\x00\x00\x14\x80\x12\x04";
+static const unsigned long bench_lz4_size = 375;
+
+/* zstd -c /tmp/bench.txt > /tmp/bench.zst */
+static const char bench_zstd[] =
+	"\x28\xb5\x2f\xfd\x64\x80\x56\xfd\x05\x00\x62\x8e\x26\x1a\x70\x17"
+	"\xb8\x0d\x0c\x53\x5c\x9d\xa7\xa5\x01\x2b\x08\x13\x7f\xb8\xf4\xf0"
+	"\x00\x00\x01\x1f\xd0\xbf\x5f\x0d\x7a\xc4\x54\x8f\xcc\x91\x7c\xc3"
+	"\xd6\x51\x29\x25\x7e\x81\xdd\x0b\xa7\xb5\x2a\x7b\x92\x98\xcf\xc0"
+	"\x5b\x8c\xb0\x6c\x59\x69\x16\xd2\xc1\xf1\x2d\x2e\x5e\xb5\x1f\x6f"
+	"\x80\x87\x1b\x76\x12\xaf\x2a\x3c\xfc\x5b\x27\xfa\xc8\x48\xa2\x49"
+	"\xf4\x35\xaf\x3e\x43\x41\x7e\xe1\x05\xc8\x81\xa3\xa4\x65\x2d\xa8"
+	"\xaf\x4a\xa7\x5e\xb9\x98\xf0\x41\x98\xe1\x89\xc8\x8a\x7e\x26\x2b"
+	"\xde\x7a\x95\xc2\xc2\x91\x4f\x80\xc7\x2b\x0d\xf9\xca\x7c\xf5\x13"
+	"\x30\xc3\x1a\x7c\x7d\x24\x2f\x16\xfe\x29\x4c\xf5\x2a\x41\xc9\xf0"
+	"\x3a\x87\xe0\xd9\x8c\xcc\x44\x0a\x00\xa7\x55\xd8\xee\x70\x8a\x12"
+	"\x7c\xce\xa2\x83\x59\x01\x30\x36\x8a\x8a\xa2\x18\xa5\x46\x38\x12"
+	"\xee\x53\x55\x2d\x44\x2f\x54\x95\x01\xbd\xcc\x18\x6d";
+static const unsigned long bench_zstd_size = 205;
+
+/*
+ * There is no lzop here, so the lzo corpus repeats the one block in
+ * lzo_compressed: a 47-byte header, the block, then a zero end marker
+ */
+#define LZO_HEADER_SIZE	47
+#define LZO_BLOCK_SIZE	(lzo_compressed_size - LZO_HEADER_SIZE - 4)
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -296,6 +382,28 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+#if CONFIG_IS_ENABLED(ZSTD)
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	struct stream_zstd sz;
+	ulong size;
+	int ret, err;
+
+	ret = stream_zstd_init(&sz, out, out_max);
+	if (ret)
+		return ret;
+	ret = stream_write(&sz.sink, in, in_size);
+	err = stream_zstd_finish(&sz, &size);
+	if (out_size)
+		*out_size = size;
+
+	return ret ? ret : err;
+}
+#endif
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -536,6 +644,216 @@ static int compression_test_bootm_none(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+/**
+ * run_stream_test() - Run tests on streaming decompression
+ *
+ * The compressed data is passed on in small pieces, so that headers and
+ * blocks are split across chunks.
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_stream_test(struct unit_test_state *uts, int comp_type,
+			   mutate_func compress)
+{
+	struct image_decomp_stream ids;
+	ulong compress_size = 1024;
+	char compress_buff[1024];
+	char uncompressed_buf[TEST_BUFFER_SIZE];
+	ulong unc_len, size, pos, len;
+	int ret, err = 0;
+
+	printf("Testing: %s\n", genimg_get_comp_name(comp_type));
+	unc_len = strlen(plain);
+	compress(uts, (void *)plain, unc_len, compress_buff, compress_size,
+		 &compress_size);
+
+	ut_assertok(image_decomp_stream_init(&ids, comp_type, uncompressed_buf,
+					     sizeof(uncompressed_buf)));
+	for (pos = 0; !err && pos < compress_size; pos += len) {
+		len = min(compress_size - pos, 7UL);
+		err = stream_write(ids.sink, compress_buff + pos, len);
+	}
+	ut_assertok(err);
+	ut_assertok(image_decomp_stream_finish(&ids, &size));
+	ut_asserteq(unc_len, size);
+	ut_asserteq_mem(plain, uncompressed_buf, unc_len);
+
+	/* the output does not fit */
+	ut_assertok(image_decomp_stream_init(&ids, comp_type, uncompressed_buf,
+					     unc_len - 1));
+	err = stream_write(ids.sink, compress_buff, compress_size);
+	ret = image_decomp_stream_finish(&ids, &size);
+	ut_asserteq(-ENOSPC, err ? err : ret);
+
+	/* truncated input */
+	if (comp_type == IH_COMP_NONE)
+		return 0;
+	ut_assertok(image_decomp_stream_init(&ids, comp_type, uncompressed_buf,
+					     sizeof(uncompressed_buf)));
+	ut_assertok(stream_write(ids.sink, compress_buff, compress_size / 2));
+	ut_assert(image_decomp_stream_finish(&ids, &size));
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZ4, compress_using_lz4);
+}
+COMPRESSION_TEST(compression_test_stream_lz4, 0);
+
+static int compression_test_stream_none(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_stream_none, 0);
+
+#if CONFIG_IS_ENABLED(ZSTD)
+/*
+ * There is no zstd compressor, so this uses the benchmark corpus. The frame
+ * header arrives in pieces, before the window can be allocated.
+ */
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	struct image_decomp_stream ids;
+	ulong size, pos, len;
+	char *corpus, *out;
+	int i, ret, err = 0;
+
+	corpus = malloc(BENCH_SIZE);
+	out = malloc(BENCH_SIZE);
+	ut_assertnonnull(corpus);
+	ut_assertnonnull(out);
+	for (i = 0; i < BENCH_COPIES; i++)
+		memcpy(corpus + i * strlen(plain), plain, strlen(plain));
+
+	/* the memory needed depends on the frame, not the space for output */
+	ut_assertok(image_decomp_stream_init(&ids, IH_COMP_ZSTD, out,
+					     ULONG_MAX));
+	for (pos = 0; !err && pos < bench_zstd_size; pos += len) {
+		len = min(bench_zstd_size - pos, 7UL);
+		err = stream_write(ids.sink, bench_zstd + pos, len);
+	}
+	ut_assertok(err);
+	ut_assertok(image_decomp_stream_finish(&ids, &size));
+	ut_asserteq(BENCH_SIZE, size);
+	ut_asserteq_mem(corpus, out, BENCH_SIZE);
+
+	/* the output does not fit */
+	ut_assertok(image_decomp_stream_init(&ids, IH_COMP_ZSTD, out,
+					     BENCH_SIZE - 1));
+	err = stream_write(ids.sink, bench_zstd, bench_zstd_size);
+	ret = image_decomp_stream_finish(&ids, &size);
+	ut_asserteq(-ENOSPC, err ? err : ret);
+
+	free(out);
+	free(corpus);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_stream_zstd, 0);
+#endif
+
+/**
+ * run_bench() - Time decompression of the benchmark corpus
+ *
+ * @name:	Name of the compression type, for the report
+ * @uncompress:	Our function to uncompress data
+ * @in:		Compressed corpus
+ * @in_size:	Size of the compressed corpus
+ * @corpus:	Uncompressed corpus, to check the output against
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_bench(struct unit_test_state *uts, const char *name,
+		     mutate_func uncompress, const void *in, ulong in_size,
+		     const char *corpus)
+{
+	ulong start, delta, size = 0;
+	void *out;
+	int i;
+
+	out = malloc(BENCH_SIZE);
+	ut_assertnonnull(out);
+
+	start = timer_get_us();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		if (uncompress(uts, (void *)in, in_size, out, BENCH_SIZE,
+			       &size))
+			break;
+	}
+	delta = timer_get_us() - start;
+
+	ut_asserteq(BENCH_LOOPS, i);
+	ut_asserteq(BENCH_SIZE, size);
+	ut_asserteq_mem(corpus, out, BENCH_SIZE);
+	free(out);
+
+	printf("%s: %lu KiB in %lu us", name,
+	       (ulong)(BENCH_LOOPS * BENCH_SIZE / 1024), delta);
+	if (delta)
+		printf(", %llu KiB/s",
+		       lldiv((u64)BENCH_LOOPS * BENCH_SIZE * 1000000 / 1024,
+			     delta));
+	printf("\n");
+
+	return 0;
+}
+
+static int compression_test_bench(struct unit_test_state *uts)
+{
+	unsigned long gzip_size = BENCH_SIZE;
+	char *corpus, *gzip_buf, *lzo_buf, *ptr;
+	ulong lzo_size;
+	int i;
+
+	corpus = malloc(BENCH_SIZE);
+	gzip_buf = malloc(BENCH_SIZE);
+	lzo_size = LZO_HEADER_SIZE + BENCH_COPIES * LZO_BLOCK_SIZE + 4;
+	lzo_buf = malloc(lzo_size);
+	ut_assertnonnull(corpus);
+	ut_assertnonnull(gzip_buf);
+	ut_assertnonnull(lzo_buf);
+
+	for (i = 0; i < BENCH_COPIES; i++)
+		memcpy(corpus + i * strlen(plain), plain, strlen(plain));
+	ut_assertok(compress_using_gzip(uts, corpus, BENCH_SIZE, gzip_buf,
+					gzip_size, &gzip_size));
+
+	memcpy(lzo_buf, lzo_compressed, LZO_HEADER_SIZE);
+	ptr = lzo_buf + LZO_HEADER_SIZE;
+	for (i = 0; i < BENCH_COPIES; i++, ptr += LZO_BLOCK_SIZE)
+		memcpy(ptr, lzo_compressed + LZO_HEADER_SIZE, LZO_BLOCK_SIZE);
+	memset(ptr, '\0', 4);
+
+	ut_assertok(run_bench(uts, "gzip", uncompress_using_gzip, gzip_buf,
+			      gzip_size, corpus));
+	ut_assertok(run_bench(uts, "lzma", uncompress_using_lzma, bench_lzma,
+			      bench_lzma_size, corpus));
+	ut_assertok(run_bench(uts, "lzo", uncompress_using_lzo, lzo_buf,
+			      lzo_size, corpus));
+	ut_assertok(run_bench(uts, "lz4", uncompress_using_lz4, bench_lz4,
+			      bench_lz4_size, corpus));
+#if CONFIG_IS_ENABLED(ZSTD)
+	ut_assertok(run_bench(uts, "zstd", uncompress_using_zstd, bench_zstd,
+			      bench_zstd_size, corpus));
+#endif
+
+	free(lzo_buf);
+	free(gzip_buf);
+	free(corpus);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_bench, 0);
+
 int do_ut_compression(struct cmd_tbl *cmdtp, int flag, int argc,
 		      char *const argv[])
 {
@@ -4,6 +4,8 @@
  */
 
 #include <common.h>
+#include <blk.h>
+#include <command.h>
 #include <dm.h>
 #include <part.h>
 #include <usb.h>
@@ -217,3 +219,70 @@ static int dm_test_blk_iter(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_iter, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+/* Test that small reads fill the block cache, with readahead */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *dev_desc;
+	unsigned long max_bytes;
+	unsigned blocks, readahead;
+	char write[16 * 512], read[2 * 512];
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	ut_asserteq(512, dev_desc->blksz);
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i / 512 + i;
+	ut_asserteq(16, blk_dwrite(dev_desc, 0, 16, write));
+
+	/* make sure the first read below is not seen as sequential */
+	blkcache_configure(4, 64 * 1024, 0);
+	ut_asserteq(1, blk_dread(dev_desc, 20, 1, read));
+	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+
+	/* the command keeps the readahead */
+	blkcache_configure(4, 64 * 1024, 8);
+	ut_assertok(run_command("blkcache configure 4 64", 0));
+	blkcache_get_config(&blocks, &max_bytes, &readahead);
+	ut_asserteq(4, blocks);
+	ut_asserteq(64 * 1024, max_bytes);
+	ut_asserteq(8, readahead);
+
+	/* a miss fetches the whole line */
+	ut_asserteq(1, blk_dread(dev_desc, 2, 1, read));
+	ut_asserteq_mem(write + 2 * 512, read, 512);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(1, stats.entries);
+
+	/*
+	 * A sequential read straddling two lines fetches both, plus the
+	 * readahead, and all of it is cached
+	 */
+	ut_asserteq(2, blk_dread(dev_desc, 3, 2, read));
+	ut_asserteq_mem(write + 3 * 512, read, 2 * 512);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(8, stats.readahead);
+	ut_asserteq(4, stats.entries);
+
+	/* the readahead is served from the cache */
+	ut_asserteq(1, blk_dread(dev_desc, 14, 1, read));
+	ut_asserteq_mem(write + 14 * 512, read, 512);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(0, stats.misses);
+
+	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	blkcache_configure(CONFIG_BLOCK_CACHE_BLOCKS,
+			   CONFIG_BLOCK_CACHE_SIZE * 1024,
+			   CONFIG_BLOCK_CACHE_READAHEAD);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
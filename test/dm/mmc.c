@@ -4,9 +4,15 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <dm.h>
+#include <hash.h>
+#include <memalign.h>
 #include <mmc.h>
 #include <part.h>
+#include <stream.h>
+#include <u-boot/sha256.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -52,3 +58,181 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+static void mmc_test_req_done(struct blk_req *req)
+{
+	int *calls = req->priv;
+
+	(*calls)++;
+}
+
+/*
+ * Test that asynchronous reads complete, both through the driver's
+ * send_cmd_async() and through the synchronous fallback
+ */
+static int dm_test_mmc_blk_async(struct unit_test_state *uts)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(char, read, 1024);
+	struct blk_desc *dev_desc;
+	struct blk_req req;
+	char write[1024];
+	int calls = 0;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i ^ 0x5a;
+	ut_asserteq(2, blk_dwrite(dev_desc, 0, 2, write));
+
+	req.done = mmc_test_req_done;
+	req.priv = &calls;
+	ut_assertok(blk_dread_async(dev_desc, 0, 2, read, &req));
+
+	/* the sandbox driver keeps the transfer in flight until polled */
+	ut_assert(!req.complete);
+	ut_asserteq(0, calls);
+	ut_asserteq(-EBUSY, blk_poll(&req));
+	ut_asserteq(0, calls);
+	ut_asserteq(2, blk_wait(&req));
+	ut_assert(req.complete);
+	ut_asserteq(1, calls);
+	ut_asserteq_mem(write, read, sizeof(write));
+
+	/* Polling a completed request does not complete it again */
+	ut_assertok(blk_poll(&req));
+	ut_asserteq(1, calls);
+
+	/* A buffer which is not DMA-aligned is read synchronously */
+	memset(read, '\0', 1024);
+	calls = 0;
+	ut_assertok(blk_dread_async(dev_desc, 0, 1, read + 1, &req));
+	ut_assert(req.complete);
+	ut_asserteq(1, calls);
+	ut_asserteq(1, req.result);
+	ut_asserteq_mem(write, read + 1, 512);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_blk_async, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test that vectored reads scatter the data over all the segments */
+static int dm_test_mmc_blk_readv(struct unit_test_state *uts)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(char, dma, 2048);
+	char write[2048], head[100], mid[1537], tail[412];
+	struct blk_desc *dev_desc;
+	struct blk_seg segs[3];
+	struct udevice *dev;
+	int i, sg_reads;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i * 7;
+	ut_asserteq(4, blk_dwrite(dev_desc, 0, 4, write));
+
+	/*
+	 * Segments which are not whole blocks, nor whole cache lines, go
+	 * straight to the driver, leaving the gap between them alone
+	 */
+	memset(dma, '\xaa', 2048);
+	sg_reads = sandbox_mmc_get_sg_reads(dev);
+	segs[0].buffer = dma + 4;
+	segs[0].len = 100;
+	segs[1].buffer = dma + 512;
+	segs[1].len = 1436;
+	ut_asserteq(3, blk_dreadv(dev_desc, 0, 3, segs, 2));
+	ut_asserteq(sg_reads + 1, sandbox_mmc_get_sg_reads(dev));
+	ut_asserteq_mem(write, dma + 4, segs[0].len);
+	ut_asserteq_mem(write + segs[0].len, dma + 512, segs[1].len);
+	for (i = 0; i < 4; i++)
+		ut_asserteq(0xaa, (u8)dma[i]);
+	for (i = 104; i < 512; i++)
+		ut_asserteq(0xaa, (u8)dma[i]);
+	for (i = 1948; i < 2048; i++)
+		ut_asserteq(0xaa, (u8)dma[i]);
+
+	/*
+	 * Segments the controller cannot describe go through the fallback,
+	 * which reads the blocks within a segment straight into it and only
+	 * bounces those straddling two segments
+	 */
+	segs[0].buffer = head + 1;
+	segs[0].len = sizeof(head) - 1;
+	segs[1].buffer = mid;
+	segs[1].len = sizeof(mid);
+	segs[2].buffer = tail;
+	segs[2].len = sizeof(tail);
+	ut_asserteq(4, blk_dreadv(dev_desc, 0, 4, segs, 3));
+	ut_asserteq(sg_reads + 1, sandbox_mmc_get_sg_reads(dev));
+	ut_asserteq_mem(write, head + 1, segs[0].len);
+	ut_asserteq_mem(write + segs[0].len, mid, segs[1].len);
+	ut_asserteq_mem(write + segs[0].len + segs[1].len, tail,
+			sizeof(tail));
+
+	/* Whole-block segments */
+	segs[0].buffer = mid;
+	segs[0].len = 1024;
+	segs[1].buffer = head;
+	segs[1].len = 0;
+	segs[2].buffer = mid + 1024;
+	segs[2].len = 512;
+	ut_asserteq(3, blk_dreadv(dev_desc, 1, 3, segs, 3));
+	ut_asserteq_mem(write + 512, mid, 1536);
+
+	/* The segments must cover the blocks exactly */
+	ut_asserteq(-EINVAL, (long)blk_dreadv(dev_desc, 0, 4, segs, 3));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_blk_readv, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+static int mmc_test_stream_fail(struct stream_sink *sink, const void *buf,
+				ulong len)
+{
+	return -EPIPE;
+}
+
+/* Test that streamed reads pass every chunk on, in order */
+static int dm_test_mmc_blk_stream(struct unit_test_state *uts)
+{
+	u8 digest[SHA256_SUM_LEN], expect[SHA256_SUM_LEN];
+	struct stream_sink fail = { .write = mmc_test_stream_fail };
+	char write[4096], read[4096];
+	struct blk_desc *dev_desc;
+	struct hash_stream hs;
+	struct stream_copy sc;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i * 13;
+	ut_asserteq(8, blk_dwrite(dev_desc, 0, 8, write));
+
+	/* Chunks which do not divide the read evenly */
+	stream_copy_init(&sc, read, sizeof(read));
+	ut_asserteq(8, blk_dread_stream(dev_desc, 0, 8, 3, &sc.sink));
+	ut_asserteq(sizeof(read), sc.size);
+	ut_asserteq_mem(write, read, sizeof(write));
+
+	/* The copy consumer refuses to overflow its buffer */
+	stream_copy_init(&sc, read, 1024);
+	ut_asserteq(-ENOSPC, blk_dread_stream(dev_desc, 0, 8, 2, &sc.sink));
+	ut_asserteq(1024, sc.size);
+
+	/* Hashing while reading gives the same result as hashing after */
+	ut_assertok(hash_block("sha256", write, sizeof(write), expect, NULL));
+	ut_assertok(hash_stream_init(&hs, "sha256"));
+	ut_asserteq(8, blk_dread_stream(dev_desc, 0, 8, 4, &hs.sink));
+	ut_assertok(hash_stream_finish(&hs, digest, sizeof(digest)));
+	ut_asserteq_mem(expect, digest, sizeof(digest));
+
+	/* Errors from the consumer stop the stream */
+	ut_asserteq(-EPIPE, blk_dread_stream(dev_desc, 0, 8, 1, &fail));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_blk_stream, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
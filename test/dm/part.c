@@ -97,3 +97,52 @@ out:
 	return ret;
 }
 DM_TEST(dm_test_part, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+static int dm_test_part_efi_cache(struct unit_test_state *uts)
+{
+	char str_disk_guid[UUID_STR_LEN + 1];
+	struct blk_desc *mmc_dev_desc;
+	struct disk_partition info;
+	struct disk_partition parts[2] = {
+		{
+			.start = 48,
+			.size = 1,
+			.name = "test1",
+		},
+		{
+			.start = 49,
+			.size = 1,
+			.name = "test2",
+		},
+	};
+
+	if (!CONFIG_IS_ENABLED(RANDOM_UUID))
+		return 0;
+
+	ut_asserteq(1, blk_get_device_by_str("mmc", "1", &mmc_dev_desc));
+	gen_rand_uuid_str(parts[0].uuid, UUID_STR_FORMAT_STD);
+	gen_rand_uuid_str(parts[1].uuid, UUID_STR_FORMAT_STD);
+	gen_rand_uuid_str(str_disk_guid, UUID_STR_FORMAT_STD);
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, parts,
+				ARRAY_SIZE(parts)));
+
+	ut_asserteq(2, part_get_info_by_name(mmc_dev_desc, "test2", &info));
+	ut_asserteq(49, info.start);
+	ut_asserteq(-ENOENT, part_get_info_by_name(mmc_dev_desc, "bogus",
+						   &info));
+	ut_asserteq(1, part_get_info_by_uuid(mmc_dev_desc, parts[0].uuid,
+					     &info));
+	ut_asserteq_str("test1", (char *)info.name);
+
+	/* rewriting the GPT must not leave a stale table behind */
+	strcpy((char *)parts[0].name, "test3");
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, parts,
+				ARRAY_SIZE(parts)));
+	ut_asserteq(-ENOENT, part_get_info_by_name(mmc_dev_desc, "test1",
+						   &info));
+	ut_asserteq(1, part_get_info_by_name(mmc_dev_desc, "test3", &info));
+	ut_asserteq(48, info.start);
+
+	return 0;
+}
+DM_TEST(dm_test_part_efi_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests and benchmark for CRC32
+ *
+ * crc32_no_comp() takes different paths depending on the alignment and
+ * length of the buffer and on the CPU, so check that they all agree with
+ * processing one byte at a time.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/sizes.h>
+#include <time.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of the buffer used for the benchmark */
+#define BENCH_SIZE	SZ_1M
+/* Number of times the benchmark buffer is checksummed */
+#define BENCH_LOOPS	16
+
+/**
+ * crc32_bytewise() - calculate a CRC32 one byte at a time
+ *
+ * @crc:	Input crc
+ * @buf:	Bytes to checksum
+ * @len:	Number of bytes to checksum
+ * Return:	checksum value
+ */
+static uint32_t crc32_bytewise(uint32_t crc, const unsigned char *buf,
+			       uint len)
+{
+	while (len--)
+		crc = crc32(crc, buf++, 1);
+
+	return crc;
+}
+
+static int lib_test_crc32(struct unit_test_state *uts)
+{
+	const unsigned char check[] = "123456789";
+	unsigned char buf[128];
+	uint offset, len;
+	int i;
+
+	/* standard check values for CRC-32 and CRC-32/JAMCRC */
+	ut_asserteq(0xcbf43926, crc32(0, check, 9));
+	ut_asserteq(0x340bc6d9, crc32_no_comp(~0, check, 9));
+	ut_asserteq(0, crc32(0, check, 0));
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 37 + 11;
+
+	for (offset = 0; offset < 8; offset++) {
+		for (len = 0; len <= sizeof(buf) - offset; len++) {
+			ut_asserteq(crc32_bytewise(0x12345678, buf + offset,
+						   len),
+				    crc32(0x12345678, buf + offset, len));
+		}
+	}
+
+	return 0;
+}
+
+LIB_TEST(lib_test_crc32, 0);
+
+static int lib_test_crc32_bench(struct unit_test_state *uts)
+{
+	unsigned char *buf;
+	ulong start, delta;
+	uint32_t crc = 0;
+	int i;
+
+	buf = malloc(BENCH_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < BENCH_SIZE; i++)
+		buf[i] = i ^ (i >> 8);
+
+	start = timer_get_us();
+	for (i = 0; i < BENCH_LOOPS; i++)
+		crc = crc32(crc, buf, BENCH_SIZE);
+	delta = timer_get_us() - start;
+	free(buf);
+
+	/* the buffer is fixed, so the result must be too */
+	ut_asserteq(0xe7c02c06, crc);
+	printf("crc32: %d MiB in %lu us", BENCH_LOOPS, delta);
+	if (delta)
+		printf(", %lu MiB/s", BENCH_LOOPS * 1000000UL / delta);
+	printf("\n");
+
+	return 0;
+}
+
+LIB_TEST(lib_test_crc32_bench, 0);
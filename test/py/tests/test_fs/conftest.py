@@ -15,6 +15,7 @@ supported_fs_ext = ['fat16', 'fat32']
 supported_fs_mkdir = ['fat16', 'fat32']
 supported_fs_unlink = ['fat16', 'fat32']
 supported_fs_symlink = ['ext4']
+supported_fs_frag = ['fat16', 'fat32', 'ext4']
 
 #
 # Filesystem test specific setup
@@ -51,6 +52,7 @@ def pytest_configure(config):
     global supported_fs_mkdir
     global supported_fs_unlink
     global supported_fs_symlink
+    global supported_fs_frag
 
     def intersect(listA, listB):
         return  [x for x in listA if x in listB]
@@ -63,6 +65,7 @@ def pytest_configure(config):
         supported_fs_mkdir =  intersect(supported_fs, supported_fs_mkdir)
         supported_fs_unlink =  intersect(supported_fs, supported_fs_unlink)
         supported_fs_symlink =  intersect(supported_fs, supported_fs_symlink)
+        supported_fs_frag =  intersect(supported_fs, supported_fs_frag)
 
 def pytest_generate_tests(metafunc):
     """Parametrize fixtures, fs_obj_xxx
@@ -91,6 +94,9 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_symlink' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_symlink', supported_fs_symlink,
             indirect=True, scope='module')
+    if 'fs_obj_frag' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_frag', supported_fs_frag,
+            indirect=True, scope='module')
 
 #
 # Helper functions
@@ -323,6 +329,12 @@ def fs_obj_basic(request, u_boot_config):
         check_call('dd if=/dev/urandom of=%s bs=1M count=1'
 	    % small_file, shell=True)
 
+        # Create compressed copies of the small file, for zload
+        for ext, tool in COMP_TOOLS.items():
+            if tool_is_in_path(tool):
+                check_call('%s -c %s > %s.%s'
+                    % (tool, small_file, small_file, ext), shell=True)
+
         # Delete the small file copies which possibly are written as part of a
         # previous test.
         # check_call('rm -f "%s.w"' % MB1, shell=True)
@@ -670,3 +682,106 @@ def fs_obj_symlink(request, u_boot_config):
     finally:
         call('rmdir %s' % mount_dir, shell=True)
         call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for fragmented fs test
+#
+@pytest.fixture()
+def fs_obj_frag(request, u_boot_config):
+    """Set up a file system with fragmented files and free space.
+
+    Two files are written a chunk at a time in turn, so that their clusters
+    or extents are interleaved, then one of them is deleted.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for fragmented fs test, i.e. a triplet of file system type,
+        volume file name and a list of MD5 hashes.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+
+    mount_dir = u_boot_config.persistent_data_dir + '/mnt'
+
+    frag_file = mount_dir + '/' + FRAG_FILE
+    tmp_file = mount_dir + '/tmpfile'
+
+    try:
+
+        # 128MiB volume
+        fs_img = mk_fs(u_boot_config, fs_type, 0x8000000, '128MB')
+    except CalledProcessError as err:
+        pytest.skip('Creating failed for filesystem: ' + fs_type + '. {}'.format(err))
+        return
+
+    try:
+        check_call('mkdir -p %s' % mount_dir, shell=True)
+    except CalledProcessError as err:
+        pytest.skip('Preparing mount folder failed for filesystem: ' + fs_type + '. {}'.format(err))
+        call('rm -f %s' % fs_img, shell=True)
+        return
+
+    try:
+        # Mount the image so we can populate it.
+        mount_fs(fs_type, fs_img, mount_dir)
+    except CalledProcessError as err:
+        pytest.skip('Mounting to folder failed for filesystem: ' + fs_type + '. {}'.format(err))
+        call('rmdir %s' % mount_dir, shell=True)
+        call('rm -f %s' % fs_img, shell=True)
+        return
+
+    try:
+        # Interleave the two files, syncing so that each chunk is
+        # allocated before the next one is written
+        for i in range(FRAG_CHUNKS):
+            for name in [frag_file, tmp_file]:
+                check_call('dd if=/dev/urandom of=%s bs=%d count=1 '
+                    'oflag=append conv=notrunc 2> /dev/null'
+                    % (name, FRAG_CHUNK_SIZE), shell=True)
+                check_call('sync', shell=True)
+
+        # Leave holes in the free space
+        check_call('rm %s' % tmp_file, shell=True)
+
+        # A directory too big for one block, which ext4 indexes as a tree
+        check_call('mkdir %s/%s' % (mount_dir, BIG_DIR), shell=True)
+        check_call('for i in $(seq 0 %d); do echo file$i > %s/%s/file$i; done'
+            % (BIG_DIR_FILES - 1, mount_dir, BIG_DIR), shell=True)
+
+        out = check_output('md5sum %s' % frag_file, shell=True).decode()
+        md5val = [out.split()[0]]
+
+        # A read which starts and ends part way through pieces of the file
+        out = check_output(
+            'dd if=%s bs=512 skip=31 count=66 2> /dev/null | md5sum'
+            % frag_file, shell=True).decode()
+        md5val.append(out.split()[0])
+
+        if fs_type == 'ext4':
+            # Holes, then unwritten extents around a written block
+            sparse_file = mount_dir + '/' + SPARSE_FILE
+            check_call('dd if=/dev/urandom of=%s bs=64K seek=4 count=1 '
+                '2> /dev/null' % sparse_file, shell=True)
+            check_call('fallocate -o 0x50000 -l 0x40000 %s' % sparse_file,
+                shell=True)
+            check_call('dd if=/dev/urandom of=%s bs=4K seek=96 count=1 '
+                'conv=notrunc 2> /dev/null' % sparse_file, shell=True)
+            out = check_output('md5sum %s' % sparse_file,
+                shell=True).decode()
+            md5val.append(out.split()[0])
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        umount_fs(mount_dir)
+        return
+    else:
+        umount_fs(mount_dir)
+        yield [fs_ubtype, fs_img, md5val]
+    finally:
+        call('rmdir %s' % mount_dir, shell=True)
+        call('rm -f %s' % fs_img, shell=True)
@@ -12,5 +12,26 @@ MEDIUM_FILE='10MB.file'
 # $BIG_FILE is the name of the 2.5GB file in the file system image
 BIG_FILE='2.5GB.file'
 
+# Compressed copies of $SMALL_FILE are named with these extensions, if the
+# tool to create them is available
+COMP_TOOLS={'gz': 'gzip', 'lz4': 'lz4', 'zst': 'zstd'}
+
+# U-Boot option needed to decompress each of them
+COMP_CONFIGS={'gz': 'gzip', 'lz4': 'lz4', 'zst': 'zstd'}
+
+# $FRAG_FILE is the name of the 1MB file written in $FRAG_CHUNKS pieces,
+# interleaved with another file which is then deleted
+FRAG_FILE='frag.file'
+FRAG_CHUNKS=64
+FRAG_CHUNK_SIZE=0x4000
+
+# $SPARSE_FILE is the name of the ext4 file with holes and unwritten extents
+SPARSE_FILE='sparse.file'
+
+# $BIG_DIR is the name of the directory holding $BIG_DIR_FILES files, each
+# named "file<n>" and containing its name followed by a newline
+BIG_DIR='bigdir'
+BIG_DIR_FILES=2000
+
 ADDR=0x01000008
 LENGTH=0x00100000
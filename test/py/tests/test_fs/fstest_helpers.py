@@ -11,3 +11,7 @@ def assert_fs_integrity(fs_type, fs_img):
             check_call('fsck.ext4 -n -f %s' % fs_img, shell=True)
     except CalledProcessError:
         raise
+
+def assert_fat_integrity(fs_img):
+    """Check a FAT file system, including the FSInfo free-cluster count"""
+    check_call('fsck.fat -n %s' % fs_img, shell=True)
@@ -10,6 +10,7 @@ This test verifies basic read/write operation on file system.
 
 import pytest
 import re
+import shutil
 from fstest_defs import *
 from fstest_helpers import assert_fs_integrity
 
@@ -290,3 +291,28 @@ class TestFsBasic(object):
                 'setenv filesize'])
             assert(md5val[0] in ''.join(output))
             assert_fs_integrity(fs_type, fs_img)
+
+    def test_fs14(self, u_boot_console, fs_obj_basic):
+        """
+        Test Case 14 - zload of compressed files, streamed from the disk
+        """
+        fs_type,fs_img,md5val = fs_obj_basic
+        if not u_boot_console.config.buildconfig.get('config_cmd_zload', None):
+            pytest.skip('.config feature "CMD_ZLOAD" not enabled')
+        with u_boot_console.log.section('Test Case 14 - zload'):
+            for ext, tool in COMP_TOOLS.items():
+                # The fixture only creates files it has a tool for
+                if not shutil.which(tool):
+                    continue
+                if not u_boot_console.config.buildconfig.get(
+                        'config_%s' % COMP_CONFIGS[ext], None):
+                    continue
+                output = u_boot_console.run_command_list([
+                    'host bind 0 %s' % fs_img,
+                    'mw.b %x 00 100' % ADDR,
+                    'zload host 0:0 %x /%s.%s' % (ADDR, SMALL_FILE, ext)])
+                assert('1048576 bytes uncompressed' in ''.join(output))
+                output = u_boot_console.run_command_list([
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                assert(md5val[0] in ''.join(output))
@@ -0,0 +1,197 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:Fragmentation Test
+
+"""
+This test verifies reading and writing files which are split into many
+pieces, in file systems whose free space is fragmented.
+"""
+
+import hashlib
+import pytest
+import re
+from fstest_defs import *
+from fstest_helpers import assert_fs_integrity, assert_fat_integrity
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestFsFrag(object):
+    def test_frag1(self, u_boot_console, fs_obj_frag):
+        """
+        Test Case 1 - append to a file several clusters at a time
+        """
+        fs_type,fs_img,md5val = fs_obj_frag
+        if fs_type != 'fat':
+            pytest.skip('%swrite does not support an offset' % fs_type)
+        with u_boot_console.log.section('Test Case 1 - append'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FRAG_FILE)])
+            assert('1048576 bytes read' in ''.join(output))
+
+            # Each piece lands in the holes left in the free space
+            for i in range(4):
+                output = u_boot_console.run_command(
+                    '%swrite host 0:0 %x /append.file 0x40000 %x'
+                    % (fs_type, ADDR + i * 0x40000, i * 0x40000))
+                assert('262144 bytes written' in output)
+
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /append.file' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[0] in ''.join(output))
+            assert_fat_integrity(fs_img)
+
+    def test_frag2(self, u_boot_console, fs_obj_frag):
+        """
+        Test Case 2 - read a file which is in many pieces
+        """
+        fs_type,fs_img,md5val = fs_obj_frag
+        with u_boot_console.log.section('Test Case 2 - read fragmented'):
+            # Test Case 2a - whole file
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FRAG_FILE),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[0] in ''.join(output))
+
+            # Test Case 2b - across the joins between pieces
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /%s %x %x'
+                    % (fs_type, ADDR, FRAG_FILE, 66 * 512, 31 * 512),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[1] in ''.join(output))
+
+            # Test Case 2c - the same again, with the chain or extents known
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /%s %x %x'
+                    % (fs_type, ADDR, FRAG_FILE, 66 * 512, 31 * 512),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[1] in ''.join(output))
+
+    def test_frag3(self, u_boot_console, fs_obj_frag):
+        """
+        Test Case 3 - read a file with holes and unwritten extents
+        """
+        fs_type,fs_img,md5val = fs_obj_frag
+        if fs_type != 'ext4':
+            pytest.skip('only ext4 has unwritten extents')
+        with u_boot_console.log.section('Test Case 3 - read sparse'):
+            # Both read as zeroes, so fill the buffer with something else
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'mw.b %x a5 0x90000' % ADDR,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, SPARSE_FILE),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert('589824 bytes read' in ''.join(output))
+            assert(md5val[2] in ''.join(output))
+
+    def test_frag4(self, u_boot_console, fs_obj_frag):
+        """
+        Test Case 4 - look up names in a large directory
+        """
+        fs_type,fs_img,md5val = fs_obj_frag
+        with u_boot_console.log.section('Test Case 4 - large directory'):
+            u_boot_console.run_command('host bind 0 %s' % fs_img)
+
+            # Test Case 4a - first, middle and last entries, some of which
+            # are in different blocks of the directory or the hash tree
+            for i in [0, 1, BIG_DIR_FILES // 2, BIG_DIR_FILES - 1]:
+                name = 'file%d' % i
+                md5 = hashlib.md5(('%s\n' % name).encode()).hexdigest()
+                output = u_boot_console.run_command_list([
+                    'mw.b %x 00 100' % ADDR,
+                    '%sload host 0:0 %x /%s/%s'
+                        % (fs_type, ADDR, BIG_DIR, name),
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                assert(md5 in ''.join(output))
+
+            # Test Case 4b - a name which is not there
+            output = u_boot_console.run_command(
+                '%sload host 0:0 %x /%s/file%d'
+                % (fs_type, ADDR, BIG_DIR, BIG_DIR_FILES))
+            assert('Failed to load' in output)
+
+            # Test Case 4c - every entry is listed
+            output = u_boot_console.run_command(
+                '%sls host 0:0 /%s' % (fs_type, BIG_DIR))
+            names = set(re.findall(r'\bfile\d+\b', output.lower()))
+            assert(len(names) == BIG_DIR_FILES)
+
+    def test_frag5(self, u_boot_console, fs_obj_frag):
+        """
+        Test Case 5 - write a file into fragmented free space
+        """
+        fs_type,fs_img,md5val = fs_obj_frag
+        with u_boot_console.log.section('Test Case 5 - write fragmented'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FRAG_FILE),
+                '%swrite host 0:0 %x /written.file $filesize'
+                    % (fs_type, ADDR)])
+            assert('1048576 bytes written' in ''.join(output))
+
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /written.file' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[0] in ''.join(output))
+            assert_fs_integrity(fs_type, fs_img)
+            if fs_type == 'fat':
+                assert_fat_integrity(fs_img)
+
+            # Overwriting it frees blocks and allocates them again
+            output = u_boot_console.run_command_list([
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FRAG_FILE),
+                '%swrite host 0:0 %x /written.file $filesize'
+                    % (fs_type, ADDR),
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /written.file' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[0] in ''.join(output))
+            assert_fs_integrity(fs_type, fs_img)
+            if fs_type == 'fat':
+                assert_fat_integrity(fs_img)
+
+    def test_frag6(self, u_boot_console, fs_obj_frag):
+        """
+        Test Case 6 - free clusters before allocating any, then fsck
+        """
+        fs_type,fs_img,md5val = fs_obj_frag
+        if fs_type != 'fat':
+            pytest.skip('only FAT keeps a free cluster count')
+        with u_boot_console.log.section('Test Case 6 - free first'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, FRAG_FILE),
+                '%swrite host 0:0 %x /rm.file $filesize' % (fs_type, ADDR),
+                '%swrite host 0:0 %x /trunc.file $filesize'
+                    % (fs_type, ADDR)])
+            assert_fat_integrity(fs_img)
+
+            # Each command mounts afresh, so these free clusters first
+            output = u_boot_console.run_command(
+                '%srm host 0:0 /rm.file' % fs_type)
+            assert('Error' not in output)
+            assert_fat_integrity(fs_img)
+
+            output = u_boot_console.run_command(
+                '%swrite host 0:0 %x /trunc.file 0x1000' % (fs_type, ADDR))
+            assert('4096 bytes written' in output)
+            assert_fat_integrity(fs_img)
+
+            output = u_boot_console.run_command(
+                '%sload host 0:0 %x /trunc.file' % (fs_type, ADDR))
+            assert('4096 bytes read' in output)
@@ -0,0 +1,249 @@
+# SPDX-License-Identifier: GPL-2.0
+
+import gzip
+import hashlib
+import os
+import random
+import shutil
+import pytest
+
+from sqfs_common import mksquashfs, check_mksquashfs_version
+
+""" Images used to exercise the block caches: the small 4KiB block size means
+that the test files span many data, fragment and metadata blocks, many more
+than CONFIG_SQUASHFS_CACHE_BLOCKS.
+"""
+READ_TABLE = {
+        'read_gzip_frag' : '-comp gzip -b 4096 -always-use-fragments',
+        'read_lzo_frag' : '-comp lzo -b 4096 -always-use-fragments',
+        'read_zstd_frag' : '-comp zstd -b 4096 -always-use-fragments',
+        'read_gzip_no_frag' : '-comp gzip -b 4096 -no-fragments',
+        'read_lzo_no_frag' : '-comp lzo -b 4096 -no-fragments',
+        'read_zstd_no_frag' : '-comp zstd -b 4096 -no-fragments'
+}
+
+# path to source directory used to make the images above
+READ_SRC_DIR = 'sqfs_read_src_dir'
+
+# more files than the 512 fragment entries held by one metadata block
+SMALL_FILES = 600
+
+BLOCK_SIZE = 4096
+# spans more than one 1MiB device read and ends with a partial block
+BIG_FILE = 'big'
+BIG_FILE_SIZE = 300 * BLOCK_SIZE + 1000
+# the big file in stored deflate blocks: squashfs compresses it, and zload
+# has to read it in more than one piece
+BIG_GZ_FILE = 'big.gz'
+
+def small_file_name(i):
+    return 'files/f{:03d}'.format(i)
+
+def small_file_size(i):
+    """ Every fourth file shares its fragment block with others, the rest are
+    big enough to get a fragment of their own.
+    """
+    if i % 4 == 0:
+        return 100 + (i * 37) % 600
+    return 2100 + (i * 397) % 1900
+
+def generate_text(tag, size):
+    """ Generates compressible content which differs from file to file.
+
+    Args:
+        tag: string placed on every line.
+        size: the content's length.
+    """
+    line = 0
+    content = ''
+    while len(content) < size:
+        content += '{} line {}\n'.format(tag, line)
+        line += 1
+
+    return content[:size].encode()
+
+def generate_big_file(file_name):
+    """ Generates a file made of compressible, incompressible (thus stored
+    uncompressed) and all-zero (thus sparse) blocks.
+
+    Args:
+        file_name: the file's name.
+    """
+    with open(file_name, 'wb') as file:
+        for blk in range(0, BIG_FILE_SIZE, BLOCK_SIZE):
+            size = min(BLOCK_SIZE, BIG_FILE_SIZE - blk)
+            kind = (blk // BLOCK_SIZE) % 5
+            if kind == 0:
+                rand = random.Random(blk)
+                file.write(bytes(rand.getrandbits(8) for _ in range(size)))
+            elif kind == 1:
+                file.write(bytes(size))
+            else:
+                file.write(generate_text('block {}'.format(blk), size))
+
+def generate_read_src_dir(build_dir):
+    """ Generates the source directory used to make the read test images.
+
+    Args:
+        build_dir: u-boot's build-sandbox directory.
+    """
+    root = os.path.join(build_dir, READ_SRC_DIR)
+    os.makedirs(os.path.join(root, 'files'))
+
+    for i in range(SMALL_FILES):
+        name = small_file_name(i)
+        with open(os.path.join(root, name), 'wb') as file:
+            file.write(generate_text(name, small_file_size(i)))
+
+    generate_big_file(os.path.join(root, BIG_FILE))
+    with open(os.path.join(root, BIG_FILE), 'rb') as file:
+        content = gzip.compress(file.read(), compresslevel=0)
+    with open(os.path.join(root, BIG_GZ_FILE), 'wb') as file:
+        file.write(content)
+
+def make_read_images(build_dir):
+    """ Makes the images in READ_TABLE at build_dir. """
+    input_path = os.path.join(build_dir, READ_SRC_DIR)
+    for out, opts in READ_TABLE.items():
+        output_path = os.path.join(build_dir, out)
+        mksquashfs(' '.join([input_path, output_path, '-noappend', opts]))
+
+def clean_read_images(build_dir):
+    """ Deletes the images and the source directory at build_dir. """
+    for image_name in READ_TABLE:
+        image_path = os.path.join(build_dir, image_name)
+        if os.path.exists(image_path):
+            os.remove(image_path)
+    shutil.rmtree(os.path.join(build_dir, READ_SRC_DIR), ignore_errors=True)
+
+def sqfs_check_load(u_boot_console, name, size=None, pos=0):
+    """ Loads a file, or 'size' bytes of it from 'pos', and checks them.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+        name: path of the file in the image.
+        size: number of bytes to load, the whole file if None.
+        pos: where in the file to start loading from.
+    """
+    build_dir = u_boot_console.config.build_dir
+    with open(os.path.join(build_dir, READ_SRC_DIR, name), 'rb') as file:
+        content = file.read()
+    if size is None:
+        cmd = 'sqfsload host 0 $kernel_addr_r {}'.format(name)
+    else:
+        content = content[pos:pos + size]
+        cmd = 'sqfsload host 0 $kernel_addr_r {} {:x} {:x}'.format(name,
+                                                                  size, pos)
+
+    out = u_boot_console.run_command(cmd)
+    assert '{} bytes read'.format(len(content)) in out
+
+    out = u_boot_console.run_command('md5sum $kernel_addr_r {:x}'.format(
+                                     len(content)))
+    assert hashlib.md5(content).hexdigest() in out
+
+def sqfs_read_fragments(u_boot_console):
+    """ Loads files living in fragments.
+
+    Loading them in order hits blocks shared by neighbouring files, going
+    backwards afterwards only finds the most recent ones still cached, and
+    partial loads are served from the cached blocks.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    for i in range(0, SMALL_FILES, 3):
+        sqfs_check_load(u_boot_console, small_file_name(i))
+    for i in reversed(range(0, SMALL_FILES, 7)):
+        sqfs_check_load(u_boot_console, small_file_name(i))
+    for i in (0, 1, SMALL_FILES - 1):
+        sqfs_check_load(u_boot_console, small_file_name(i), 0x20)
+        sqfs_check_load(u_boot_console, small_file_name(i), 0x20, 0x41)
+
+def sqfs_read_blocks(u_boot_console):
+    """ Loads a file made of many data blocks.
+
+    Whole blocks are decompressed straight to the destination, a partial
+    first or last block goes through the cache.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    sqfs_check_load(u_boot_console, BIG_FILE)
+    for size in (BLOCK_SIZE, 10 * BLOCK_SIZE, 10 * BLOCK_SIZE + 123,
+                 11 * BLOCK_SIZE + 1, 0x100000, 0x100001,
+                 BIG_FILE_SIZE - 1000, BIG_FILE_SIZE - 1):
+        sqfs_check_load(u_boot_console, BIG_FILE, size)
+    for (size, pos) in ((1, 1), (BLOCK_SIZE, BLOCK_SIZE),
+                        (3 * BLOCK_SIZE, BLOCK_SIZE - 1), (0x100000, 0x100000),
+                        (BIG_FILE_SIZE - 0x100001, 0x100001),
+                        (1000, BIG_FILE_SIZE - 1000)):
+        sqfs_check_load(u_boot_console, BIG_FILE, size, pos)
+
+def sqfs_zload(u_boot_console):
+    """ Loads a gzip file bigger than the 1MiB pieces zload reads at a time.
+
+    The image compresses the file, so it cannot be read straight from the
+    disk and is read at increasing offsets instead.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    buildconfig = u_boot_console.config.buildconfig
+    if not buildconfig.get('config_cmd_zload', None) or \
+       not buildconfig.get('config_gzip', None):
+        return
+
+    build_dir = u_boot_console.config.build_dir
+    with open(os.path.join(build_dir, READ_SRC_DIR, BIG_FILE), 'rb') as file:
+        content = file.read()
+
+    out = u_boot_console.run_command('zload host 0 $kernel_addr_r {}'.format(
+                                     BIG_GZ_FILE))
+    assert '{} bytes uncompressed'.format(len(content)) in out
+
+    out = u_boot_console.run_command('md5sum $kernel_addr_r {:x}'.format(
+                                     len(content)))
+    assert hashlib.md5(content).hexdigest() in out
+
+def sqfs_ls_big_dir(u_boot_console):
+    """ Lists a directory whose inodes span several metadata blocks, twice.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    for _ in range(2):
+        out = u_boot_console.run_command('sqfsls host 0 files')
+        assert '{} file(s), 0 dir(s)'.format(SMALL_FILES) in out
+        for i in (0, SMALL_FILES // 2, SMALL_FILES - 1):
+            name = os.path.basename(small_file_name(i))
+            assert '{}   {}'.format(small_file_size(i), name) in out
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_squashfs')
+@pytest.mark.buildconfigspec('fs_squashfs')
+@pytest.mark.requiredtool('mksquashfs')
+def test_sqfs_read(u_boot_console):
+    """ Executes the SquashFS read test suite.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    build_dir = u_boot_console.config.build_dir
+
+    check_mksquashfs_version()
+    clean_read_images(build_dir)
+    try:
+        generate_read_src_dir(build_dir)
+        make_read_images(build_dir)
+
+        for image in READ_TABLE:
+            image_path = os.path.join(build_dir, image)
+            u_boot_console.run_command('host bind 0 {}'.format(image_path))
+            sqfs_ls_big_dir(u_boot_console)
+            sqfs_read_fragments(u_boot_console)
+            sqfs_read_blocks(u_boot_console)
+            sqfs_zload(u_boot_console)
+    finally:
+        clean_read_images(build_dir)